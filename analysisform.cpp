@@ -0,0 +1,62 @@
+#include <QtConcurrentRun>
+#include "ui_analysisform.h"
+#include "analysisform.h"
+
+CAnalysisForm::CAnalysisForm(QWidget *parent) :
+    QWidget(parent),
+    ui(new Ui::CAnalysisForm)
+{
+    ui->setupUi(this);
+
+    ui->plotSpectrum->addGraph();
+    ui->plotSpectrum->xAxis->setLabel(trUtf8("Frequency, Hz"));
+    ui->plotSpectrum->yAxis->setLabel(trUtf8("Power, dB"));
+    ui->plotSpectrum->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+
+    new QCPBars(ui->plotHistogram->xAxis,ui->plotHistogram->yAxis);
+    ui->plotHistogram->xAxis->setLabel(trUtf8("Value"));
+    ui->plotHistogram->yAxis->setLabel(trUtf8("Samples"));
+    ui->plotHistogram->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+
+    connect(&watcher,SIGNAL(finished()),this,SLOT(analysisFinished()));
+}
+
+CAnalysisForm::~CAnalysisForm()
+{
+    watcher.waitForFinished();
+    delete ui;
+}
+
+void CAnalysisForm::analyze(const QString &title, const QVector<double> &keys, const QVector<double> &values)
+{
+    channelTitle = title;
+    setWindowTitle(trUtf8("Signal analysis - %1").arg(title));
+    ui->lblInfo->setText(trUtf8("Analyzing %1 samples...").arg(keys.count()));
+
+    watcher.setFuture(QtConcurrent::run(analyzeSignal,keys,values));
+}
+
+void CAnalysisForm::analysisFinished()
+{
+    CAnalysisResult res = watcher.result();
+    if (!res.errorMsg.isEmpty()) {
+        ui->lblInfo->setText(res.errorMsg);
+        return;
+    }
+
+    ui->plotSpectrum->graph(0)->setData(res.frequency,res.power,true);
+    ui->plotSpectrum->rescaleAxes();
+    ui->plotSpectrum->replot();
+
+    QCPBars* bars = qobject_cast<QCPBars *>(ui->plotHistogram->plottable(0));
+    if (bars!=NULL) {
+        bars->setWidth(res.binWidth);
+        bars->setData(res.binCenter,res.binCount,true);
+    }
+    ui->plotHistogram->rescaleAxes();
+    ui->plotHistogram->replot();
+
+    ui->lblInfo->setText(trUtf8("%1: %2 samples, FFT size %3, uniform grid %4 Hz, peak at %5 Hz.")
+                         .arg(channelTitle).arg(res.samples).arg(res.fftSize)
+                         .arg(res.sampleRate,0,'g',6).arg(res.peakFrequency,0,'g',6));
+}
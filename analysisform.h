@@ -0,0 +1,33 @@
+#ifndef ANALYSISFORM_H
+#define ANALYSISFORM_H
+
+#include <QWidget>
+#include <QFutureWatcher>
+#include "plotanalysis.h"
+
+namespace Ui {
+class CAnalysisForm;
+}
+
+class CAnalysisForm : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit CAnalysisForm(QWidget *parent = NULL);
+    ~CAnalysisForm();
+
+    // rows snapshot is analyzed in worker thread, previous pending request is discarded
+    void analyze(const QString &title, const QVector<double> &keys, const QVector<double> &values);
+
+private:
+    Ui::CAnalysisForm *ui;
+    QFutureWatcher<CAnalysisResult> watcher;
+    QString channelTitle;
+
+private slots:
+    void analysisFinished();
+
+};
+
+#endif // ANALYSISFORM_H
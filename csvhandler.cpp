@@ -1,4 +1,6 @@
 #include <QBuffer>
+#include <QDir>
+#include <QFile>
 #include "global.h"
 #include "csvhandler.h"
 
@@ -6,37 +8,79 @@ CCSVHandler::CCSVHandler(QObject *parent) : QObject(parent)
 {
     csvPrevTime = QTime::currentTime();
     csvHasHeader = false;
+    fileTemplate.clear();
+    csvFileName.clear();
+}
+
+void CCSVHandler::setFileTemplate(const QString &aTemplate)
+{
+    fileTemplate = aTemplate;
+}
+
+QString CCSVHandler::fileName() const
+{
+    return csvFileName;
+}
+
+QString CCSVHandler::csvHeader(const CWPList &wp)
+{
+    QString hdr = trUtf8("\"Time\"; ");
+    for (int i=0;i<wp.count();i++) {
+        hdr += QString("\"%1 (%2)\"; ").
+               arg(wp.at(i).label).
+               arg(gSet->plcGetAddrName(wp.at(i)));
+    }
+    hdr += QString("\"Scan dump\"; ");
+    return hdr;
+}
+
+QString CCSVHandler::csvLine(const CWPList &wp, const CWPList &dump, const QDateTime &stm)
+{
+    QString s = QString("\"%1\"; ").arg(stm.toString("yyyy-MM-dd hh:mm:ss.zzz"));
+    for (int i=0;i<wp.count();i++) {
+        s += QString("%1; ").arg(gSet->plcFormatActualValue(wp.at(i)));
+    }
+
+    // write wp dump for graph visualization
+    QByteArray ba;
+    QBuffer buf(&ba);
+    buf.open(QIODevice::WriteOnly);
+    QDataStream out(&buf);
+    out << stm << dump;
+    buf.close();
+    s += QString("%1; ").arg(QString::fromLatin1(qCompress(ba,1).toBase64()));
+    return s;
+}
+
+QString CCSVHandler::decodeScanLine(const QByteArray &line, QDateTime &dt, CWPList &wp)
+{
+    QByteArray s = line;
+    int idx = s.lastIndexOf("; ");
+    if (idx<0)
+        return trUtf8("Unexpected end of file %1 at line %2.");
+    if (s.endsWith(';'))
+        s.chop(1);
+    QByteArray ba = QByteArray::fromBase64(s.mid(idx+2));
+    if (ba.isEmpty())
+        return trUtf8("Corrupted scan data in file %1 at line %2.");
+    ba = qUncompress(ba);
+    if (ba.isEmpty())
+        return trUtf8("Corrupted compressed data in file %1 at line %2.");
+
+    QDataStream in(ba);
+    in >> dt >> wp;
+    return QString();
 }
 
 void CCSVHandler::addData(const CWPList &wp, const QDateTime &stm)
 {
     if (csvLog.device()!=NULL) {
         if (!csvHasHeader) {
-            QString hdr = trUtf8("\"Time\"; ");
-            for (int i=0;i<wp.count();i++) {
-                hdr += QString("\"%1 (%2)\"; ").
-                       arg(wp.at(i).label).
-                       arg(gSet->plcGetAddrName(wp.at(i)));
-            }
-            hdr += QString("\"Scan dump\"; ");
-            csvLog << hdr << QString("\r\n");
+            csvLog << csvHeader(wp) << QString("\r\n");
             csvHasHeader = true;
         }
-        QString s = QString("\"%1\"; ").arg(stm.toString("yyyy-MM-dd hh:mm:ss.zzz"));
-        for (int i=0;i<wp.count();i++) {
-            s += QString("%1; ").arg(gSet->plcFormatActualValue(wp.at(i)));
-        }
-
-        // write wp dump for graph visualization
-        QByteArray ba;
-        QBuffer buf(&ba);
-        buf.open(QIODevice::WriteOnly);
-        QDataStream out(&buf);
-        out << stm << wp;
-        buf.close();
-        s += QString("%1; ").arg(QString::fromLatin1(qCompress(ba,1).toBase64()));
-
-        csvLog << s << QString("\r\n");
+        // snapshots are dumped as changes against previous scan
+        csvLog << csvLine(wp,snapCodec.encode(wp),stm) << QString("\r\n");
     }
 }
 
@@ -53,10 +97,11 @@ bool CCSVHandler::rotateFile()
 
     QDir d(gSet->outputCSVDir);
     QString fname = d.filePath(QString("%1_%2.csv").
-                               arg(gSet->outputFileTemplate).
+                               arg(fileTemplate.isEmpty() ? gSet->outputFileTemplate : fileTemplate).
                                arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh-mm-ss")));
     QFile *f = new QFile(fname);
     if (!f->open(QIODevice::WriteOnly)) {
+        delete f;
         emit recordingStopped();
         emit appendLog(trUtf8("Unable to save CSV file %1.").arg(fname));
         emit errorMessage(trUtf8("Unable to save file '%1'").arg(fname));
@@ -65,7 +110,9 @@ bool CCSVHandler::rotateFile()
 
     csvLog.setDevice(f);
     csvLog.setCodec("Windows-1251");
+    csvFileName = fname;
     csvHasHeader = false;
+    snapCodec.reset(); // each file starts with keyframes
     emit appendLog(trUtf8("CSV rotation was successful."));
     return (csvLog.device()!=NULL);
 }
@@ -88,8 +135,11 @@ void CCSVHandler::stopClose()
 {
     if (csvLog.device()!=NULL) {
         csvLog.flush();
-        csvLog.device()->close();
+        QIODevice* f = csvLog.device();
+        f->close();
         csvLog.setDevice(NULL);
+        delete f; // files are rotated for months in daemon
+        csvFileName.clear();
         emit appendLog(trUtf8("CSV recording stopped. File closed."));
     }
 }
@@ -5,6 +5,7 @@
 #include <QTextStream>
 #include <QTime>
 #include "plc.h"
+#include "snapshot.h"
 
 class CCSVHandler : public QObject
 {
@@ -13,11 +14,21 @@ private:
     QTextStream csvLog;
     QTime csvPrevTime;
     bool csvHasHeader;
+    CSnapshotCodec snapCodec;
+    QString fileTemplate;
+    QString csvFileName;
 
 public:
     explicit CCSVHandler(QObject *parent = 0);
 
     void addData(const CWPList& wp, const QDateTime& stm);
+    void setFileTemplate(const QString& aTemplate); // empty for template from settings
+    QString fileName() const; // empty when closed
+
+    static QString csvHeader(const CWPList& wp);
+    static QString csvLine(const CWPList& wp, const CWPList& dump, const QDateTime& stm);
+    // line is trimmed and is not title line, message has file and line placeholders
+    static QString decodeScanLine(const QByteArray& line, QDateTime& dt, CWPList& wp);
 
 signals:
     void appendLog(const QString& message);
@@ -0,0 +1,504 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QQueue>
+#include <QThread>
+#include <QFuture>
+#include <QtConcurrentRun>
+#include <algorithm>
+#include "csvloader.h"
+#include "csvhandler.h"
+#include "graphform.h"
+
+const static int linesPerChunk = 1024;
+const static int maxPendingBatches = 4; // merge stage backpressure, batches queued to GUI thread
+const static int linesPerBlock = 4096; // archive block, smallest unit of on-demand loading
+const static int previewBlocks = 4; // first indexed blocks shown while indexing continues
+
+class CArchiveChunk
+{
+public:
+    QFuture<CCSVChunk> future;
+    int file;
+    qint64 offset;
+    qint64 size;
+    int firstLine;
+};
+
+static bool archiveBlockLessThan(const CArchiveBlock &b1, const CArchiveBlock &b2)
+{
+    return (b1.firstKey<b2.firstKey);
+}
+
+CPlotBatch::CPlotBatch()
+{
+    schema.clear();
+    keys.clear();
+    values.clear();
+}
+
+bool CPlotBatch::isEmpty() const
+{
+    return (schema.isEmpty() || keys.isEmpty());
+}
+
+CCSVChunk::CCSVChunk()
+{
+    batches.clear();
+    errorMsg = QString();
+    errorLine = -1;
+}
+
+CArchiveBlock::CArchiveBlock()
+{
+    file = -1;
+    offset = 0;
+    size = 0;
+    firstLine = 0;
+    scans = 0;
+    firstKey = qQNaN();
+    lastKey = qQNaN();
+    ranges.clear();
+}
+
+CArchiveIndex::CArchiveIndex()
+{
+    files.clear();
+    schema.clear();
+    blocks.clear();
+    scans = 0;
+    channels.clear();
+    plottableCount = 0;
+}
+
+void CArchiveIndex::addWatchpoint(const CWP &wp)
+{
+    if (channels.contains(wp.getUuid())) return;
+
+    schema.append(wp);
+    if (CGraphForm::isPlottable(wp)) {
+        channels.insert(wp.getUuid(),plottableCount);
+        plottableCount++;
+    } else
+        channels.insert(wp.getUuid(),-1);
+}
+
+bool CArchiveIndex::isEmpty() const
+{
+    return blocks.isEmpty();
+}
+
+QCPRange CArchiveIndex::keyRange() const
+{
+    if (blocks.isEmpty()) return QCPRange(qQNaN(),qQNaN());
+
+    QCPRange res(blocks.first().firstKey,blocks.first().lastKey);
+    for (int i=1;i<blocks.count();i++)
+        res.expand(blocks.at(i).lastKey);
+    return res;
+}
+
+int CArchiveIndex::channelCount() const
+{
+    return plottableCount;
+}
+
+CMinMax CArchiveIndex::channelRange(int channel) const
+{
+    CMinMax res;
+    for (int i=0;i<blocks.count();i++) {
+        if (channel<blocks.at(i).ranges.count())
+            res.merge(blocks.at(i).ranges.at(channel));
+    }
+    return res;
+}
+
+int CArchiveIndex::findBlock(double key) const
+{
+    // first block, ending at or after key
+    int lo = 0;
+    int hi = blocks.count();
+    while (lo<hi) {
+        int mid = (lo+hi)/2;
+        if (blocks.at(mid).lastKey<key)
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+QVector<int> CArchiveIndex::channelMap(const CWPList &wp) const
+{
+    // archive channel for each plottable watchpoint of scan, -1 for unknown watchpoints
+    QVector<int> res;
+    for (int i=0;i<wp.count();i++) {
+        if (!CGraphForm::isPlottable(wp.at(i))) continue;
+        res.append(channels.value(wp.at(i).getUuid(),-1));
+    }
+    return res;
+}
+
+int CArchiveIndex::blockCost(int block) const
+{
+    // decoded block size estimation in KB, for cache accounting
+    if (block<0 || block>=blocks.count()) return 0;
+    qint64 bytes = static_cast<qint64>(blocks.at(block).scans)*(channelCount()+1)*
+                   static_cast<qint64>(sizeof(double));
+    return static_cast<int>(bytes/1024)+1;
+}
+
+CCSVLoader::CCSVLoader(QObject *parent) :
+    QObject(parent),
+    canceled(0),
+    pendingBatches(maxPendingBatches),
+    windowFirst(-1),
+    windowLast(-1)
+{
+    followWatcher = NULL;
+    followOffset = 0;
+    followLine = 0;
+}
+
+void CCSVLoader::cancel()
+{
+    canceled.storeRelease(1);
+}
+
+bool CCSVLoader::isCanceled() const
+{
+    return (canceled.loadAcquire()!=0);
+}
+
+void CCSVLoader::batchConsumed()
+{
+    pendingBatches.release();
+}
+
+void CCSVLoader::setWindow(int firstBlock, int lastBlock)
+{
+    windowFirst.storeRelease(firstBlock);
+    windowLast.storeRelease(lastBlock);
+}
+
+CCSVChunk CCSVLoader::decodeChunk(const QList<QByteArray> &lines, int firstLine)
+{
+    CCSVChunk res;
+    int lineNum = firstLine;
+    for (int i=0;i<lines.count();i++,lineNum++) {
+        QByteArray s = lines.at(i).trimmed();
+
+        // skip empty lines and additional title lines
+        // this is support for merged files
+        if (s.isEmpty() ||
+                s.startsWith("\"Time\"; ")) continue;
+
+        CWPList wp;
+        QDateTime dt;
+        res.errorMsg = CCSVHandler::decodeScanLine(s,dt,wp);
+        if (!res.errorMsg.isEmpty()) {
+            res.errorLine = lineNum;
+            return res;
+        }
+
+        if (wp.isEmpty()) {
+            res.errorMsg = trUtf8("Scan data is empty in file %1 at line %2.");
+            res.errorLine = lineNum;
+            return res;
+        }
+
+        // new batch on variables list change, comparing by uuid
+        if (res.batches.isEmpty() || res.batches.last().schema!=wp) {
+            CPlotBatch batch;
+            batch.schema = wp;
+            for (int j=0;j<wp.count();j++) {
+                if (CGraphForm::isPlottable(wp.at(j)))
+                    batch.values.append(QVector<double>());
+            }
+            res.batches.append(batch);
+        }
+
+        CPlotBatch &batch = res.batches.last();
+        batch.keys.append(static_cast<double>(dt.toMSecsSinceEpoch())/1000.0);
+        int vidx = 0;
+        for (int j=0;j<wp.count();j++) {
+            if (!CGraphForm::isPlottable(wp.at(j))) continue;
+            batch.values[vidx].append(CGraphForm::plotValue(wp.at(j)));
+            vidx++;
+        }
+    }
+    return res;
+}
+
+bool CCSVLoader::emitChunk(const CCSVChunk &chunk)
+{
+    if (!chunk.errorMsg.isEmpty()) return false;
+
+    for (int i=0;i<chunk.batches.count();i++) {
+        // wait for GUI thread, do not flood event queue with decoded data
+        while (!pendingBatches.tryAcquire(1,100)) {
+            if (isCanceled()) return false;
+        }
+        emit batchLoaded(chunk.batches.at(i));
+    }
+    return true;
+}
+
+void CCSVLoader::addArchiveBlock(const CCSVChunk &chunk, int file, qint64 offset, qint64 size, int firstLine)
+{
+    CArchiveBlock block;
+    block.file = file;
+    block.offset = offset;
+    block.size = size;
+    block.firstLine = firstLine;
+
+    for (int i=0;i<chunk.batches.count();i++) {
+        const CPlotBatch &batch = chunk.batches.at(i);
+        if (batch.isEmpty()) continue;
+
+        // variables list changes extend archive channels, old channels keep their numbers
+        for (int j=0;j<batch.schema.count();j++)
+            archive.addWatchpoint(batch.schema.at(j));
+        QVector<int> map = archive.channelMap(batch.schema);
+        block.ranges.resize(archive.channelCount());
+
+        if (qIsNaN(block.firstKey))
+            block.firstKey = batch.keys.first();
+        block.lastKey = batch.keys.last();
+        block.scans += batch.keys.count();
+
+        for (int j=0;j<map.count() && j<batch.values.count();j++) {
+            if (map.at(j)<0) continue;
+            CMinMax &range = block.ranges[map.at(j)];
+            const QVector<double> &values = batch.values.at(j);
+            for (int k=0;k<values.count();k++)
+                range.merge(values.at(k));
+        }
+    }
+
+    if (block.scans>0) {
+        archive.scans += block.scans;
+        archive.blocks.append(block);
+
+        // first screen while index pass is running
+        if (archive.blocks.count()<=previewBlocks)
+            emit archivePreview(chunk.batches);
+    }
+}
+
+void CCSVLoader::openArchive(const QStringList &files)
+{
+    canceled.storeRelease(0);
+    setWindow(-1,-1);
+    archive = CArchiveIndex();
+    archive.files = files;
+
+    // index pass: blocks decoded in parallel, only time range and values envelope are kept
+    qint64 total = 0;
+    for (int i=0;i<files.count();i++)
+        total += QFileInfo(files.at(i)).size();
+    total = qMax(Q_INT64_C(1),total);
+    qint64 processed = 0;
+    int lastProgress = -1;
+
+    QQueue<CArchiveChunk> pending;
+    int maxPending = qMax(2,QThread::idealThreadCount()*2);
+    QString errorMsg;
+
+    for (int fidx=0;fidx<files.count() && errorMsg.isEmpty() && !isCanceled();fidx++) {
+        const QString fname = files.at(fidx);
+        QFile f(fname);
+        if (!f.open(QIODevice::ReadOnly)) {
+            errorMsg = trUtf8("Unable to open file %1.").arg(fname);
+            break;
+        }
+        QByteArray s = f.readLine();
+        if (!s.startsWith("\"Time\"; ")) {
+            f.close();
+            errorMsg = trUtf8("Unrecognized CSV file %1.").arg(fname);
+            break;
+        }
+
+        int lineNum = 2;
+        while (!f.atEnd() && errorMsg.isEmpty() && !isCanceled()) {
+            CArchiveChunk chunk;
+            chunk.file = fidx;
+            chunk.offset = f.pos();
+            chunk.firstLine = lineNum;
+            QList<QByteArray> lines;
+            while (!f.atEnd() && lines.count()<linesPerBlock) {
+                lines.append(f.readLine());
+                lineNum++;
+            }
+            chunk.size = f.pos()-chunk.offset;
+            chunk.future = QtConcurrent::run(CCSVLoader::decodeChunk,lines,chunk.firstLine);
+            pending.enqueue(chunk);
+
+            while (pending.count()>=maxPending && errorMsg.isEmpty()) {
+                CArchiveChunk done = pending.dequeue();
+                CCSVChunk res = done.future.result();
+                if (!res.errorMsg.isEmpty())
+                    errorMsg = res.errorMsg.arg(files.at(done.file)).arg(res.errorLine);
+                else
+                    addArchiveBlock(res,done.file,done.offset,done.size,done.firstLine);
+            }
+
+            int progress = static_cast<int>((processed+f.pos())*100/total);
+            if (progress!=lastProgress) {
+                lastProgress = progress;
+                emit loadProgress(progress);
+            }
+        }
+        processed += f.size();
+        f.close();
+    }
+
+    while (!pending.isEmpty()) {
+        CArchiveChunk done = pending.dequeue();
+        CCSVChunk res = done.future.result();
+        if (!errorMsg.isEmpty() || isCanceled()) continue;
+        if (!res.errorMsg.isEmpty())
+            errorMsg = res.errorMsg.arg(files.at(done.file)).arg(res.errorLine);
+        else
+            addArchiveBlock(res,done.file,done.offset,done.size,done.firstLine);
+    }
+
+    // rotated files may be listed in any order
+    std::stable_sort(archive.blocks.begin(),archive.blocks.end(),archiveBlockLessThan);
+
+    if (errorMsg.isEmpty() && !isCanceled() && archive.isEmpty())
+        errorMsg = trUtf8("No scan data found.");
+
+    if (!errorMsg.isEmpty())
+        emit archiveIndexed(false,errorMsg,CArchiveIndex());
+    else if (isCanceled())
+        emit archiveIndexed(false,trUtf8("Archive indexing canceled."),CArchiveIndex());
+    else {
+        emit loadProgress(100);
+        emit archiveIndexed(true,trUtf8("Archive indexed: %1 files, %2 scans.")
+                            .arg(archive.files.count()).arg(archive.scans),archive);
+    }
+}
+
+void CCSVLoader::loadBlocks(const QList<int> &blocks)
+{
+    QQueue<QPair<int,QFuture<CCSVChunk> > > pending;
+    for (int i=0;i<blocks.count();i++) {
+        int idx = blocks.at(i);
+
+        // skip stale requests, plot window already moved away
+        if (isCanceled()) return;
+        if (idx<windowFirst.loadAcquire() || idx>windowLast.loadAcquire()) continue;
+        if (idx<0 || idx>=archive.blocks.count()) continue;
+
+        const CArchiveBlock &block = archive.blocks.at(idx);
+        QFile f(archive.files.value(block.file));
+        QList<QByteArray> lines;
+        if (f.open(QIODevice::ReadOnly) && f.seek(block.offset))
+            lines = f.read(block.size).split('\n');
+        f.close();
+
+        pending.enqueue(qMakePair(idx,QtConcurrent::run(CCSVLoader::decodeChunk,lines,block.firstLine)));
+    }
+
+    while (!pending.isEmpty()) {
+        QPair<int,QFuture<CCSVChunk> > done = pending.dequeue();
+        CCSVChunk chunk = done.second.result();
+        // corrupted block stays empty on plot
+        emit blockLoaded(done.first,chunk.batches);
+    }
+}
+
+void CCSVLoader::followFile(const QString &fname)
+{
+    stopFollow();
+    canceled.storeRelease(0);
+
+    QFile f(fname);
+    if (!f.open(QIODevice::ReadOnly)) {
+        emit followStopped(trUtf8("Unable to open file %1.").arg(fname));
+        return;
+    }
+    QByteArray s = f.readLine();
+    f.close();
+    if (!s.startsWith("\"Time\"; ")) {
+        emit followStopped(trUtf8("Unrecognized CSV file %1.").arg(fname));
+        return;
+    }
+
+    if (followWatcher==NULL) {
+        followWatcher = new QFileSystemWatcher(this);
+        connect(followWatcher,SIGNAL(fileChanged(QString)),this,SLOT(readAppended()));
+    }
+
+    followName = fname;
+    followOffset = 0;
+    followLine = 0;
+    followWatcher->addPath(fname);
+
+    // existing contents, then appended data on each file change notification
+    readAppended();
+}
+
+void CCSVLoader::stopFollow()
+{
+    if (followWatcher!=NULL && !followName.isEmpty())
+        followWatcher->removePath(followName);
+    followName.clear();
+}
+
+bool CCSVLoader::emitFollowLines(const QList<QByteArray> &lines, int firstLine)
+{
+    CCSVChunk chunk = decodeChunk(lines,firstLine);
+    if (!chunk.errorMsg.isEmpty()) {
+        QString msg = chunk.errorMsg.arg(followName).arg(chunk.errorLine);
+        stopFollow();
+        emit followStopped(msg);
+        return false;
+    }
+    return emitChunk(chunk);
+}
+
+void CCSVLoader::readAppended()
+{
+    if (followName.isEmpty()) return;
+
+    QFile f(followName);
+    if (!f.exists() || !f.open(QIODevice::ReadOnly)) {
+        QString msg = trUtf8("File %1 removed or renamed, follow mode stopped.").arg(followName);
+        stopFollow();
+        emit followStopped(msg);
+        return;
+    }
+
+    // watcher drops renamed and recreated files, watch again
+    if (!followWatcher->files().contains(followName))
+        followWatcher->addPath(followName);
+
+    // truncated or replaced file is read from start
+    if (f.size()<followOffset) {
+        followOffset = 0;
+        followLine = 0;
+    }
+    if (f.size()==followOffset || !f.seek(followOffset)) return;
+
+    // only complete lines are consumed, partial last line is read again on next change
+    QList<QByteArray> lines;
+    int firstLine = followLine+1;
+    while (!f.atEnd() && !isCanceled()) {
+        QByteArray line = f.readLine();
+        if (!line.endsWith('\n')) break;
+
+        followOffset = f.pos();
+        followLine++;
+        lines.append(line);
+        if (lines.count()<linesPerChunk) continue;
+
+        if (!emitFollowLines(lines,firstLine)) return;
+        lines.clear();
+        firstLine = followLine+1;
+    }
+    f.close();
+
+    if (!lines.isEmpty() && !isCanceled())
+        emitFollowLines(lines,firstLine);
+}
@@ -0,0 +1,129 @@
+#ifndef CSVLOADER_H
+#define CSVLOADER_H
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QUuid>
+#include <QByteArray>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include "qcustomplot-source/qcustomplot.h"
+#include "plc.h"
+#include "plotindex.h"
+
+class CPlotBatch
+{
+public:
+    CWPList schema; // watchpoints of the first scan in batch, all scans in batch share this list
+    QVector<double> keys;
+    QVector<QVector<double> > values; // one vector per plottable watchpoint, same size as keys
+    CPlotBatch();
+    bool isEmpty() const;
+};
+
+typedef QList<CPlotBatch> CPlotBatchList;
+
+class CCSVChunk
+{
+public:
+    CPlotBatchList batches;
+    QString errorMsg;
+    int errorLine;
+    CCSVChunk();
+};
+
+class CArchiveBlock
+{
+public:
+    int file;
+    qint64 offset; // block position in file, lines are decoded on demand
+    qint64 size;
+    int firstLine;
+    int scans;
+    double firstKey;
+    double lastKey;
+    QVector<CMinMax> ranges; // values envelope for each archive channel
+    CArchiveBlock();
+};
+
+class CArchiveIndex
+{
+public:
+    QStringList files;
+    CWPList schema; // all watchpoints found in archive, in order of appearance
+    QVector<CArchiveBlock> blocks; // sorted by time
+    qint64 scans;
+    CArchiveIndex();
+
+    void addWatchpoint(const CWP& wp);
+    bool isEmpty() const;
+    QCPRange keyRange() const;
+    int channelCount() const;
+    CMinMax channelRange(int channel) const;
+    int findBlock(double key) const;
+    QVector<int> channelMap(const CWPList &wp) const;
+    int blockCost(int block) const;
+
+private:
+    QHash<QUuid,int> channels; // archive channel by watchpoint uuid, -1 for non-plottable
+    int plottableCount;
+};
+
+class CCSVLoader : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CCSVLoader(QObject *parent = NULL);
+
+    // thread-safe, called from GUI thread
+    void cancel();
+    bool isCanceled() const;
+    void batchConsumed();
+    void setWindow(int firstBlock, int lastBlock);
+
+    static CCSVChunk decodeChunk(const QList<QByteArray> &lines, int firstLine);
+
+private:
+    QAtomicInt canceled;
+    QSemaphore pendingBatches;
+    QAtomicInt windowFirst;
+    QAtomicInt windowLast;
+    CArchiveIndex archive;
+    QFileSystemWatcher* followWatcher; // inotify on Linux
+    QString followName;
+    qint64 followOffset; // end of last complete line
+    int followLine;
+
+    bool emitChunk(const CCSVChunk &chunk);
+    void addArchiveBlock(const CCSVChunk &chunk, int file, qint64 offset, qint64 size, int firstLine);
+    bool emitFollowLines(const QList<QByteArray> &lines, int firstLine);
+
+signals:
+    void batchLoaded(const CPlotBatch& batch);
+    void loadProgress(int percent);
+    void archivePreview(const CPlotBatchList& batches);
+    void archiveIndexed(bool success, const QString& msg, const CArchiveIndex& index);
+    void blockLoaded(int block, const CPlotBatchList& batches);
+    void followStopped(const QString& msg);
+
+public slots:
+    void openArchive(const QStringList& files);
+    void loadBlocks(const QList<int>& blocks);
+    void followFile(const QString& fname);
+    void stopFollow();
+
+private slots:
+    void readAppended();
+
+};
+
+Q_DECLARE_METATYPE(CPlotBatch)
+Q_DECLARE_METATYPE(CPlotBatchList)
+Q_DECLARE_METATYPE(CArchiveIndex)
+
+#endif // CSVLOADER_H
@@ -1,4 +1,5 @@
 #include <QSettings>
+#include <QScopedPointer>
 
 #ifdef HAVE_QT5
 #include <QStandardPaths>
@@ -6,12 +7,15 @@
 #include <QDesktopServices>
 #endif
 
+#include <qnumeric.h>
 #include "global.h"
 #include "plc.h"
 
+#ifndef PLCRECORDERD
 static QSize openFileDialogSize = QSize();
 static QSize saveFileDialogSize = QSize();
 const bool dontUseNativeFileDialog = true;
+#endif
 
 CGlobal::CGlobal(QObject *parent) :
     QObject(parent)
@@ -23,11 +27,19 @@ CGlobal::CGlobal(QObject *parent) :
     plotVerticalSize = 100;
     plotShowScatter = false;
     plotAntialiasing = true;
+    plotFrameRate = 20;
+    plotMemoryLimit = 512;
+    vatRefreshRate = 10;
     tmMaxConnectRetryCount = 1;
     tmWaitReconnect = 2;
     tmTotalRetryCount = 1;
     suppressMsgBox = false;
     restoreCSV = false;
+    liveSegment = false;
+    liveSegmentName = QString("plcrecorder");
+    streamServer = false;
+    streamServerName = QString("plcrecorder-stream");
+    streamBroker = false;
     savedAuxDir = QString();
 }
 
@@ -49,6 +61,8 @@ QString CGlobal::plcGetAddrName(const CWP& aWp)
         case CWP::Timers:   res = "T"; break;
         default: return QString();
     }
+    if (wp.isSnapshot() && (wp.offset<0)) // whole DB
+        return res.left(res.length()-3);
     if ((wp.varea!=CWP::Counters) && (wp.varea!=CWP::Timers)) {
         switch (wp.vtype) {
             case CWP::S7BOOL:
@@ -58,6 +72,7 @@ QString CGlobal::plcGetAddrName(const CWP& aWp)
                     res += QString("%1.%2").arg(wp.offset).arg(wp.bitnum);
                 break;
             case CWP::S7BYTE:
+            case CWP::S7SNAPSHOT:
                 res += QString("B%1").arg(wp.offset);
                 break;
             case CWP::S7WORD:
@@ -79,6 +94,8 @@ QString CGlobal::plcGetAddrName(const CWP& aWp)
     } else {
         res += QString("%1").arg(wp.offset);
     }
+    if (wp.isArray() || wp.isSnapshot())
+        res += QString("[%1]").arg(wp.count);
     return res;
 }
 
@@ -100,6 +117,7 @@ QString CGlobal::plcGetTypeName(const CWP& aWp)
         case CWP::S7REAL:   return QString("REAL");
         case CWP::S7TIME:   return QString("TIME");
         case CWP::S7TIME_OF_DAY:    return QString("TOD");
+        case CWP::S7SNAPSHOT:   return QString("SNAPSHOT");
         default: return QString("----");
     }
 }
@@ -120,11 +138,14 @@ QStringList CGlobal::plcAvailableTypeNames()
     sl << QString("TOD");
     sl << QString("TIMER");
     sl << QString("COUNTER");
+    sl << QString("SNAPSHOT");
     return sl;
 }
 
 bool CGlobal::plcSetTypeForName(const QString &tname, CWP& wp)
 {
+    if (wp.isSnapshot() && (tname.toUpper().compare("SNAPSHOT")!=0))
+        wp.count = 1; // byte length is not an array length
     if (tname.toUpper().compare("BOOL")==0) {
         if (wp.offset<0) wp.offset = 0;
         wp.vtype=CWP::S7BOOL;
@@ -147,11 +168,13 @@ bool CGlobal::plcSetTypeForName(const QString &tname, CWP& wp)
     }
     if (tname.toUpper().compare("S5TIME")==0) {
         if (wp.offset<0) wp.offset = 0;
+        wp.count = 1; // no arrays of time types
         wp.vtype=CWP::S7S5TIME;
         return true;
     }
     if (tname.toUpper().compare("DATE")==0) {
         if (wp.offset<0) wp.offset = 0;
+        wp.count = 1;
         wp.vtype=CWP::S7DATE;
         return true;
     }
@@ -172,210 +195,240 @@ bool CGlobal::plcSetTypeForName(const QString &tname, CWP& wp)
     }
     if (tname.toUpper().compare("TIME")==0) {
         if (wp.offset<0) wp.offset = 0;
+        wp.count = 1;
         wp.vtype=CWP::S7TIME;
         return true;
     }
     if (tname.toUpper().compare("TOD")==0) {
         if (wp.offset<0) wp.offset = 0;
+        wp.count = 1;
         wp.vtype=CWP::S7TIME_OF_DAY;
         return true;
     }
     if (tname.toUpper().compare("TIMER")==0) {
         if (wp.offset<1) wp.offset = 1;
+        wp.count = 1;
         wp.vtype=CWP::S7WORD;
         wp.varea=CWP::Timers;
         return true;
     }
     if (tname.toUpper().compare("COUNTER")==0) {
         if (wp.offset<1) wp.offset = 1;
+        wp.count = 1;
         wp.vtype=CWP::S7INT;
         wp.varea=CWP::Counters;
         return true;
     }
+    if (tname.toUpper().compare("SNAPSHOT")==0) {
+        if ((wp.offset<0) && (wp.varea!=CWP::DB) && (wp.varea!=CWP::IDB)) wp.offset = 0;
+        if ((wp.varea==CWP::Timers) || (wp.varea==CWP::Counters)) wp.varea = CWP::NoArea;
+        wp.vtype=CWP::S7SNAPSHOT;
+        return true;
+    }
     return false;
 }
 
+CS7Address::CS7Address()
+{
+    varea = CWP::NoArea;
+    width = 0;
+    vdb = -1;
+    offset = -1;
+    bitnum = -1;
+    count = 1;
+}
+
+static inline ushort addrCharAt(const QChar* p, const QChar* end)
+{
+    if (p>=end) return 0;
+    ushort c = p->unicode();
+    if ((c>='a') && (c<='z')) c -= ('a'-'A');
+    return c;
+}
+
+static inline void addrSkipSpaces(const QChar* &p, const QChar* end)
+{
+    while ((p<end) && (p->isSpace()))
+        p++;
+}
+
+static inline bool addrReadNumber(const QChar* &p, const QChar* end, int &num)
+{
+    addrSkipSpaces(p,end);
+    const QChar* start = p;
+    num = 0;
+    while ((p<end) && (p->unicode()>='0') && (p->unicode()<='9')) {
+        num = num*10 + (p->unicode()-'0');
+        if (num>0xffffff) return false;
+        p++;
+    }
+    return (p>start);
+}
+
+bool CGlobal::plcTokenizeAddr(const QString &addr, CS7Address &res)
+{
+    // Single pass over address: area, DB number, width letter, offset, bit.
+    // English (I/Q/C) and German (E/A/Z) mnemonics are accepted, spaces between parts are allowed.
+    // DB without offset is block reference (symbol tables), offset is -1 then.
+    res = CS7Address();
+    const QChar* p = addr.constData();
+    const QChar* end = p+addr.length();
+    addrSkipSpaces(p,end);
+    ushort c = addrCharAt(p,end);
+    ushort c1 = addrCharAt(p+1,end);
+    ushort c2 = addrCharAt(p+2,end);
+    int num;
+
+    if ((c=='T') || (c=='C') || (c=='Z')) {
+        p++;
+        if (!addrReadNumber(p,end,num)) return false;
+        res.varea = (c=='T') ? CWP::Timers : CWP::Counters;
+        res.offset = num;
+    } else if (((c=='D') && (c1=='B')) || ((c=='I') && (c1=='D') && (c2=='B'))) {
+        res.varea = (c=='D') ? CWP::DB : CWP::IDB;
+        p += (c=='D') ? 2 : 3;
+        if (!addrReadNumber(p,end,num)) return false;
+        res.vdb = num;
+        addrSkipSpaces(p,end);
+        if (p==end) return true;
+        if (p->unicode()!='.') return false;
+        p++;
+        addrSkipSpaces(p,end);
+        if ((addrCharAt(p,end)!='D') || (addrCharAt(p+1,end)!='B')) return false;
+        p += 2;
+        c = addrCharAt(p,end);
+        if ((c!='X') && (c!='B') && (c!='W') && (c!='D')) return false;
+        res.width = static_cast<char>(c);
+        p++;
+        if (!addrReadNumber(p,end,num)) return false;
+        res.offset = num;
+    } else {
+        if ((c=='I') || (c=='E')) res.varea = CWP::Inputs;
+        else if ((c=='Q') || (c=='A')) res.varea = CWP::Outputs;
+        else if (c=='M') res.varea = CWP::Merkers;
+        else return false;
+        p++;
+        c = addrCharAt(p,end);
+        if ((c=='X') || (c=='B') || (c=='W') || (c=='D')) {
+            res.width = static_cast<char>(c);
+            p++;
+        } else
+            res.width = 'X';
+        if (!addrReadNumber(p,end,num)) return false;
+        res.offset = num;
+    }
+
+    if (res.width=='X') {
+        addrSkipSpaces(p,end);
+        if ((p==end) || (p->unicode()!='.')) return false;
+        p++;
+        if (!addrReadNumber(p,end,num) || (num>7)) return false;
+        res.bitnum = num;
+    }
+
+    // optional array length: DB10.DBD0[200]
+    addrSkipSpaces(p,end);
+    if ((p<end) && (p->unicode()=='[') && (res.width!=0)) {
+        p++;
+        if (!addrReadNumber(p,end,num) || (num<1)) return false;
+        addrSkipSpaces(p,end);
+        if ((p==end) || (p->unicode()!=']')) return false;
+        p++;
+        res.count = num;
+        addrSkipSpaces(p,end);
+    }
+    return (p==end);
+}
+
+char CGlobal::plcTypeWidth(CWP::VType vtype)
+{
+    switch (vtype) {
+        case CWP::S7BOOL:
+            return 'X';
+        case CWP::S7BYTE:
+            return 'B';
+        case CWP::S7WORD:
+        case CWP::S7INT:
+        case CWP::S7S5TIME:
+        case CWP::S7DATE:
+            return 'W';
+        case CWP::S7DWORD:
+        case CWP::S7DINT:
+        case CWP::S7REAL:
+        case CWP::S7TIME:
+        case CWP::S7TIME_OF_DAY:
+            return 'D';
+        default:
+            return 0;
+    }
+}
+
 bool CGlobal::plcParseAddr(const QString &addr, CWP &wp)
 {
     // plcSetTypeForName must be called before this on same wp
-    QString s = addr.toUpper().trimmed();
-    if (wp.varea==CWP::Timers) {
-        if (!s.startsWith('T')) return false;
-        s.remove('T');
-        bool okconv;
-        int t = s.toInt(&okconv);
-        if (!okconv) return false;
-        if (t<0) return false;
-        wp.offset = t;
+    CS7Address a;
+    if (!plcTokenizeAddr(addr,a)) return false;
+    if (wp.isSnapshot()) {
+        // DB block reference is whole DB, length is read from PLC on connect
+        if ((a.varea==CWP::Timers) || (a.varea==CWP::Counters)) return false;
+        if ((a.width!=0) && (a.width!='B')) return false;
+        wp.varea = a.varea;
+        wp.offset = a.offset;
         wp.bitnum = -1;
-        wp.vdb = -1;
-    } else if (wp.varea==CWP::Counters) {
-        if (!s.startsWith('C')) return false;
-        s.remove('C');
-        bool okconv;
-        int t = s.toInt(&okconv);
-        if (!okconv) return false;
-        if (t<0) return false;
-        wp.offset = t;
+        wp.vdb = a.vdb;
+        wp.count = a.count;
+    } else if ((wp.varea==CWP::Timers) || (wp.varea==CWP::Counters)) {
+        if (a.varea!=wp.varea) return false;
+        wp.offset = a.offset;
         wp.bitnum = -1;
         wp.vdb = -1;
     } else {
-        CWP::VArea tarea;
-        if (s.startsWith("IDB")) tarea = CWP::IDB;
-        else if (s.startsWith('I')) tarea = CWP::Inputs;
-        else if (s.startsWith('Q')) tarea = CWP::Outputs;
-        else if (s.startsWith('M')) tarea = CWP::Merkers;
-        else if (s.startsWith("DB")) tarea = CWP::DB;
-        else return false;
-        bool okconv1,okconv2;
-        int ofs, bit;
-        QStringList sl;
-
-        if ((tarea==CWP::Inputs) || (tarea==CWP::Outputs) || (tarea==CWP::Merkers)) {
-            if ((tarea==CWP::Inputs) && (!s.startsWith('I'))) return false;
-            if ((tarea==CWP::Outputs) && (!s.startsWith('Q'))) return false;
-            if ((tarea==CWP::Merkers) && (!s.startsWith('M'))) return false;
-            s.remove(0,1);
-            switch (wp.vtype) {
-                case CWP::S7BOOL:
-                    if ((!s.at(0).isDigit()) || (!s.contains('.')) || (!s.at(s.length()-1).isDigit())) return false;
-                    sl = s.split('.');
-                    if (sl.count()!=2) return false;
-                    ofs = sl.first().toInt(&okconv1);
-                    bit = sl.last().toInt(&okconv2);
-                    if ((!okconv1) || (!okconv2)) return false;
-                    if ((bit>7) || (bit<0) || (ofs<0)) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = bit;
-                    wp.vdb = -1;
-                    break;
-                case CWP::S7BYTE:
-                    if (!s.startsWith('B')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = -1;
-                    break;
-                case CWP::S7WORD:
-                case CWP::S7INT:
-                case CWP::S7S5TIME:
-                case CWP::S7DATE:
-                    if (!s.startsWith('W')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = -1;
-                    break;
-                case CWP::S7DWORD:
-                case CWP::S7DINT:
-                case CWP::S7REAL:
-                case CWP::S7TIME:
-                case CWP::S7TIME_OF_DAY:
-                    if (!s.startsWith('D')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = -1;
-                    break;
-                default:
-                    return false;
-            }
-        } else if ((tarea==CWP::DB) || (tarea==CWP::IDB)) {
-            if ((tarea==CWP::DB) && (!s.startsWith("DB"))) return false;
-            if ((tarea==CWP::IDB) && (!s.startsWith("IDB"))) return false;
-            if (tarea==CWP::DB) s.remove(0,2);
-            if (tarea==CWP::IDB) s.remove(0,3);
-
-            QString dotDB = QString(".DB");
-            if (!s.contains(dotDB)) return false;
-            int tdb = s.left(s.indexOf(dotDB)).toInt(&okconv1);
-            if (!okconv1) return false;
-            s.remove(0,s.indexOf(dotDB)+dotDB.length());
-
-            switch (wp.vtype) {
-                case CWP::S7BOOL:
-                    if (!s.startsWith('X')) return false;
-                    s.remove(0,1);
-                    if ((!s.at(0).isDigit()) ||
-                            (!s.contains('.')) ||
-                            (!s.at(s.length()-1).isDigit())) return false;
-                    sl = s.split('.');
-                    if (sl.count()!=2) return false;
-                    ofs = sl.first().toInt(&okconv1);
-                    bit = sl.last().toInt(&okconv2);
-                    if ((!okconv1) || (!okconv2)) return false;
-                    if ((bit>7) || (bit<0) || (ofs<0)) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = bit;
-                    wp.vdb = tdb;
-                    break;
-                case CWP::S7BYTE:
-                    if (!s.startsWith('B')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = tdb;
-                    break;
-                case CWP::S7WORD:
-                case CWP::S7INT:
-                case CWP::S7S5TIME:
-                case CWP::S7DATE:
-                    if (!s.startsWith('W')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = tdb;
-                    break;
-                case CWP::S7DWORD:
-                case CWP::S7DINT:
-                case CWP::S7REAL:
-                case CWP::S7TIME:
-                case CWP::S7TIME_OF_DAY:
-                    if (!s.startsWith('D')) return false;
-                    s.remove(0,1);
-                    ofs = s.toInt(&okconv1);
-                    if (!okconv1) return false;
-                    if (ofs<0) return false;
-                    wp.varea = tarea;
-                    wp.offset = ofs;
-                    wp.bitnum = -1;
-                    wp.vdb = tdb;
-                    break;
-                default:
-                    return false;
-            }
-        } else
-            return false;
+        if ((a.offset<0) || (a.varea==CWP::Timers) || (a.varea==CWP::Counters)) return false;
+        if (a.width!=plcTypeWidth(wp.vtype)) return false;
+        if ((a.count>1) && !plcIsArrayType(wp.vtype)) return false;
+        wp.varea = a.varea;
+        wp.offset = a.offset;
+        wp.bitnum = a.bitnum;
+        wp.vdb = a.vdb;
+        wp.count = a.count;
     }
-    wp.data=QVariant();
+    wp.data=CWPValue();
     return true;
 }
 
+QString CGlobal::plcFormatArrayElement(const CWP &wp, int idx)
+{
+    double v = wp.arrayValue(idx);
+    if (qIsNaN(v)) return QString();
+    switch (wp.vtype) {
+        case CWP::S7BYTE:
+            return QString("0x%1").arg(static_cast<uint>(v),2,16,QChar('0'));
+        case CWP::S7WORD:
+            return QString("0x%1").arg(static_cast<uint>(v),4,16,QChar('0'));
+        case CWP::S7DWORD:
+            return QString("0x%1").arg(static_cast<uint>(v),8,16,QChar('0'));
+        case CWP::S7REAL:
+            if (qAbs(v)>1e6 || qAbs(v)<0.001)
+                return QString::number(v,'e',4);
+            else
+                return QString::number(v,'f',3);
+        default:
+            return QString::number(v,'f',0);
+    }
+}
+
 QString CGlobal::plcFormatActualValue(const CWP &wp)
 {
     if (wp.data.isNull() || !wp.data.isValid()) return QString();
+    if (wp.isSnapshot())
+        return trUtf8("%1 bytes").arg(wp.data.toByteArray().size());
+    if (wp.isArray()) {
+        QStringList sl;
+        sl.reserve(wp.count);
+        for (int i=0;i<wp.count;i++)
+            sl << plcFormatArrayElement(wp,i);
+        return sl.join(QChar(' '));
+    }
     double data;
     switch (wp.vtype) {
         case CWP::S7BYTE:
@@ -405,7 +458,14 @@ QString CGlobal::plcFormatActualValue(const CWP &wp)
 
 bool CGlobal::plcIsPlottableType(const CWP &aWp)
 {
-    switch (aWp.vtype) {
+    // arrays are shown in waterfall view
+    if (aWp.isArray()) return false;
+    return plcIsArrayType(aWp.vtype);
+}
+
+bool CGlobal::plcIsArrayType(CWP::VType vtype)
+{
+    switch (vtype) {
         case CWP::S7BOOL:
         case CWP::S7BYTE:
         case CWP::S7WORD:
@@ -419,7 +479,7 @@ bool CGlobal::plcIsPlottableType(const CWP &aWp)
     }
 }
 
-void CGlobal::loadSettings()
+void CGlobal::loadSettings(const QString &fileName)
 {
 #ifdef HAVE_QT5
     QString docs = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
@@ -427,22 +487,34 @@ void CGlobal::loadSettings()
     QString docs = QDesktopServices::storageLocation(QDesktopServices::DocumentsLocation);
 #endif
 
-    QSettings settings("kernel1024", "plcrecorder");
-    settings.beginGroup("Settings");
-    gSet->outputCSVDir = settings.value("outputCSVDir",docs).toString();
-    gSet->outputFileTemplate = settings.value("outputFileTemplate",QString()).toString();
-    gSet->tmTCPTimeout = settings.value("timeTCPTimeout",5000000).toInt();
-    gSet->tmMaxRecErrorCount = settings.value("timeMaxRecErrorCount",50).toInt();
-    gSet->tmMaxConnectRetryCount = settings.value("timeMaxConnectRetryCount",1).toInt();
-    gSet->tmTotalRetryCount = settings.value("timeTotalRetryCount",1).toInt();
-    gSet->tmWaitReconnect = settings.value("timeWaitReconnect",2).toInt();
-    gSet->suppressMsgBox = settings.value("suppressMsgBox",false).toBool();
-    gSet->restoreCSV = settings.value("restoreCSV",false).toBool();
-    gSet->plotVerticalSize = settings.value("plotVerticalSize",100).toInt();
-    gSet->plotShowScatter = settings.value("plotShowScatter",false).toBool();
-    gSet->plotAntialiasing = settings.value("plotAntialiasing",true).toBool();
-    gSet->savedAuxDir = settings.value("savedAuxDir",QString()).toString();
-    settings.endGroup();
+    QScopedPointer<QSettings> settings;
+    if (fileName.isEmpty())
+        settings.reset(new QSettings("kernel1024", "plcrecorder"));
+    else
+        settings.reset(new QSettings(fileName, QSettings::IniFormat));
+    settings->beginGroup("Settings");
+    gSet->outputCSVDir = settings->value("outputCSVDir",docs).toString();
+    gSet->outputFileTemplate = settings->value("outputFileTemplate",QString()).toString();
+    gSet->tmTCPTimeout = settings->value("timeTCPTimeout",5000000).toInt();
+    gSet->tmMaxRecErrorCount = settings->value("timeMaxRecErrorCount",50).toInt();
+    gSet->tmMaxConnectRetryCount = settings->value("timeMaxConnectRetryCount",1).toInt();
+    gSet->tmTotalRetryCount = settings->value("timeTotalRetryCount",1).toInt();
+    gSet->tmWaitReconnect = settings->value("timeWaitReconnect",2).toInt();
+    gSet->suppressMsgBox = settings->value("suppressMsgBox",false).toBool();
+    gSet->restoreCSV = settings->value("restoreCSV",false).toBool();
+    gSet->plotVerticalSize = settings->value("plotVerticalSize",100).toInt();
+    gSet->plotShowScatter = settings->value("plotShowScatter",false).toBool();
+    gSet->plotAntialiasing = settings->value("plotAntialiasing",true).toBool();
+    gSet->plotFrameRate = settings->value("plotFrameRate",20).toInt();
+    gSet->plotMemoryLimit = settings->value("plotMemoryLimit",512).toInt();
+    gSet->vatRefreshRate = settings->value("vatRefreshRate",10).toInt();
+    gSet->liveSegment = settings->value("liveSegment",false).toBool();
+    gSet->liveSegmentName = settings->value("liveSegmentName",QString("plcrecorder")).toString();
+    gSet->streamServer = settings->value("streamServer",false).toBool();
+    gSet->streamServerName = settings->value("streamServerName",QString("plcrecorder-stream")).toString();
+    gSet->streamBroker = settings->value("streamBroker",false).toBool();
+    gSet->savedAuxDir = settings->value("savedAuxDir",QString()).toString();
+    settings->endGroup();
 }
 
 void CGlobal::saveSettings()
@@ -461,10 +533,19 @@ void CGlobal::saveSettings()
     settings.setValue("plotVerticalSize",gSet->plotVerticalSize);
     settings.setValue("plotShowScatter",gSet->plotShowScatter);
     settings.setValue("plotAntialiasing",gSet->plotAntialiasing);
+    settings.setValue("plotFrameRate",gSet->plotFrameRate);
+    settings.setValue("plotMemoryLimit",gSet->plotMemoryLimit);
+    settings.setValue("vatRefreshRate",gSet->vatRefreshRate);
+    settings.setValue("liveSegment",gSet->liveSegment);
+    settings.setValue("liveSegmentName",gSet->liveSegmentName);
+    settings.setValue("streamServer",gSet->streamServer);
+    settings.setValue("streamServerName",gSet->streamServerName);
+    settings.setValue("streamBroker",gSet->streamBroker);
     settings.setValue("savedAuxDir",gSet->savedAuxDir);
     settings.endGroup();
 }
 
+#ifndef PLCRECORDERD
 QString getOpenFileNameD (QWidget * parent, const QString & caption, const QString & dir,
                           const QString & filter, QString * selectedFilter)
 {
@@ -587,3 +668,4 @@ QString	getExistingDirectoryD ( QWidget * parent, const QString & caption, const
 
     return QFileDialog::getExistingDirectory(parent,caption,dir,opts);
 }
+#endif // PLCRECORDERD
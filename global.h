@@ -3,9 +3,25 @@
 
 #include <QObject>
 #include <QString>
+#ifndef PLCRECORDERD
 #include <QFileDialog>
+#endif
 #include "plc.h"
 
+#define PLR_VERSION 2
+
+class CS7Address
+{
+public:
+    CWP::VArea varea;
+    char width; // X, B, W, D; 0 for timers, counters and DB block references
+    int vdb;
+    int offset;
+    int bitnum;
+    int count; // array length suffix [n], 1 if absent
+    CS7Address();
+};
+
 class CGlobal : public QObject
 {
     Q_OBJECT
@@ -18,6 +34,14 @@ public:
     int plotVerticalSize;
     bool plotShowScatter;
     bool plotAntialiasing;
+    int plotFrameRate;
+    int plotMemoryLimit;
+    int vatRefreshRate;
+    bool liveSegment;
+    QString liveSegmentName;
+    bool streamServer;
+    QString streamServerName;
+    bool streamBroker;
 
     QString savedAuxDir;
 
@@ -30,16 +54,21 @@ public:
     QString plcGetTypeName(const CWP& aWp);
     QStringList plcAvailableTypeNames();
     bool plcSetTypeForName(const QString& tname, CWP &wp);
+    bool plcTokenizeAddr(const QString& addr, CS7Address &res);
+    char plcTypeWidth(CWP::VType vtype);
     bool plcParseAddr(const QString& addr, CWP &wp);
     QString plcFormatActualValue(const CWP& wp);
+    QString plcFormatArrayElement(const CWP& wp, int idx);
     bool plcIsPlottableType(const CWP& aWp);
+    bool plcIsArrayType(CWP::VType vtype);
 
-    void loadSettings();
+    void loadSettings(const QString& fileName = QString()); // ini file instead of user settings
     void saveSettings();
 };
 
 extern CGlobal* gSet;
 
+#ifndef PLCRECORDERD
 QString getOpenFileNameD ( QWidget * parent = NULL, const QString & caption = QString(),
                            const QString & dir = QString(), const QString & filter = QString(),
                            QString * selectedFilter = NULL);
@@ -55,4 +84,6 @@ QString getSaveFileNameD (QWidget * parent = NULL, const QString & caption = QSt
 QString	getExistingDirectoryD ( QWidget * parent = NULL, const QString & caption = QString(),
                                 const QString & dir = QString(),
                                 QFileDialog::Options options = QFileDialog::ShowDirsOnly);
+#endif // PLCRECORDERD
+
 #endif // CGLOBAL_H
@@ -3,14 +3,18 @@
 #include <QSharedPointer>
 #include <QMenu>
 #include <QMessageBox>
-#include <QBuffer>
 #include <QDesktopWidget>
+#include <QDir>
+#include <QtConcurrentMap>
 #include "ui_graphform.h"
 #include "graphform.h"
 #include <QDebug>
 
 static QList<int> validArea;
 const static double zoomIncrements = 0.2; // in percents of actual data range
+const static int downsampleFactor = 16; // old plot history compression, for each pass
+const static double archivePrefetch = 1.0; // in visible ranges, decoded at both sides of visible range
+const static int maxArchiveWindow = 64; // blocks, wider ranges are shown as block envelopes
 
 void initGraphFormData()
 {
@@ -18,6 +22,28 @@ void initGraphFormData()
     validArea << CWP::Inputs << CWP::Outputs << CWP::Merkers << CWP::DB << CWP::IDB;
 }
 
+static void renderTile(CCachedPlottable *plottable)
+{
+    plottable->renderCache();
+}
+
+CPlotChannel::CPlotChannel()
+{
+    column = -1;
+    digital = -1;
+    valueRange = QCPRange(-5.0,50.0);
+}
+
+CPlotRow::CPlotRow()
+{
+    rect = NULL;
+    xAxis = NULL;
+    yAxis = NULL;
+    graph = NULL;
+    digital = NULL;
+    channel = -1;
+}
+
 CGraphForm::CGraphForm(QWidget *parent) :
     QWidget(parent),
     ui(new Ui::CGraphForm)
@@ -31,44 +57,118 @@ CGraphForm::CGraphForm(QWidget *parent) :
     watchpoints.clear();
 
     ui->plot->setContextMenuPolicy(Qt::CustomContextMenu);
+    ui->plot->installEventFilter(this);
 
     connect(ui->plot,SIGNAL(mouseMove(QMouseEvent*)),this,SLOT(plotMouseMove(QMouseEvent*)));
+    connect(ui->plot,SIGNAL(beforeReplot()),this,SLOT(renderTiles()));
     connect(ui->btnLoadCSV,SIGNAL(clicked()),this,SLOT(loadCSV()));
+    connect(ui->btnLoadDir,SIGNAL(clicked()),this,SLOT(loadArchiveDir()));
+    connect(ui->btnFollow,SIGNAL(clicked()),this,SLOT(followCSV()));
     connect(ui->btnExport,SIGNAL(clicked()),this,SLOT(exportGraph()));
     connect(ui->horizontalScrollBar,SIGNAL(valueChanged(int)),this,SLOT(scrollBarMoved(int)));
+    connect(ui->verticalScrollBar,SIGNAL(valueChanged(int)),this,SLOT(verticalScrollBarMoved(int)));
     connect(ui->plot,SIGNAL(customContextMenuRequested(QPoint)),this,SLOT(plotContextMenu(QPoint)));
+    connect(ui->btnCancelLoad,SIGNAL(clicked()),this,SLOT(cancelLoading()));
+    connect(ui->checkAutoScroll,SIGNAL(toggled(bool)),this,SLOT(autoScrollToggled(bool)));
 
     ui->splitter->setCollapsible(0,false);
     ui->splitter->setCollapsible(1,true);
 
+    loaderActive = false;
+    followActive = false;
+    analysisForm = NULL;
+    archiveActive = false;
+    archiveDirty = false;
+    archiveBlocksChanged = false;
+    archiveFirst = -1;
+    archiveLast = -1;
+    replotPending = false;
+    ui->progressLoad->hide();
+    ui->btnCancelLoad->hide();
+
+    loader = new CCSVLoader();
+    loaderThread = new QThread(this);
+    loader->moveToThread(loaderThread);
+    connect(loaderThread,SIGNAL(finished()),loader,SLOT(deleteLater()));
+    connect(this,SIGNAL(openArchiveRequest(QStringList)),loader,SLOT(openArchive(QStringList)),Qt::QueuedConnection);
+    connect(this,SIGNAL(loadBlocksRequest(QList<int>)),loader,SLOT(loadBlocks(QList<int>)),Qt::QueuedConnection);
+    connect(loader,SIGNAL(loadProgress(int)),this,SLOT(loaderProgress(int)),Qt::QueuedConnection);
+    connect(loader,SIGNAL(archivePreview(CPlotBatchList)),
+            this,SLOT(archivePreview(CPlotBatchList)),Qt::QueuedConnection);
+    connect(loader,SIGNAL(archiveIndexed(bool,QString,CArchiveIndex)),
+            this,SLOT(archiveIndexed(bool,QString,CArchiveIndex)),Qt::QueuedConnection);
+    connect(loader,SIGNAL(blockLoaded(int,CPlotBatchList)),
+            this,SLOT(archiveBlockLoaded(int,CPlotBatchList)),Qt::QueuedConnection);
+    connect(this,SIGNAL(followFileRequest(QString)),loader,SLOT(followFile(QString)),Qt::QueuedConnection);
+    connect(this,SIGNAL(stopFollowRequest()),loader,SLOT(stopFollow()),Qt::QueuedConnection);
+    connect(loader,SIGNAL(batchLoaded(CPlotBatch)),this,SLOT(followBatchLoaded(CPlotBatch)),Qt::QueuedConnection);
+    connect(loader,SIGNAL(followStopped(QString)),this,SLOT(followStopped(QString)),Qt::QueuedConnection);
+    loaderThread->start();
+
+    // replots limited to configured frame rate, independent from acquisition rate
+    frameTimer = new QTimer(this);
+    frameTimer->setInterval(1000/qBound(1,gSet->plotFrameRate,100));
+    connect(frameTimer,SIGNAL(timeout()),this,SLOT(frameTick()));
+    frameTimer->start();
+
+    memoryTimer = new QTimer(this);
+    memoryTimer->setInterval(2000);
+    connect(memoryTimer,SIGNAL(timeout()),this,SLOT(checkMemoryLimit()));
+    memoryTimer->start();
+
     clearData();
 }
 
 CGraphForm::~CGraphForm()
 {
+    loader->cancel();
+    loaderThread->quit();
+    loaderThread->wait();
     delete ui;
 }
 
+bool CGraphForm::isPlottable(const CWP &wp)
+{
+    // skip timers and counters, date/time types
+    return (validArea.contains(wp.varea) && gSet->plcIsPlottableType(wp));
+}
+
+double CGraphForm::plotValue(const CWP &wp)
+{
+    switch (wp.vtype) {
+        case CWP::S7BOOL:
+            if (wp.data.toBool())
+                return 1.0;
+            return 0.0;
+        case CWP::S7BYTE:
+        case CWP::S7WORD:
+        case CWP::S7DWORD:
+            return static_cast<double>(wp.data.toUInt());
+        case CWP::S7INT:
+        case CWP::S7DINT:
+            return static_cast<double>(wp.data.toInt());
+        case CWP::S7REAL:
+            return wp.data.toDouble();
+        default:
+            return 0.0;
+    }
+}
+
 void CGraphForm::setupGraphs(const CWPList &wp)
 {
     bool lazyModification = ((wp.count()>watchpoints.count()) &&  // new WP added, check old WPs
                              (watchpoints == wp.mid(0,watchpoints.count()))); // old WPs still here, new WPs added to the end
     clearDataEx(lazyModification);
 
-    QCPRange xRange(qQNaN(),qQNaN());
-    int idx = 0;
+    // channels only, axis rects are created for visible rows
     for (int i=0;i<wp.count();i++) {
-        // skip timers and counters, date/time types
-        if (!validArea.contains(wp.at(i).varea) || !gSet->plcIsPlottableType(wp.at(i))) continue;
-
-        if (lazyModification && i<watchpoints.count()) {
-            // Copy range from initialized graph
-            if (!QCPRange::validRange(xRange))
-                xRange = ui->plot->graph(idx)->keyAxis()->range();
-            // skip old WPs initialization
-            idx++;
-            continue;
-        }
+        if (!isPlottable(wp.at(i))) continue;
+
+        // skip old WPs initialization
+        if (lazyModification && i<watchpoints.count()) continue;
+
+        CPlotChannel channel;
+        channel.wp = wp.at(i);
 
         // default value ranges
         double yMin, yMax;
@@ -76,6 +176,7 @@ void CGraphForm::setupGraphs(const CWPList &wp)
             case CWP::S7BOOL:
                 yMin = 0.0;
                 yMax = 1.0;
+                channel.digital = plotData.addDigital();
                 break;
             case CWP::S7BYTE:
             case CWP::S7WORD:
@@ -85,165 +186,375 @@ void CGraphForm::setupGraphs(const CWPList &wp)
             case CWP::S7REAL:
                 yMin = -5.0;
                 yMax = 50.0;
+                channel.column = plotData.addColumn(wp.at(i).vtype==CWP::S7DINT ||
+                                                    wp.at(i).vtype==CWP::S7DWORD);
                 break;
             default:
-                idx++;
-                continue; // Special type, no visualization
+                yMin = 0.0; // Special type, no visualization
+                yMax = 1.0;
+                break;
         }
 
+        double yRange = qAbs(yMax-yMin);
+        channel.valueRange = QCPRange(yMin-(yRange*0.1),yMax+(yRange*0.1));
+        channels.append(channel);
+    }
+
+    layoutRows();
+    ui->plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectPlottables);
+
+    watchpoints = wp;
+}
+
+void CGraphForm::layoutRows()
+{
+    // axis rects only for rows fitting into plot height, so plot cost follows screen size
+    int rowHeight = qMax(20,gSet->plotVerticalSize);
+    int fullRows = qMax(1,ui->plot->height()/rowHeight);
+    int count = qMin(channels.count(),qMax(1,(ui->plot->height()+rowHeight-1)/rowHeight));
+
+    if (count!=plotRows.count()) {
+        QCPRange xRange = visibleKeyRange();
+        removeCursors();
+
         QCPLayoutGrid* grid = ui->plot->plotLayout();
+        while (plotRows.count()>count) {
+            CPlotRow row = plotRows.takeLast();
+            ui->plot->removePlottable(row.graph);
+            ui->plot->removePlottable(row.digital);
+            grid->remove(row.rect);
+        }
+        grid->simplify();
+
+        while (plotRows.count()<count) {
+            int idx = plotRows.count();
+            CPlotRow row;
+
+            // create axis grid, placed in new layout element
+            row.rect = new QCPAxisRect(ui->plot,false);
+            grid->addElement(idx,0,row.rect);
+
+            // grid geometry
+            grid->setRowSpacing(0);
+            row.rect->setMinimumMargins(QMargins(0,0,0,0));
+            row.rect->setMinimumSize(100,rowHeight);
+            row.rect->setMaximumSize(getScreenWidth(),rowHeight);
+
+            // enable drag and zoom for xAxis
+            row.xAxis = row.rect->addAxis(QCPAxis::atTop);
+            row.yAxis = row.rect->addAxis(QCPAxis::atLeft);
+            row.rect->setRangeDragAxes(row.xAxis,NULL);
+            row.rect->setRangeZoomAxes(row.xAxis,NULL);
+
+            QFont font = row.yAxis->labelFont();
+            font.setPointSize(6);
+            row.yAxis->setLabelFont(font);
+            row.yAxis->setTickLabelSide(QCPAxis::lsInside);
+            row.yAxis->setTickLabelFont(font);
+
+            // date/time ticks for xAxis
+            if (idx==0) {
+                QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
+                dateTicker->setDateTimeFormat("h:mm:ss.zzz\nd.MM.yyyy");
+                row.xAxis->setTicker(dateTicker);
+                row.xAxis->setTickLabelFont(font);
+            } else
+                row.xAxis->setTickLabels(false);
+
+            row.xAxis->grid()->setVisible(true);
+            row.yAxis->grid()->setVisible(true);
+
+            // both plottable types in each row, rebound to channels while scrolling
+            row.graph = new CLODGraph(row.xAxis,row.yAxis,&plotData,-1);
+            row.graph->setAntialiased(gSet->plotAntialiasing);
+            if (gSet->plotShowScatter)
+                row.graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssPlus));
+            row.digital = new CDigitalGraph(row.xAxis,row.yAxis,&plotData,-1);
+            row.digital->setAntialiased(gSet->plotAntialiasing);
+            row.graph->setFollowMode(ui->checkAutoScroll->isChecked());
+            row.digital->setFollowMode(ui->checkAutoScroll->isChecked());
+
+            row.xAxis->setRange(xRange);
+
+            // handle xAxis drag
+            connect(row.xAxis,SIGNAL(rangeChanged(QCPRange)),this,SLOT(plotRangeChanged(QCPRange)));
+
+            plotRows.append(row);
+        }
+    }
 
-        // create axis grid, placed in new layout element
-        QCPAxisRect* rect = new QCPAxisRect(ui->plot,false);
-        grid->addElement(idx,0,rect);
+    ui->verticalScrollBar->setRange(0,qMax(0,channels.count()-fullRows));
+    ui->verticalScrollBar->setPageStep(fullRows);
+    ui->verticalScrollBar->setEnabled(channels.count()>fullRows);
 
-        // grid geometry, affects scrolling and sizeHint's
-        grid->setRowSpacing(0);
-        rect->setMinimumMargins(QMargins(0,0,0,0));
-        rect->setMinimumSize(100,gSet->plotVerticalSize);
-        rect->setMaximumSize(getScreenWidth(),gSet->plotVerticalSize);
+    bindRows();
+}
 
-        // enable drag and zoom for xAxis
-        QCPAxis* xAxis = rect->addAxis(QCPAxis::atTop);
-        QCPAxis* yAxis = rect->addAxis(QCPAxis::atLeft);
-        rect->setRangeDragAxes(xAxis,NULL);
-        rect->setRangeZoomAxes(xAxis,NULL);
+void CGraphForm::bindRows()
+{
+    int first = ui->verticalScrollBar->value();
+    for (int i=0;i<plotRows.count();i++) {
+        CPlotRow &row = plotRows[i];
+        int idx = first+i;
+        if (idx>=channels.count())
+            idx = -1;
+        row.channel = idx;
+        row.rect->setVisible(idx>=0);
+        if (idx<0) continue;
+
+        const CPlotChannel &channel = channels.at(idx);
+        row.graph->setColumn(channel.column);
+        row.graph->setVisible(channel.column>=0);
+        row.digital->setDigital(channel.digital);
+        row.digital->setVisible(channel.digital>=0);
 
         // WP name as yAxis title
-        QFont font = yAxis->labelFont();
-        font.setPointSize(6);
-        yAxis->setLabelFont(font);
-        QFontMetrics fm(font);
-        QString yLabel = fm.elidedText(wp.at(i).label,Qt::ElideRight,gSet->plotVerticalSize);
-        yAxis->setLabel(QString("%1\n%2").arg(yLabel,gSet->plcGetAddrName(wp.at(i))));
+        QFontMetrics fm(row.yAxis->labelFont());
+        QString yLabel = fm.elidedText(channel.wp.label,Qt::ElideRight,gSet->plotVerticalSize);
+        row.yAxis->setLabel(QString("%1\n%2").arg(yLabel,gSet->plcGetAddrName(channel.wp)));
 
         // value ticks for analogue WPs at yAxis
-        if (wp.at(i).vtype==CWP::S7BOOL)
-            yAxis->setTickLabels(false);
-        else {
-            yAxis->setTickLabels(true);
-            yAxis->setTickLabelSide(QCPAxis::lsInside);
-            yAxis->setTickLabelFont(font);
-        }
+        row.yAxis->setTickLabels(channel.wp.vtype!=CWP::S7BOOL);
+        row.yAxis->setRange(channel.valueRange);
+    }
+    replotPending = true;
+}
 
-        // date/time ticks for xAxis
-        if (idx==0) {
-            QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
-            dateTicker->setDateTimeFormat("h:mm:ss.zzz\nd.MM.yyyy");
-            xAxis->setTicker(dateTicker);
-            xAxis->setTickLabelFont(font);
-        } else
-            xAxis->setTickLabels(false);
-
-        xAxis->grid()->setVisible(true);
-        yAxis->grid()->setVisible(true);
-
-        // graph parameters
-        QCPGraph* graph = ui->plot->addGraph(xAxis,yAxis);
-        graph->setAntialiased(gSet->plotAntialiasing);
-        graph->setAdaptiveSampling(true);
-        graph->setLineStyle(QCPGraph::lsStepLeft);
-        if (gSet->plotShowScatter)
-            graph->setScatterStyle(QCPScatterStyle(QCPScatterStyle::ssPlus));
-
-        // visible graph xRange, 1 min for complete init, copy from old WPs for lazy init
-        if (lazyModification && QCPRange::validRange(xRange))
-            xAxis->setRange(xRange);
-        else {
-            double time = static_cast<double>(QDateTime::currentDateTime().toMSecsSinceEpoch())/1000.0;
-            xAxis->setRange(time,time+60);
-        }
+QCPRange CGraphForm::visibleKeyRange()
+{
+    if (!plotRows.isEmpty())
+        return plotRows.first().xAxis->range();
 
-        // default yRange for data type
-        double yRange = abs(yMax-yMin);
-        yAxis->setRange(yMin-(yRange*0.1),yMax+(yRange*0.1));
+    // 1 min for complete init
+    double time = static_cast<double>(QDateTime::currentDateTime().toMSecsSinceEpoch())/1000.0;
+    return QCPRange(time,time+60);
+}
 
-        // handle xAxis drag
-        connect(xAxis,SIGNAL(rangeChanged(QCPRange)),this,SLOT(plotRangeChanged(QCPRange)));
+void CGraphForm::verticalScrollBarMoved(int value)
+{
+    Q_UNUSED(value)
 
+    bindRows();
+    replotPending = false;
+    ui->plot->replot();
+}
+
+bool CGraphForm::eventFilter(QObject *obj, QEvent *event)
+{
+    if (obj==ui->plot && event->type()==QEvent::Resize)
+        layoutRows();
+    return QWidget::eventFilter(obj,event);
+}
+
+void CGraphForm::addData(const CWPList &wp, const QDateTime& time)
+{
+    // live data replaces archive view and followed file
+    if (followActive)
+        stopFollowing();
+    if (archiveActive)
+        clearData();
+
+    // samples coalesced into per-channel vectors, appended to graphs on next frame
+    if (pendingBatch.schema!=wp) { // comparing by uuid, WP must be same count, same order
+        flushPendingData();
+        pendingBatch.schema = wp;
+        pendingBatch.values.clear();
+        for (int i=0;i<wp.count();i++) {
+            if (isPlottable(wp.at(i)))
+                pendingBatch.values.append(QVector<double>());
+        }
+    }
+
+    pendingBatch.keys.append(static_cast<double>(time.toMSecsSinceEpoch())/1000.0);
+    int idx = 0;
+    for (int i=0;i<wp.count();i++) {
+        if (!isPlottable(wp.at(i))) continue;
+        pendingBatch.values[idx].append(plotValue(wp.at(i)));
         idx++;
     }
-    ui->plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom | QCP::iSelectPlottables);
+}
 
-    watchpoints = wp;
+void CGraphForm::flushPendingData()
+{
+    if (pendingBatch.isEmpty()) return;
+
+    addBatch(pendingBatch);
+    double key = pendingBatch.keys.last();
+
+    pendingBatch.keys.clear();
+    for (int i=0;i<pendingBatch.values.count();i++)
+        pendingBatch.values[i].clear();
+
+    autoScrollTo(key);
+    replotPending = true;
+}
+
+void CGraphForm::autoScrollTo(double key)
+{
+    // Follow mode - newest sample kept near right edge, range moves by small steps,
+    // so graphs only shift cached pixmaps and draw exposed strip
+    if (ui->checkAutoScroll->isChecked() && !plotRows.isEmpty()) {
+        double size = plotRows.first().xAxis->range().size();
+        double start = key-(size*0.9);
+        for (int i=0;i<plotRows.count();i++)
+            plotRows.at(i).xAxis->setRange(start,start+size);
+    }
 }
 
-void CGraphForm::addData(const CWPList &wp, const QDateTime& time, bool noReplot)
+void CGraphForm::renderTiles()
 {
-    if (wp!=watchpoints) { // comparing by uuid, WP must be same count, same order
+    // actual axis rects geometry for tiles, same layout pass is repeated by replot
+    QCPLayoutGrid *layout = ui->plot->plotLayout();
+    layout->update(QCPLayoutElement::upPreparation);
+    layout->update(QCPLayoutElement::upMargins);
+    layout->update(QCPLayoutElement::upLayout);
+
+    QList<CCachedPlottable *> tiles;
+    for (int i=0;i<plotRows.count();i++) {
+        const CPlotRow &row = plotRows.at(i);
+        if (row.channel<0) continue;
+        if (row.graph->visible())
+            tiles.append(row.graph);
+        if (row.digital->visible())
+            tiles.append(row.digital);
+    }
+
+    // GUI thread waits for pool, so plot data stays unmodified while tiles are rendered,
+    // replot only composites prepared images
+    if (tiles.count()>1)
+        QtConcurrent::blockingMap(tiles,renderTile);
+}
+
+void CGraphForm::autoScrollToggled(bool checked)
+{
+    for (int i=0;i<plotRows.count();i++) {
+        plotRows.at(i).graph->setFollowMode(checked);
+        plotRows.at(i).digital->setFollowMode(checked);
+    }
+    replotPending = true;
+}
+
+void CGraphForm::frameTick()
+{
+    int interval = 1000/qBound(1,gSet->plotFrameRate,100);
+    if (frameTimer->interval()!=interval)
+        frameTimer->setInterval(interval);
+
+    flushPendingData();
+
+    if (archiveActive && archiveDirty)
+        updateArchiveWindow();
+
+    // hidden window - keep data, postpone replot
+    if (!replotPending || !isVisible()) return;
+
+    replotPending = false;
+    updateScrollBarRange();
+    ui->plot->replot();
+}
+
+void CGraphForm::addBatch(const CPlotBatch &batch)
+{
+    if (batch.isEmpty()) return;
+
+    if (batch.schema!=watchpoints) { // comparing by uuid
         emit logMessage(trUtf8("Variables list changed. Initializing graphs."));
-        setupGraphs(wp);
+        setupGraphs(batch.schema);
     }
 
-    double key = static_cast<double>(time.toMSecsSinceEpoch())/1000.0;
+    // analogue values appended as rows with shared timestamps, BOOL as transitions
+    QVector<const QVector<double> *> columns(plotData.columnCount(),NULL);
     int idx = 0;
+    for (int i=0;i<batch.schema.count();i++) {
+        if (!isPlottable(batch.schema.at(i))) continue;
+        if (idx>=batch.values.count() || idx>=channels.count()) break;
+
+        const CPlotChannel &channel = channels.at(idx);
+        if (channel.column>=0)
+            columns[channel.column] = &(batch.values.at(idx));
+        else if (channel.digital>=0)
+            plotData.appendDigital(channel.digital,batch.keys,batch.values.at(idx));
+        idx++;
+    }
+    plotData.appendRows(batch.keys,columns);
 
-    for (int i=0;i<wp.count();i++) {
-        // skip timers and counters, date/time types
-        if (!validArea.contains(wp.at(i).varea) || !gSet->plcIsPlottableType(wp.at(i))) continue;
+    for (int i=0;i<channels.count();i++) {
+        if (channels.at(i).column>=0)
+            expandValueAxis(i,plotData.totalRange(channels.at(i).column));
+    }
+}
 
-        double val = 0.0;
-        QVariant dt = wp.at(i).data;
-        switch (wp.at(i).vtype) {
-            case CWP::S7BOOL:
-                if (dt.toBool())
-                    val = 1.0;
-                else
-                    val = 0.0;
-                break;
-            case CWP::S7BYTE:
-                val = static_cast<double>(dt.toUInt());
-                break;
-            case CWP::S7WORD:
-                val = static_cast<double>(dt.toUInt());
-                break;
-            case CWP::S7DWORD:
-                val = static_cast<double>(dt.toUInt());
-                break;
-            case CWP::S7INT:
-                val = static_cast<double>(dt.toInt());
-                break;
-            case CWP::S7DINT:
-                val = static_cast<double>(dt.toInt());
-                break;
-            case CWP::S7REAL:
-                val = dt.toDouble();
-                break;
-            default:
-                continue;
-        }
+qint64 CGraphForm::plotMemoryUsage()
+{
+    return plotData.memoryUsage();
+}
 
-        QCPGraph* graph = ui->plot->graph(idx);
-        graph->addData(key,val);
-
-        // dynamically correct yAxis range for analogue WPs
-        if (wp.at(i).vtype!=CWP::S7BOOL) {
-            QCPAxis* yAxis = graph->valueAxis();
-            bool foundRange;
-            QCPRange dataRange = graph->getValueRange(foundRange, QCP::sdBoth);
-            if (foundRange &&
-                    (dataRange.lower < yAxis->range().lower ||
-                     dataRange.upper > yAxis->range().upper)) {
-                double increment = dataRange.size()*zoomIncrements;
-                yAxis->setRange(dataRange.lower-increment,
-                                dataRange.upper+increment);
-            }
+void CGraphForm::checkMemoryLimit()
+{
+    qint64 limit = static_cast<qint64>(gSet->plotMemoryLimit)*1024*1024;
+    qint64 usage = plotMemoryUsage();
+    QCPRange total = getTotalKeyRange();
+
+    if (!loaderActive && !archiveActive && limit>0 && usage>limit && QCPRange::validRange(total)) {
+        // recent half of history stays at full resolution, older data downsampled to min/max
+        // envelopes, each pass makes old data coarser
+        double ageKey = total.lower+total.size()*0.5;
+        for (int pass=0;pass<3 && usage>limit;pass++) {
+            plotData.downsampleBefore(ageKey,downsampleFactor);
+            usage = plotMemoryUsage();
         }
-        idx++;
+
+        if (usage>limit) {
+            // downsampling is not enough, drop oldest quarter of history
+            double dropKey = total.lower+total.size()*0.25;
+            plotData.removeDataBefore(dropKey);
+            usage = plotMemoryUsage();
+            emit logMessage(trUtf8("Plot memory limit reached. Plot history before %1 dropped.")
+                            .arg(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(dropKey*1000.0))
+                                 .toString("dd.MM.yyyy hh:mm:ss")));
+        } else
+            emit logMessage(trUtf8("Plot memory limit reached. Plot history before %1 downsampled.")
+                            .arg(QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(ageKey*1000.0))
+                                 .toString("dd.MM.yyyy hh:mm:ss")));
+        replotPending = true;
     }
 
-    // Check visible range, move range if needed
-    if (ui->checkAutoScroll->isChecked() && !ui->plot->axisRect(0)->axis(QCPAxis::atTop)->range().contains(key)) {
-        double size = ui->plot->axisRect(0)->axis(QCPAxis::atTop)->range().size();
-        double start = key-(size*0.1);
-        for (int i=0;i<ui->plot->axisRectCount();i++)
-            ui->plot->axisRect(i)->axis(QCPAxis::atTop)->setRange(start,start+size);
+    // archive view is bounded by block cache, which is a half of limit
+    if (archiveActive)
+        usage += static_cast<qint64>(archiveCache.totalCost())*1024;
+
+    if (limit>0)
+        ui->lblMemory->setText(trUtf8("Memory: %1 of %2 MB")
+                               .arg(static_cast<double>(usage)/1048576.0,0,'f',1)
+                               .arg(gSet->plotMemoryLimit));
+    else
+        ui->lblMemory->setText(trUtf8("Memory: %1 MB")
+                               .arg(static_cast<double>(usage)/1048576.0,0,'f',1));
+}
+
+void CGraphForm::expandValueAxis(int channel, const CMinMax &dataRange)
+{
+    if (channel<0 || channel>=channels.count() || qIsNaN(dataRange.min)) return;
+
+    const QCPRange &range = channels.at(channel).valueRange;
+    if (dataRange.min < range.lower ||
+            dataRange.max > range.upper) {
+        double increment = (dataRange.max-dataRange.min)*zoomIncrements;
+        if (increment<=0.0)
+            increment = 1.0;
+        setValueRange(channel,QCPRange(dataRange.min-increment,
+                                       dataRange.max+increment));
     }
+}
 
-    // silent update (file loading) enabled
-    if (!noReplot) {
-        updateScrollBarRange();
-        ui->plot->replot();
+void CGraphForm::setValueRange(int channel, const QCPRange &range)
+{
+    if (channel<0 || channel>=channels.count()) return;
+
+    channels[channel].valueRange = range;
+    for (int i=0;i<plotRows.count();i++) {
+        if (plotRows.at(i).channel==channel)
+            plotRows.at(i).yAxis->setRange(range);
     }
 }
 
@@ -281,10 +592,21 @@ void CGraphForm::showEvent(QShowEvent *)
 
 void CGraphForm::clearData()
 {
+    pendingBatch = CPlotBatch();
+
+    archiveActive = false;
+    archiveDirty = false;
+    archiveIndex = CArchiveIndex();
+    archiveCache.clear();
+    archiveRequested.clear();
+    archiveFirst = -1;
+    archiveLast = -1;
+    loader->setWindow(-1,-1);
+
     clearDataEx(false);
 }
 
-void CGraphForm::clearDataEx(bool clearOnlyCursors)
+void CGraphForm::removeCursors()
 {
     if (runningCursor!=NULL) ui->plot->removeItem(runningCursor);
     if (leftCursor!=NULL) ui->plot->removeItem(leftCursor);
@@ -292,6 +614,11 @@ void CGraphForm::clearDataEx(bool clearOnlyCursors)
     runningCursor = NULL;
     leftCursor = NULL;
     rightCursor = NULL;
+}
+
+void CGraphForm::clearDataEx(bool clearOnlyCursors)
+{
+    removeCursors();
 
     ui->listRunning->clear();
     ui->listRunning->setColumnCount(0);
@@ -302,33 +629,38 @@ void CGraphForm::clearDataEx(bool clearOnlyCursors)
     ui->listRight->clear();
     ui->listRight->setColumnCount(0);
     ui->listRight->setRowCount(0);
+    ui->listStats->clear();
+    ui->listStats->setColumnCount(0);
+    ui->listStats->setRowCount(0);
+    ui->lblStatsRange->clear();
 
     if (clearOnlyCursors) {
         ui->plot->replot();
         return;
     }
 
-    ui->plot->clearGraphs();
+    ui->plot->clearPlottables();
     ui->plot->plotLayout()->clear();
+    plotRows.clear();
+    channels.clear();
+    plotData.clear();
 
     ui->plot->replot();
 
     watchpoints.clear();
     ui->horizontalScrollBar->setRange(0,0);
     ui->horizontalScrollBar->setEnabled(false);
+    ui->verticalScrollBar->setRange(0,0);
+    ui->verticalScrollBar->setEnabled(false);
 }
 
 QCPRange CGraphForm::getTotalKeyRange()
 {
-    QCPRange res(qQNaN(),qQNaN());
-    for (int i=0;i<ui->plot->graphCount();i++) {
-        bool foundRange;
-        QCPRange dataRange = ui->plot->graph(i)->getKeyRange(foundRange, QCP::sdBoth);
-        if (foundRange)
-            res.expand(dataRange);
-    }
+    // scrollbar spans whole archive, not only decoded blocks
+    if (archiveActive && !archiveIndex.isEmpty())
+        return archiveIndex.keyRange();
 
-    return res;
+    return plotData.keyRange();
 }
 
 void CGraphForm::updateScrollBarRange()
@@ -344,7 +676,7 @@ void CGraphForm::updateScrollBarRange()
 void CGraphForm::zoomAll()
 {
     if (ui->plot->axisRectCount()<1 ||
-            ui->plot->graphCount()<1) return;
+            channels.isEmpty()) return;
 
     QCPRange totalRange = getTotalKeyRange();
     if (QCPRange::validRange(totalRange))
@@ -354,6 +686,24 @@ void CGraphForm::zoomAll()
     ui->plot->replot();
 }
 
+void CGraphForm::fitVisibleValues()
+{
+    QCPRange keyRange = visibleKeyRange();
+    for (int i=0;i<channels.count();i++) {
+        CMinMax range;
+        if (channels.at(i).column>=0 &&
+                plotData.valueRange(channels.at(i).column,keyRange,range) &&
+                !qIsNaN(range.min)) {
+            double increment = (range.max-range.min)*zoomIncrements;
+            if (increment<=0.0)
+                increment = 1.0;
+            setValueRange(i,QCPRange(range.min-increment,range.max+increment));
+        }
+    }
+
+    ui->plot->replot();
+}
+
 void CGraphForm::plotRangeChanged(const QCPRange &newRange)
 {
     QCPAxis* xAxis = qobject_cast<QCPAxis *>(sender());
@@ -369,6 +719,9 @@ void CGraphForm::plotRangeChanged(const QCPRange &newRange)
         ui->horizontalScrollBar->setValue(static_cast<int>(newRange.center()-totalRange.lower));
         ui->horizontalScrollBar->setPageStep(static_cast<int>(newRange.size()));
     }
+
+    if (archiveActive)
+        archiveDirty = true;
 }
 
 void CGraphForm::plotMouseMove(QMouseEvent *event)
@@ -450,8 +803,22 @@ void CGraphForm::plotContextMenu(const QPoint &pos)
     QAction* acm;
     acm = cm.addAction(QIcon(":/zoom"),trUtf8("Zoom all"));
     connect(acm,SIGNAL(triggered()),this,SLOT(zoomAll()));
+    acm = cm.addAction(trUtf8("Fit values to visible range"));
+    connect(acm,SIGNAL(triggered()),this,SLOT(fitVisibleValues()));
     cm.addSeparator();
 
+    // spectrum and histogram for analogue channel under mouse
+    for (int i=0;i<plotRows.count();i++) {
+        const CPlotRow &row = plotRows.at(i);
+        if (row.channel<0 || !row.rect->rect().contains(pos)) continue;
+        if (channels.at(row.channel).column<0) break;
+        acm = cm.addAction(trUtf8("Spectrum and histogram of %1").arg(channels.at(row.channel).wp.label));
+        acm->setData(row.channel);
+        connect(acm,SIGNAL(triggered()),this,SLOT(analyzeChannel()));
+        cm.addSeparator();
+        break;
+    }
+
     acm = cm.addAction(QIcon(":/trash-empty"),trUtf8("Clear plot"));
     connect(acm,SIGNAL(triggered()),this,SLOT(clearData()));
 
@@ -459,89 +826,369 @@ void CGraphForm::plotContextMenu(const QPoint &pos)
     cm.exec(ui->plot->mapToGlobal(p));
 }
 
+void CGraphForm::analyzeChannel()
+{
+    QAction* ac = qobject_cast<QAction *>(sender());
+    if (ac==NULL) return;
+    int channel = ac->data().toInt();
+    if (channel<0 || channel>=channels.count() || channels.at(channel).column<0) return;
+
+    // cursors range if both cursors are set, visible range otherwise
+    QCPRange range = visibleKeyRange();
+    if (leftCursor!=NULL && rightCursor!=NULL) {
+        double left = leftCursor->point1->coords().x();
+        double right = rightCursor->point1->coords().x();
+        range = QCPRange(qMin(left,right),qMax(left,right));
+    }
+
+    int first = plotData.findBegin(range.lower);
+    int last = plotData.findEnd(range.upper);
+    const CPlotColumn &column = plotData.column(channels.at(channel).column);
+    QVector<double> keys;
+    QVector<double> values;
+    keys.reserve(last-first);
+    values.reserve(last-first);
+    for (int i=first;i<last;i++) {
+        keys.append(plotData.key(i));
+        values.append(column.value(i));
+    }
+
+    if (analysisForm==NULL) {
+        analysisForm = new CAnalysisForm(this);
+        analysisForm->setWindowFlags(analysisForm->windowFlags() | Qt::Window);
+    }
+    analysisForm->show();
+    analysisForm->raise();
+    analysisForm->analyze(channels.at(channel).wp.label,keys,values);
+}
+
 void CGraphForm::loadCSV()
 {
+    if (loaderActive || followActive) return;
+
     QString fname = getOpenFileNameD(this,trUtf8("Load CSV file"),gSet->savedAuxDir,
                                      trUtf8("CSV files (*.csv)"));
     if (fname.isEmpty()) return;
     gSet->savedAuxDir = QFileInfo(fname).absolutePath();
 
-    clearData();
+    openArchive(QStringList() << fname);
+}
 
-    QFile f(fname);
-    if (!f.open(QIODevice::ReadOnly)) {
-        QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                              trUtf8("Unable to open file %1.").arg(fname));
+void CGraphForm::loadArchiveDir()
+{
+    if (loaderActive) return;
+
+    QString dir = getExistingDirectoryD(this,trUtf8("Open directory with CSV files"),gSet->savedAuxDir);
+    if (dir.isEmpty()) return;
+    gSet->savedAuxDir = dir;
+
+    // rotated files, named by creation time
+    QStringList files;
+    QFileInfoList fl = QDir(dir).entryInfoList(QStringList() << "*.csv",
+                                               QDir::Files | QDir::Readable,QDir::Name);
+    for (int i=0;i<fl.count();i++)
+        files << fl.at(i).absoluteFilePath();
+
+    if (files.isEmpty()) {
+        QMessageBox::warning(this,trUtf8("PLC recorder"),
+                             trUtf8("No CSV files found in directory %1.").arg(dir));
         return;
     }
-    QTextStream in(&f);
-    QString s = in.readLine();
-    if (!s.startsWith("\"Time\"; ")) {
-        QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                              trUtf8("Unrecognized CSV file %1.").arg(fname));
-        f.close();
-        return;
+
+    openArchive(files);
+}
+
+void CGraphForm::openArchive(const QStringList &files)
+{
+    if (followActive)
+        stopFollowing();
+    clearData();
+
+    loaderActive = true;
+    ui->btnLoadCSV->setEnabled(false);
+    ui->btnLoadDir->setEnabled(false);
+    ui->progressLoad->setValue(0);
+    ui->progressLoad->show();
+    ui->btnCancelLoad->show();
+    if (files.count()==1)
+        emit logMessage(trUtf8("Indexing file %1.").arg(files.first()));
+    else
+        emit logMessage(trUtf8("Indexing %1 files.").arg(files.count()));
+
+    emit openArchiveRequest(files);
+}
+
+void CGraphForm::archivePreview(const CPlotBatchList &batches)
+{
+    // first decoded blocks are plotted directly, index view replaces them when indexing is finished
+    if (!loaderActive || archiveActive) return;
+
+    for (int i=0;i<batches.count();i++)
+        addBatch(batches.at(i));
+    zoomAll();
+}
+
+void CGraphForm::archiveIndexed(bool success, const QString &msg, const CArchiveIndex &index)
+{
+    bool canceled = loader->isCanceled();
+    loaderActive = false;
+    ui->btnLoadCSV->setEnabled(true);
+    ui->btnLoadDir->setEnabled(true);
+    ui->progressLoad->hide();
+    ui->btnCancelLoad->hide();
+
+    if (success) {
+        setupGraphs(index.schema);
+        archiveIndex = index;
+        archiveActive = true;
+        archiveFirst = -1;
+        archiveLast = -1;
+        archiveBlocksChanged = true;
+
+        // half of plot memory limit for decoded blocks, in KB
+        int limit = gSet->plotMemoryLimit;
+        if (limit<=0)
+            limit = 1024;
+        archiveCache.setMaxCost(limit*512);
+
+        // archive channels are plottable watchpoints in schema order, same as plot channels
+        for (int i=0;i<channels.count();i++) {
+            if (channels.at(i).column>=0)
+                expandValueAxis(i,index.channelRange(i));
+        }
+
+        updateScrollBarRange();
+        zoomAll();
+        updateArchiveWindow();
+    } else
+        clearData(); // drop preview
+    ui->plot->replot();
+
+    emit logMessage(msg);
+    if (success)
+        QMessageBox::information(this,trUtf8("PLC recorder"),msg);
+    else if (!canceled)
+        QMessageBox::critical(this,trUtf8("PLC recorder error"),msg);
+}
+
+void CGraphForm::archiveBlockLoaded(int block, const CPlotBatchList &batches)
+{
+    archiveRequested.remove(block);
+    if (!archiveActive) return;
+
+    archiveCache.insert(block,new CPlotBatchList(batches),archiveIndex.blockCost(block));
+    if (block>=archiveFirst && block<=archiveLast) {
+        archiveBlocksChanged = true;
+        archiveDirty = true;
     }
-    int lineNum = 2;
-    while (!in.atEnd()) {
-        s = in.readLine().trimmed();
-
-        // skip empty lines and additional title lines
-        // this is support for merged files
-        if (s.isEmpty() ||
-                s.startsWith("\"Time\"; ")) continue;
-
-        int idx = s.lastIndexOf("; ");
-        if (idx<0) {
-            QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                                  trUtf8("Unexpected end of file %1 at line %2.").arg(fname).arg(lineNum));
-            f.close();
-            return;
+}
+
+void CGraphForm::updateArchiveWindow()
+{
+    archiveDirty = false;
+    if (!archiveActive || archiveIndex.isEmpty() || ui->plot->axisRectCount()<1) return;
+
+    // visible range with prefetch margins
+    QCPRange range = ui->plot->axisRect(0)->axis(QCPAxis::atTop)->range();
+    double margin = range.size()*archivePrefetch;
+    int first = archiveIndex.findBlock(range.lower-margin);
+    int last = qMin(archiveIndex.findBlock(range.upper+margin),archiveIndex.blocks.count()-1);
+
+    // wide ranges are shown from block envelopes only, decoded window must fit in cache
+    int cost = 0;
+    for (int i=first;i<=last && cost<=archiveCache.maxCost();i++)
+        cost += archiveIndex.blockCost(i);
+    if (first>last || (last-first+1)>maxArchiveWindow || cost>(archiveCache.maxCost()/2)) {
+        first = -1;
+        last = -1;
+    }
+
+    if (first!=archiveFirst || last!=archiveLast) {
+        archiveFirst = first;
+        archiveLast = last;
+        archiveBlocksChanged = true;
+
+        // requests outside of new window are dropped by loader
+        loader->setWindow(first,last);
+        QSet<int>::iterator it = archiveRequested.begin();
+        while (it!=archiveRequested.end()) {
+            if (*it<first || *it>last)
+                it = archiveRequested.erase(it);
+            else
+                ++it;
         }
-        s = s.section("; ",-1,-1,QString::SectionSkipEmpty);
-        QByteArray ba = QByteArray::fromBase64(s.toLatin1());
-        if (ba.isEmpty()) {
-            QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                                  trUtf8("Corrupted scan data in file %1 at line %2.").arg(fname).arg(lineNum));
-            f.close();
-            return;
+    }
+
+    QList<int> missing;
+    for (int i=first;i>=0 && i<=last;i++) {
+        if (!archiveCache.contains(i) && !archiveRequested.contains(i)) {
+            missing.append(i);
+            archiveRequested.insert(i);
         }
-        ba = qUncompress(ba);
-        if (ba.isEmpty()) {
-            QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                                  trUtf8("Corrupted compressed data in file %1 at line %2.").arg(fname).arg(lineNum));
-            f.close();
-            return;
+    }
+    if (!missing.isEmpty())
+        emit loadBlocksRequest(missing);
+
+    if (archiveBlocksChanged) {
+        fillArchiveGraphs();
+        replotPending = true;
+    }
+}
+
+static bool clipBatch(const CPlotBatch &batch, double &lastKey, CPlotBatch &clipped)
+{
+    // rows older than already appended rows are dropped (overlapping blocks, clock steps),
+    // so analogue and BOOL channels get same rows
+    bool ordered = true;
+    double last = lastKey;
+    for (int j=0;j<batch.keys.count() && ordered;j++) {
+        if (!qIsNaN(last) && batch.keys.at(j)<last)
+            ordered = false;
+        else
+            last = batch.keys.at(j);
+    }
+    if (ordered) {
+        lastKey = last;
+        return false;
+    }
+
+    clipped = CPlotBatch();
+    clipped.schema = batch.schema;
+    clipped.values.resize(batch.values.count());
+    for (int j=0;j<batch.keys.count();j++) {
+        double key = batch.keys.at(j);
+        if (!qIsNaN(lastKey) && key<lastKey) continue;
+        lastKey = key;
+        clipped.keys.append(key);
+        for (int k=0;k<batch.values.count();k++) {
+            if (j<batch.values.at(k).count())
+                clipped.values[k].append(batch.values.at(k).at(j));
         }
+    }
+    return true;
+}
 
-        QBuffer buf(&ba);
-        buf.open(QIODevice::ReadOnly);
-        QDataStream in(&buf);
-
-        CWPList wp;
-        QDateTime dt;
-        in >> dt >> wp;
-        buf.close();
-        ba.clear();
-
-        if (wp.isEmpty()) {
-            QMessageBox::critical(this,trUtf8("PLC recorder error"),
-                                  trUtf8("Scan data is empty in file %1 at line %2.").arg(fname).arg(lineNum));
-            f.close();
-            return;
+void CGraphForm::fillArchiveGraphs()
+{
+    archiveBlocksChanged = false;
+    plotData.clearRows();
+
+    double lastKey = qQNaN();
+    for (int b=0;b<archiveIndex.blocks.count();b++) {
+        const CArchiveBlock &block = archiveIndex.blocks.at(b);
+        CPlotBatchList* batches = NULL;
+        if (b>=archiveFirst && b<=archiveLast)
+            batches = archiveCache.object(b);
+
+        if (batches!=NULL) {
+            for (int i=0;i<batches->count();i++) {
+                CPlotBatch clipped;
+                const CPlotBatch &batch = (clipBatch(batches->at(i),lastKey,clipped) ? clipped : batches->at(i));
+                if (batch.isEmpty()) continue;
+                QVector<int> map = archiveIndex.channelMap(batch.schema);
+                QVector<const QVector<double> *> values(plotData.columnCount(),NULL);
+                for (int j=0;j<map.count() && j<batch.values.count();j++) {
+                    int channel = map.at(j);
+                    if (channel<0 || channel>=channels.count()) continue;
+                    if (channels.at(channel).column>=0)
+                        values[channels.at(channel).column] = &(batch.values.at(j));
+                    else if (channels.at(channel).digital>=0)
+                        plotData.appendDigital(channels.at(channel).digital,batch.keys,batch.values.at(j));
+                }
+                plotData.appendRows(batch.keys,values);
+            }
+        } else {
+            // block is not decoded, min/max envelope from index
+            // envelope keys are clamped to already appended rows, min and max are both kept
+            QVector<double> keys;
+            keys << block.firstKey << (block.firstKey+block.lastKey)/2.0;
+            if (!qIsNaN(lastKey)) {
+                keys[0] = qMax(keys.at(0),lastKey);
+                keys[1] = qMax(keys.at(1),keys.at(0));
+            }
+            lastKey = keys.at(1);
+            QVector<QVector<double> > envelope(plotData.columnCount());
+            QVector<const QVector<double> *> values(plotData.columnCount(),NULL);
+            for (int channel=0;channel<channels.count() && channel<block.ranges.count();channel++) {
+                const CMinMax &range = block.ranges.at(channel);
+                if (qIsNaN(range.min)) continue;
+                QVector<double> data;
+                data << range.min << range.max;
+                int column = channels.at(channel).column;
+                if (column>=0) {
+                    envelope[column] = data;
+                    values[column] = &(envelope.at(column));
+                } else if (channels.at(channel).digital>=0)
+                    plotData.appendDigital(channels.at(channel).digital,keys,data);
+            }
+            plotData.appendRows(keys,values);
         }
+    }
+}
+
+void CGraphForm::followCSV()
+{
+    if (followActive) {
+        stopFollowing();
+        return;
+    }
+    if (loaderActive) return;
+
+    QString fname = getOpenFileNameD(this,trUtf8("Follow CSV file"),gSet->savedAuxDir,
+                                     trUtf8("CSV files (*.csv)"));
+    if (fname.isEmpty()) return;
+    gSet->savedAuxDir = QFileInfo(fname).absolutePath();
+
+    clearData();
+    followActive = true;
+    ui->btnFollow->setText(trUtf8("Stop following"));
+    ui->btnLoadCSV->setEnabled(false);
+    ui->btnLoadDir->setEnabled(false);
+    emit logMessage(trUtf8("Following file %1.").arg(fname));
+
+    emit followFileRequest(fname);
+}
+
+void CGraphForm::stopFollowing()
+{
+    if (!followActive) return;
+
+    // unblock loader waiting for GUI, stale batches are dropped
+    loader->cancel();
+    emit stopFollowRequest();
+    followStopped(trUtf8("Follow mode stopped."));
+}
+
+void CGraphForm::followStopped(const QString &msg)
+{
+    if (!followActive) return;
 
-        addData(wp,dt,true);
-        qApp->processEvents();
+    followActive = false;
+    ui->btnFollow->setText(trUtf8("Follow file"));
+    ui->btnLoadCSV->setEnabled(true);
+    ui->btnLoadDir->setEnabled(true);
+    emit logMessage(msg);
+}
 
-        lineNum++;
+void CGraphForm::followBatchLoaded(const CPlotBatch &batch)
+{
+    if (followActive && !batch.isEmpty()) {
+        addBatch(batch);
+        autoScrollTo(batch.keys.last());
+        replotPending = true;
     }
-    f.close();
-    updateScrollBarRange();
-    zoomAll();
-    qApp->processEvents();
-    QMessageBox::information(this,trUtf8("PLC recorder"),
-                             trUtf8("File successfully loaded."));
+    loader->batchConsumed();
+}
+
+void CGraphForm::cancelLoading()
+{
+    if (!loaderActive) return;
+    loader->cancel();
+}
+
+void CGraphForm::loaderProgress(int percent)
+{
+    ui->progressLoad->setValue(percent);
 }
 
 void CGraphForm::exportGraph()
@@ -568,31 +1215,28 @@ void CGraphForm::createCursorSignal(CGraphForm::CursorType cursor, double timest
 {
     QDateTime time = QDateTime::fromMSecsSinceEpoch(static_cast<qint64>(timestamp*1000.0));
 
+    // one search in shared timestamps for all analogue channels
+    int row = plotData.rowAt(timestamp);
+
     CWPList res = watchpoints;
     int idx = 0;
     for (int i=0;i<res.count();i++) {
-        // skip timers and counters, date/time types
-        if (!validArea.contains(res.at(i).varea) || !gSet->plcIsPlottableType(res.at(i))) {
-            res[i].data = QVariant();
+        if (!isPlottable(res.at(i))) {
+            res[i].data = CWPValue();
             continue;
         }
 
         bool dataValid = false;
         double data = 0.0;
-        const QCPGraph* graph = ui->plot->graph(idx);
-
-        // find nearest value to cursor
-        bool foundRange;
-        QCPGraphDataContainer::const_iterator it = graph->data()->findBegin(timestamp);
-        QCPRange dataRange = graph->getKeyRange(foundRange, QCP::sdBoth);
-        if (foundRange &&
-                (it != graph->data()->constEnd()))
-        {
-            // key must be inside actual graph
-            if ((it->key > dataRange.lower) &&
-                    (it->key < dataRange.upper)) {
-                data = it->value;
-                dataValid = true;
+
+        // value at cursor, binary search in transitions for BOOL
+        if (idx<channels.count()) {
+            const CPlotChannel &channel = channels.at(idx);
+            if (channel.digital>=0)
+                dataValid = plotData.digital(channel.digital).valueAt(timestamp,data);
+            else if (channel.column>=0 && row>=0) {
+                data = plotData.column(channel.column).value(row);
+                dataValid = !qIsNaN(data);
             }
         }
 
@@ -600,26 +1244,26 @@ void CGraphForm::createCursorSignal(CGraphForm::CursorType cursor, double timest
         if (dataValid) {
             switch (watchpoints.at(i).vtype) {
                 case CWP::S7BOOL:
-                    res[i].data = QVariant(data>0.5);
+                    res[i].data = CWPValue(data>0.5);
                     break;
                 case CWP::S7BYTE:
                 case CWP::S7WORD:
                 case CWP::S7DWORD:
-                    res[i].data = QVariant(static_cast<uint>(data));
+                    res[i].data = CWPValue(static_cast<uint>(data));
                     break;
                 case CWP::S7INT:
                 case CWP::S7DINT:
-                    res[i].data = QVariant(static_cast<int>(data));
+                    res[i].data = CWPValue(static_cast<int>(data));
                     break;
                 case CWP::S7REAL:
-                    res[i].data = QVariant(data);
+                    res[i].data = CWPValue(data);
                     break;
                 default:
-                    res[i].data = QVariant();
+                    res[i].data = CWPValue();
                     break;
             };
         } else
-            res[i].data = QVariant();
+            res[i].data = CWPValue();
 
         idx++;
     }
@@ -665,5 +1309,64 @@ void CGraphForm::createCursorSignal(CGraphForm::CursorType cursor, double timest
         timeLabel->setText(time.toString("h:mm:ss.zzz d.MM.yy"));
     }
 
+    if (cursor!=ctRunning)
+        updateRangeStats();
+
     emit cursorMoved(cursor,time,res);
 }
+
+static QString formatStat(double value)
+{
+    if (qIsNaN(value)) return QString("-");
+    return QString::number(value,'g',6);
+}
+
+void CGraphForm::updateRangeStats()
+{
+    if (leftCursor==NULL || rightCursor==NULL) return;
+
+    double left = leftCursor->point1->coords().x();
+    double right = rightCursor->point1->coords().x();
+    QCPRange range(qMin(left,right),qMax(left,right));
+
+    QTableWidget* list = ui->listStats;
+    QFontMetrics fm(list->font());
+    if (list->rowCount()!=channels.count()) {
+        QStringList header;
+        header << trUtf8("Name") << trUtf8("Min") << trUtf8("Max") << trUtf8("Mean") << trUtf8("Std dev")
+               << trUtf8("Integral") << trUtf8("Time high") << trUtf8("Edges");
+        list->clearContents();
+        list->setRowCount(channels.count());
+        list->setColumnCount(header.count());
+        list->setHorizontalHeaderLabels(header);
+        for (int i=0;i<channels.count();i++) {
+            for (int j=0;j<header.count();j++)
+                list->setItem(i,j,new QTableWidgetItem(QString()));
+            list->setRowHeight(i,fm.height()+5);
+        }
+    }
+
+    // O(log n) for each channel, independent from rows count between cursors
+    for (int i=0;i<channels.count();i++) {
+        const CPlotChannel &channel = channels.at(i);
+        CRangeStats stats;
+        if (channel.digital>=0)
+            plotData.digitalStats(channel.digital,range,stats);
+        else
+            plotData.rangeStats(channel.column,range,stats);
+
+        list->item(i,0)->setText(channel.wp.label);
+        list->item(i,1)->setText(formatStat(stats.min));
+        list->item(i,2)->setText(formatStat(stats.max));
+        list->item(i,3)->setText(formatStat(stats.mean));
+        list->item(i,4)->setText(formatStat(stats.stdDev));
+        list->item(i,5)->setText(formatStat(stats.integral));
+        list->item(i,6)->setText(formatStat(stats.timeHigh));
+        if (stats.edges>=0)
+            list->item(i,7)->setText(QString::number(stats.edges));
+        else
+            list->item(i,7)->setText(QString("-"));
+    }
+
+    ui->lblStatsRange->setText(trUtf8("%1 s").arg(range.size(),0,'f',3));
+}
@@ -2,14 +2,43 @@
 #define GRAPHFORM_H
 
 #include <QWidget>
+#include <QThread>
+#include <QTimer>
+#include <QCache>
+#include <QSet>
 #include "qcustomplot-source/qcustomplot.h"
 #include "global.h"
 #include "plc.h"
+#include "csvloader.h"
+#include "plotgraph.h"
+#include "analysisform.h"
 
 namespace Ui {
 class CGraphForm;
 }
 
+class CPlotChannel
+{
+public:
+    CWP wp;
+    int column; // analogue data column, -1 for BOOL
+    int digital; // BOOL transitions, -1 for analogue
+    QCPRange valueRange; // kept while channel is scrolled out of view
+    CPlotChannel();
+};
+
+class CPlotRow
+{
+public:
+    QCPAxisRect* rect;
+    QCPAxis* xAxis;
+    QCPAxis* yAxis;
+    CLODGraph* graph;
+    CDigitalGraph* digital;
+    int channel; // bound channel, -1 for empty row
+    CPlotRow();
+};
+
 class CGraphForm : public QWidget
 {
     Q_OBJECT
@@ -24,40 +53,98 @@ public:
     explicit CGraphForm(QWidget *parent = 0);
     ~CGraphForm();
 
-    void addData(const CWPList &wp, const QDateTime &time, bool noReplot = false);
+    void addData(const CWPList &wp, const QDateTime &time);
+    void addBatch(const CPlotBatch &batch);
+
+    static bool isPlottable(const CWP &wp);
+    static double plotValue(const CWP &wp);
 
 private:
     Ui::CGraphForm *ui;
     CWPList watchpoints;
     QCPItemStraightLine *runningCursor, *leftCursor, *rightCursor;
     bool moveSplitterOnce;
+    QThread* loaderThread;
+    CCSVLoader* loader;
+    bool loaderActive;
+    bool followActive;
+    CAnalysisForm* analysisForm;
+    CArchiveIndex archiveIndex;
+    QCache<int,CPlotBatchList> archiveCache; // decoded blocks, LRU
+    QSet<int> archiveRequested;
+    bool archiveActive;
+    bool archiveDirty;
+    bool archiveBlocksChanged;
+    int archiveFirst, archiveLast; // decoded blocks window, -1 for envelope only
+    CPlotBatch pendingBatch; // live samples, coalesced until next frame
+    CPlotData plotData; // analogue channels with shared timestamps, BOOL transitions
+    QVector<CPlotChannel> channels;
+    QVector<CPlotRow> plotRows; // visible rows only, rebound to channels on vertical scroll
+    QTimer* frameTimer;
+    QTimer* memoryTimer;
+    bool replotPending;
     int getScreenWidth();
     void createCursorSignal(CGraphForm::CursorType cursor, double timestamp);
     QCPRange getTotalKeyRange();
     void updateScrollBarRange();
     void setupGraphs(const CWPList &wp);
     void clearDataEx(bool clearOnlyCursors);
+    void expandValueAxis(int channel, const CMinMax &dataRange);
+    void setValueRange(int channel, const QCPRange &range);
+    void flushPendingData();
+    void layoutRows();
+    void bindRows();
+    void removeCursors();
+    QCPRange visibleKeyRange();
+    qint64 plotMemoryUsage();
+    void openArchive(const QStringList &files);
+    void updateArchiveWindow();
+    void fillArchiveGraphs();
+    void updateRangeStats();
+    void autoScrollTo(double key);
+    void stopFollowing();
 
 protected:
     virtual void closeEvent(QCloseEvent * event);
     virtual void showEvent(QShowEvent * event);
+    virtual bool eventFilter(QObject * obj, QEvent * event);
 
 signals:
     void logMessage(const QString& msg);
     void stopGraph();
     void cursorMoved(CGraphForm::CursorType cursor, const QDateTime &time, const CWPList &wp);
+    void openArchiveRequest(const QStringList& files);
+    void loadBlocksRequest(const QList<int>& blocks);
+    void followFileRequest(const QString& fname);
+    void stopFollowRequest();
 
 public slots:
     void clearData();
     void zoomAll();
+    void fitVisibleValues();
     void loadCSV();
+    void loadArchiveDir();
+    void followCSV();
+    void cancelLoading();
     void exportGraph();
 
 private slots:
     void plotRangeChanged(const QCPRange &newRange);
     void plotMouseMove(QMouseEvent *event);
     void scrollBarMoved(int value);
+    void verticalScrollBarMoved(int value);
     void plotContextMenu(const QPoint &pos);
+    void loaderProgress(int percent);
+    void archivePreview(const CPlotBatchList &batches);
+    void archiveIndexed(bool success, const QString &msg, const CArchiveIndex &index);
+    void archiveBlockLoaded(int block, const CPlotBatchList &batches);
+    void frameTick();
+    void checkMemoryLimit();
+    void autoScrollToggled(bool checked);
+    void renderTiles();
+    void followBatchLoaded(const CPlotBatch &batch);
+    void followStopped(const QString &msg);
+    void analyzeChannel();
 
 };
 
@@ -0,0 +1,326 @@
+#include <cstring>
+#include <qnumeric.h>
+#include "livesegment.h"
+#include "global.h"
+#include "plclive/plclive.h"
+
+#ifdef LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+const static int liveDepth = 256; // frames, 25 s at 100 ms
+const static int liveMinCapacity = 256; // channels
+
+#ifdef LINUX
+static size_t alignUp(size_t v)
+{
+    const size_t align = 64;
+    return ((v+align-1)/align)*align;
+}
+#endif
+
+CLiveChannels::CLiveChannels()
+{
+    wpIndex.clear();
+    elements.clear();
+    labels.clear();
+    addresses.clear();
+    types.clear();
+}
+
+void CLiveChannels::build(const CWPList &wp, const QStringList &filter)
+{
+    wpIndex.clear();
+    elements.clear();
+    labels.clear();
+    addresses.clear();
+    types.clear();
+    for (int i=0;i<wp.count();i++) {
+        const CWP &w = wp.at(i);
+        if (w.isSnapshot() || (w.vtype==CWP::S7NoType)) continue;
+        QString addr = gSet->plcGetAddrName(w);
+        if (!filter.isEmpty() && !filter.contains(w.label) && !filter.contains(addr)) continue;
+        if (w.isArray()) {
+            for (int j=0;j<w.count;j++) {
+                wpIndex << i;
+                elements << j;
+                labels << QString("%1[%2]").arg(w.label).arg(j);
+                addresses << addr;
+                types << static_cast<int>(w.vtype);
+            }
+        } else {
+            wpIndex << i;
+            elements << -1;
+            labels << w.label;
+            addresses << addr;
+            types << static_cast<int>(w.vtype);
+        }
+    }
+}
+
+int CLiveChannels::count() const
+{
+    return wpIndex.count();
+}
+
+QString CLiveChannels::label(int channel) const
+{
+    return labels.at(channel);
+}
+
+QString CLiveChannels::address(int channel) const
+{
+    return addresses.at(channel);
+}
+
+int CLiveChannels::type(int channel) const
+{
+    return types.at(channel);
+}
+
+int CLiveChannels::element(int channel) const
+{
+    return elements.at(channel);
+}
+
+void CLiveChannels::values(const CWPList &wp, double *dst) const
+{
+    int i = 0;
+    while (i<wpIndex.count()) {
+        const CWP &w = wp.at(wpIndex.at(i));
+        if (elements.at(i)<0) {
+            dst[i] = value(w.data);
+            i++;
+            continue;
+        }
+        // elements of one array are adjacent, array is unpacked once
+        QVector<double> av = w.arrayValues();
+        int first = i;
+        while ((i<wpIndex.count()) && (wpIndex.at(i)==wpIndex.at(first))) {
+            int e = elements.at(i);
+            dst[i] = ((e<av.count()) ? av.at(e) : qQNaN());
+            i++;
+        }
+    }
+}
+
+double CLiveChannels::value(const CWPValue &v)
+{
+    switch (v.kind()) {
+        case CWPValue::vkNull:
+        case CWPValue::vkBytes:
+            return qQNaN();
+        case CWPValue::vkTime:
+            if (v.toTime().isValid())
+                return static_cast<double>(QTime(0,0).msecsTo(v.toTime()));
+            return qQNaN();
+        case CWPValue::vkDate:
+            if (v.toDate().isValid())
+                return static_cast<double>(v.toDate().toJulianDay());
+            return qQNaN();
+        default:
+            return v.toDouble();
+    }
+}
+
+CLiveSegment::CLiveSegment(QObject *parent) :
+    QObject(parent)
+{
+    segName.clear();
+    base = NULL;
+    segSize = 0;
+    capacity = 0;
+    failed = false;
+    schemaGen = 0;
+    head = 0;
+    schema.clear();
+}
+
+CLiveSegment::~CLiveSegment()
+{
+    close();
+}
+
+void CLiveSegment::setName(const QString &aName)
+{
+    if (aName==segName) return;
+    close();
+    segName = aName;
+}
+
+QString CLiveSegment::name() const
+{
+    return segName;
+}
+
+bool CLiveSegment::isOpen() const
+{
+    return (base!=NULL);
+}
+
+void CLiveSegment::fail(const QString &msg)
+{
+    // no retries on every frame, segment is tried again after close
+    failed = true;
+    emit errorMessage(msg);
+}
+
+bool CLiveSegment::create(int minCapacity)
+{
+#ifdef LINUX
+    close();
+
+    capacity = qMax(liveMinCapacity,minCapacity);
+    size_t frameSize = alignUp(sizeof(plclive_slot)+static_cast<size_t>(capacity)*sizeof(double));
+    size_t schemaOffset = alignUp(sizeof(plclive_header));
+    size_t ringOffset = alignUp(schemaOffset+static_cast<size_t>(capacity)*sizeof(plclive_channel));
+    size_t size = ringOffset+static_cast<size_t>(liveDepth)*frameSize;
+    QByteArray path = QString("/%1").arg(segName).toLocal8Bit();
+
+    // segment left by crashed writer is marked stale for its readers, running writer keeps it
+    int fd = shm_open(path.constData(),O_RDWR,0);
+    if (fd>=0) {
+        pid_t owner = 0;
+        struct stat st;
+        if ((fstat(fd,&st)==0) && (st.st_size>=static_cast<off_t>(sizeof(plclive_header)))) {
+            void* p = mmap(NULL,sizeof(plclive_header),PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+            if (p!=MAP_FAILED) {
+                plclive_header* hdr = static_cast<plclive_header *>(p);
+                pid_t pid = static_cast<pid_t>(hdr->writer_pid);
+                if ((__atomic_load_n(&hdr->magic,__ATOMIC_ACQUIRE)==PLCLIVE_MAGIC) &&
+                        (__atomic_load_n(&hdr->stale,__ATOMIC_ACQUIRE)==0) && (pid>0) &&
+                        ((kill(pid,0)==0) || (errno==EPERM)))
+                    owner = pid;
+                else
+                    __atomic_store_n(&hdr->stale,1,__ATOMIC_RELEASE);
+                munmap(p,sizeof(plclive_header));
+            }
+        }
+        ::close(fd);
+        if (owner>0) {
+            fail(trUtf8("Live data segment %1 is used by running process %2.")
+                 .arg(segName).arg(owner));
+            return false;
+        }
+        shm_unlink(path.constData());
+    }
+
+    fd = shm_open(path.constData(),O_CREAT | O_EXCL | O_RDWR,0644);
+    if (fd<0) {
+        fail(trUtf8("Unable to create live data segment %1. %2")
+             .arg(segName,QString::fromLocal8Bit(strerror(errno))));
+        return false;
+    }
+    if (ftruncate(fd,static_cast<off_t>(size))!=0) {
+        fail(trUtf8("Unable to resize live data segment %1. %2")
+             .arg(segName,QString::fromLocal8Bit(strerror(errno))));
+        ::close(fd);
+        shm_unlink(path.constData());
+        return false;
+    }
+    void* p = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+    ::close(fd);
+    if (p==MAP_FAILED) {
+        fail(trUtf8("Unable to map live data segment %1. %2")
+             .arg(segName,QString::fromLocal8Bit(strerror(errno))));
+        shm_unlink(path.constData());
+        return false;
+    }
+
+    // new segment is zero filled, magic is set last
+    base = static_cast<uchar *>(p);
+    segSize = size;
+    head = 0;
+    plclive_header* hdr = reinterpret_cast<plclive_header *>(base);
+    hdr->version = PLCLIVE_VERSION;
+    hdr->segment_size = static_cast<uint32_t>(size);
+    hdr->capacity = static_cast<uint32_t>(capacity);
+    hdr->depth = static_cast<uint32_t>(liveDepth);
+    hdr->frame_size = static_cast<uint32_t>(frameSize);
+    hdr->schema_offset = static_cast<uint32_t>(schemaOffset);
+    hdr->ring_offset = static_cast<uint32_t>(ringOffset);
+    hdr->writer_pid = static_cast<int32_t>(getpid());
+    __atomic_store_n(&hdr->magic,PLCLIVE_MAGIC,__ATOMIC_RELEASE);
+    return true;
+#else
+    Q_UNUSED(minCapacity);
+    fail(trUtf8("Live data segment is supported on Linux only."));
+    return false;
+#endif
+}
+
+void CLiveSegment::close()
+{
+#ifdef LINUX
+    if (base!=NULL) {
+        plclive_header* hdr = reinterpret_cast<plclive_header *>(base);
+        __atomic_store_n(&hdr->stale,1,__ATOMIC_RELEASE);
+        munmap(base,segSize);
+        shm_unlink(QString("/%1").arg(segName).toLocal8Bit().constData());
+    }
+#endif
+    base = NULL;
+    segSize = 0;
+    capacity = 0;
+    failed = false;
+    head = 0;
+    schema.clear();
+}
+
+void CLiveSegment::writeSchema()
+{
+    plclive_header* hdr = reinterpret_cast<plclive_header *>(base);
+    uint32_t seq = hdr->schema_seq;
+    __atomic_store_n(&hdr->schema_seq,seq+1,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    plclive_channel* ch = reinterpret_cast<plclive_channel *>(base+hdr->schema_offset);
+    for (int i=0;i<channels.count();i++) {
+        memset(&ch[i],0,sizeof(plclive_channel));
+        qstrncpy(ch[i].label,channels.label(i).toUtf8().constData(),PLCLIVE_LABEL_SIZE);
+        qstrncpy(ch[i].address,channels.address(i).toUtf8().constData(),PLCLIVE_ADDR_SIZE);
+        ch[i].type = static_cast<int32_t>(channels.type(i));
+        ch[i].element = static_cast<int32_t>(channels.element(i));
+    }
+    schemaGen++;
+    hdr->schema_id = schemaGen;
+    hdr->channel_count = static_cast<uint32_t>(channels.count());
+
+    __atomic_store_n(&hdr->schema_seq,seq+2,__ATOMIC_RELEASE);
+}
+
+void CLiveSegment::publish(const CWPList &wp, const QDateTime &time)
+{
+    if (failed || segName.isEmpty() || wp.isEmpty()) return;
+
+    if ((base==NULL) || (wp!=schema)) {
+        channels.build(wp);
+        if ((base==NULL) || (channels.count()>capacity)) {
+            if (!create(channels.count())) return;
+        }
+        schema = wp;
+        writeSchema();
+    }
+
+    // slot seqlock: odd while writing, readers check it before and after copy
+    plclive_header* hdr = reinterpret_cast<plclive_header *>(base);
+    uchar* p = base+hdr->ring_offset+static_cast<size_t>(head & (liveDepth-1))*hdr->frame_size;
+    plclive_slot* slot = reinterpret_cast<plclive_slot *>(p);
+    quint64 seq = 2*head+1;
+    __atomic_store_n(&slot->seq,seq,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    slot->timestamp = time.toMSecsSinceEpoch();
+    slot->schema_id = schemaGen;
+    slot->channel_count = static_cast<uint32_t>(channels.count());
+    channels.values(wp,reinterpret_cast<double *>(p+sizeof(plclive_slot)));
+
+    __atomic_store_n(&slot->seq,seq+1,__ATOMIC_RELEASE);
+    head++;
+    __atomic_store_n(&hdr->head,head,__ATOMIC_RELEASE);
+}
@@ -0,0 +1,75 @@
+#ifndef LIVESEGMENT_H
+#define LIVESEGMENT_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+#include <QDateTime>
+#include "plc.h"
+
+// Flat numeric view of scan for external consumers: scalar watchpoints and
+// elements of arrays are channels, snapshots are skipped
+class CLiveChannels
+{
+public:
+    CLiveChannels();
+    // filter has labels or addresses of watchpoints, empty for all
+    void build(const CWPList& wp, const QStringList& filter = QStringList());
+    int count() const;
+    QString label(int channel) const;
+    QString address(int channel) const;
+    int type(int channel) const;
+    int element(int channel) const; // -1 for scalar
+    void values(const CWPList& wp, double* dst) const; // wp with schema of build
+
+    // BOOL 0/1, TIME and TIME_OF_DAY in msecs, DATE as julian day, NaN for no data
+    static double value(const CWPValue& v);
+
+private:
+    QVector<int> wpIndex; // source watchpoint of each channel
+    QVector<int> elements;
+    QStringList labels;
+    QStringList addresses;
+    QVector<int> types;
+};
+
+// Latest scans and short history for local processes in POSIX shared memory,
+// layout and reader library are in plclive/plclive.h. Writer is fed from sample bus,
+// segment is created on first frame and removed on close.
+class CLiveSegment : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CLiveSegment(QObject *parent = NULL);
+    virtual ~CLiveSegment();
+
+    void setName(const QString& aName); // segment is recreated on next frame after change
+    QString name() const;
+    bool isOpen() const;
+
+private:
+    QString segName;
+    uchar* base;
+    size_t segSize;
+    int capacity;
+    bool failed;
+    quint32 schemaGen;
+    quint64 head;
+    CWPList schema;
+    CLiveChannels channels;
+
+    bool create(int minCapacity);
+    void writeSchema();
+    void fail(const QString& msg);
+
+signals:
+    void errorMessage(const QString& msg);
+
+public slots:
+    void publish(const CWPList& wp, const QDateTime& time);
+    void close();
+
+};
+
+#endif // LIVESEGMENT_H
@@ -2,6 +2,7 @@
 #include "mainwindow.h"
 #include "graphform.h"
 #include "plc.h"
+#include "plotexport.h"
 
 #ifdef LINUX
 #include <signal.h>
@@ -30,10 +31,29 @@ int main(int argc, char *argv[])
     qRegisterMetaType<CWPList>("CWPList");
     qRegisterMetaType<CPairing>("CPairing");
     qRegisterMetaType<CGraphForm::CursorType>("CGraphForm::CursorType");
+    qRegisterMetaType<CPlotBatch>("CPlotBatch");
+    qRegisterMetaType<CPlotBatchList>("CPlotBatchList");
+    qRegisterMetaType<CArchiveIndex>("CArchiveIndex");
+    qRegisterMetaType<QList<int> >("QList<int>");
 
     initGraphFormData();
 
+    // headless batch export, offscreen platform unless specified
+    bool exportMode = false;
+    // same option forms as QCommandLineParser: --export dir and --export=dir
+    for (int i=1;i<argc;i++) {
+        QByteArray arg(argv[i]);
+        if (arg=="--") break;
+        if ((arg=="--export") || arg.startsWith("--export="))
+            exportMode = true;
+    }
+    if (exportMode && qgetenv("QT_QPA_PLATFORM").isEmpty())
+        qputenv("QT_QPA_PLATFORM","offscreen");
+
     QApplication a(argc, argv);
+    if (exportMode)
+        return CPlotExporter::exec(a.arguments());
+
     MainWindow w;
     mw = &w;
     w.show();
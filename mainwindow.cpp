@@ -1,4 +1,5 @@
 #include <QMessageBox>
+#include <QElapsedTimer>
 
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
@@ -6,10 +7,10 @@
 #include "varmodel.h"
 #include "settingsdialog.h"
 #include "specwidgets.h"
+#include "symimport.h"
+#include "snapshot.h"
 #include <limits.h>
 
-#define PLR_VERSION 2
-
 CGlobal *gSet = NULL;
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -32,6 +33,7 @@ MainWindow::MainWindow(QWidget *parent) :
     autoOnLogging = false;
     savedCSVActive = false;
     aggregatedStartActive = false;
+    ctxRow = -1;
 
     lblState = new QLabel(trUtf8("Offline"));
     cbVat = new QCheckBox(trUtf8("Online VAT"));
@@ -41,10 +43,14 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->statusBar->addPermanentWidget(cbRec);
     ui->statusBar->addPermanentWidget(cbVat);
     ui->statusBar->addPermanentWidget(lblState);
+    lblBus = new QLabel();
+    ui->statusBar->addPermanentWidget(lblBus);
 
     connect(ui->actionSettings,SIGNAL(triggered()),this,SLOT(settingsDlg()));
     connect(ui->actionLoadConnection,SIGNAL(triggered()),this,SLOT(loadConnection()));
     connect(ui->actionSaveConnection,SIGNAL(triggered()),this,SLOT(saveConnection()));
+    connect(ui->actionImportSymbols,SIGNAL(triggered()),this,SLOT(importSymbols()));
+    connect(ui->actionExtractSnapshots,SIGNAL(triggered()),this,SLOT(extractSnapshots()));
     connect(ui->actionForceRotateCSV,SIGNAL(triggered()),csvHandler,SLOT(rotateFile()));
     connect(ui->actionAbout,SIGNAL(triggered()),this,SLOT(aboutMsg()));
     connect(ui->actionAboutQt,SIGNAL(triggered()),this,SLOT(aboutQtMsg()));
@@ -68,6 +74,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->btnConnect->setEnabled(true);
     ui->btnDisconnect->setEnabled(false);
     ui->actionLoadConnection->setEnabled(true);
+    ui->actionImportSymbols->setEnabled(true);
     ui->actionSaveConnection->setEnabled(true);
     ui->actionForceRotateCSV->setEnabled(false);
     cbVat->setEnabled(false);
@@ -100,8 +107,36 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(plc,SIGNAL(plcOnDisconnect()),this,SLOT(plcDisconnected()),Qt::QueuedConnection);
     connect(plc,SIGNAL(plcOnStart()),this,SLOT(plcStarted()),Qt::QueuedConnection);
     connect(plc,SIGNAL(plcOnStop()),this,SLOT(plcStopped()),Qt::QueuedConnection);
-    connect(plc,SIGNAL(plcVariablesUpdatedConsistent(CWPList,QDateTime)),
-            this,SLOT(plcVariablesUpdatedConsistent(CWPList,QDateTime)),Qt::QueuedConnection);
+
+    // each consumer has own cursor in acquisition ring: VAT shows latest scan only,
+    // CSV is lossless while recording, plots drop oldest scans when GUI thread stalls
+    vatReader = new CSampleReader(plc->sampleBus(),CSampleReader::spConflate,this);
+    csvReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    plotReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    waterfallReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    liveReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    connect(vatReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(vatFrame(CWPList,QDateTime)));
+    connect(csvReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(csvFrame(CWPList,QDateTime)));
+    connect(cbRec,SIGNAL(toggled(bool)),this,SLOT(csvRecToggled(bool)));
+    connect(plotReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(plotFrame(CWPList,QDateTime)));
+    connect(waterfallReader,SIGNAL(frameReady(CWPList,QDateTime)),
+            this,SLOT(waterfallFrame(CWPList,QDateTime)));
+    connect(liveReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(liveFrame(CWPList,QDateTime)));
+
+    liveSegment = new CLiveSegment(this);
+    connect(liveSegment,SIGNAL(errorMessage(QString)),this,SLOT(appendLog(QString)));
+
+    streamReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    connect(streamReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(streamFrame(CWPList,QDateTime)));
+    streamServer = new CStreamServer(this);
+    connect(streamServer,SIGNAL(logMessage(QString)),this,SLOT(appendLog(QString)));
+    connect(streamServer,SIGNAL(brokerSubscribe(int,CWPList,int)),plc,SLOT(plcSubscribe(int,CWPList,int)));
+    connect(streamServer,SIGNAL(brokerUnsubscribe(int)),plc,SLOT(plcUnsubscribe(int)));
+    connect(streamServer,SIGNAL(brokerConsumed(int)),plc,SLOT(plcSubscriptionConsumed(int)));
+    connect(plc,SIGNAL(plcSubscriptionData(int,CWPList,QDateTime)),
+            streamServer,SLOT(brokerData(int,CWPList,QDateTime)),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcSubscriptionFailed(int,QString)),
+            streamServer,SLOT(brokerFailed(int,QString)),Qt::QueuedConnection);
     connect(plc,SIGNAL(plcScanTime(QString)),ui->lblActualAcqInterval,SLOT(setText(QString)),Qt::QueuedConnection);
 
     connect(ui->tableVariables,SIGNAL(customContextMenuRequested(QPoint)),this,SLOT(variablesCtxMenu(QPoint)));
@@ -120,6 +155,11 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(syncTimer,SIGNAL(timeout()),this,SLOT(syncTimer()));
     syncTimer->start();
 
+    QTimer* busTimer = new QTimer(this);
+    busTimer->setInterval(1000);
+    connect(busTimer,SIGNAL(timeout()),this,SLOT(busStats()));
+    busTimer->start();
+
     bool needToStart = false;
     for (int i=1;i<QApplication::arguments().count();i++) {
         QString s = QApplication::arguments().at(i);
@@ -141,6 +181,10 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(this,SIGNAL(csvSync()),csvHandler,SLOT(timerSync()));
 
     gSet->loadSettings();
+    liveSegment->setName(gSet->liveSegmentName);
+    streamServer->setBrokerEnabled(gSet->streamBroker);
+    if (gSet->streamServer)
+        streamServer->listen(gSet->streamServerName);
 }
 
 MainWindow::~MainWindow()
@@ -229,6 +273,7 @@ void MainWindow::plcConnected()
     cbPlot->setStyleSheet(QString());
 
     ui->actionLoadConnection->setEnabled(false);
+    ui->actionImportSymbols->setEnabled(false);
 
     lblState->setText(trUtf8("Online"));
     appendLog(trUtf8("Connected to PLC."));
@@ -254,6 +299,7 @@ void MainWindow::plcDisconnected()
     cbPlot->setStyleSheet(QString());
 
     ui->actionLoadConnection->setEnabled(true);
+    ui->actionImportSymbols->setEnabled(true);
     lblState->setText(trUtf8("Offline"));
     appendLog(trUtf8("Disconnected from PLC."));
 
@@ -263,6 +309,12 @@ void MainWindow::plcDisconnected()
 
 void MainWindow::plcStarted()
 {
+    vatReader->resetDropped();
+    csvReader->resetDropped();
+    plotReader->resetDropped();
+    waterfallReader->resetDropped();
+    liveReader->resetDropped();
+    streamReader->resetDropped();
     agcRestartCounter = 0;
     aggregatedStartActive = false;
     ui->btnConnect->setEnabled(false);
@@ -280,6 +332,7 @@ void MainWindow::plcStarted()
     cbPlot->setStyleSheet(QString());
 
     ui->actionLoadConnection->setEnabled(false);
+    ui->actionImportSymbols->setEnabled(false);
     lblState->setText(trUtf8("<b>ONLINE</b>"));
     appendLog(trUtf8("Activating ONLINE."));
 
@@ -308,10 +361,12 @@ void MainWindow::plcStopped()
     cbPlot->setStyleSheet(QString());
 
     ui->actionLoadConnection->setEnabled(false);
+    ui->actionImportSymbols->setEnabled(false);
     lblState->setText(trUtf8("Online"));
     appendLog(trUtf8("Deactivating ONLINE."));
 
     csvHandler->stopClose();
+    liveSegment->close();
     ui->actionForceRotateCSV->setEnabled(false);
 }
 
@@ -334,21 +389,69 @@ void MainWindow::plcErrorMsg(const QString &msg, bool critical)
         QMessageBox::critical(this,trUtf8("PLC recorder error"),msg);
 }
 
-void MainWindow::plcVariablesUpdatedConsistent(const CWPList &wp, const QDateTime &stm)
+void MainWindow::vatFrame(const CWPList &wp, const QDateTime &)
 {
-    // Updating VAT
     if (cbVat->isChecked())
         vtmodel->loadActualsFromPLC(wp);
+}
 
-    // Updating CSV
+void MainWindow::csvFrame(const CWPList &wp, const QDateTime &stm)
+{
     if (cbRec->isChecked())
         csvHandler->addData(wp,stm);
+}
 
-    // Updating Plot
+void MainWindow::plotFrame(const CWPList &wp, const QDateTime &stm)
+{
     if (cbPlot->isChecked())
         graph->addData(wp,stm);
 }
 
+void MainWindow::waterfallFrame(const CWPList &wp, const QDateTime &stm)
+{
+    for (int i=0;i<waterfalls.count();i++)
+        waterfalls.at(i)->addData(wp,stm);
+}
+
+void MainWindow::liveFrame(const CWPList &wp, const QDateTime &stm)
+{
+    if (gSet->liveSegment)
+        liveSegment->publish(wp,stm);
+}
+
+void MainWindow::streamFrame(const CWPList &wp, const QDateTime &stm)
+{
+    if (streamServer->isListening())
+        streamServer->publish(wp,stm);
+}
+
+void MainWindow::busStats()
+{
+    QList<CSampleReader*> readers;
+    QStringList names;
+    readers << vatReader << csvReader << plotReader << waterfallReader << liveReader << streamReader;
+    names << trUtf8("VAT") << trUtf8("CSV") << trUtf8("Plot") << trUtf8("Waterfalls") << trUtf8("Live segment")
+          << trUtf8("Stream");
+
+    int depth = 0;
+    int drops = 0;
+    QStringList sl;
+    for (int i=0;i<readers.count();i++) {
+        depth = qMax(depth,readers.at(i)->pending());
+        drops += readers.at(i)->dropped();
+        sl << trUtf8("%1: queue %2, dropped %3").arg(names.at(i))
+              .arg(readers.at(i)->pending()).arg(readers.at(i)->dropped());
+    }
+    if (streamServer->isListening())
+        sl << trUtf8("Stream clients: %1, conflated %2").arg(streamServer->clientCount())
+              .arg(streamServer->conflatedFrames());
+    if (drops>0)
+        lblBus->setText(trUtf8("Queue %1, dropped %2").arg(depth).arg(drops));
+    else
+        lblBus->setText(trUtf8("Queue %1").arg(depth));
+    lblBus->setToolTip(sl.join(QChar('\n')));
+}
+
 void MainWindow::connectPLC()
 {
     vtmodel->syncPLC();
@@ -383,22 +486,39 @@ void MainWindow::aboutQtMsg()
 
 void MainWindow::variablesCtxMenu(QPoint pos)
 {
-    if (!vtmodel->isEditEnabled()) return;
-
     QMenu cm(ui->tableVariables);
-
     QAction* acm;
-    acm = cm.addAction(QIcon(":/new"),trUtf8("Add variable"));
-    connect(acm,SIGNAL(triggered()),this,SLOT(ctxNew()));
 
-    acm = cm.addAction(QIcon(":/delete"),trUtf8("Remove variable"));
-    connect(acm,SIGNAL(triggered()),this,SLOT(ctxRemove()));
-    acm->setEnabled(!(ui->tableVariables->selectionModel()->selectedIndexes().isEmpty()));
+    // array actions are available online too
+    ctxRow = vtmodel->wpIndex(ui->tableVariables->indexAt(pos).row());
+    if ((ctxRow>=0) && vtmodel->getCWP(ctxRow).isArray()) {
+        if (vtmodel->isExpanded(ctxRow))
+            acm = cm.addAction(trUtf8("Collapse array"));
+        else
+            acm = cm.addAction(trUtf8("Expand array"));
+        connect(acm,SIGNAL(triggered()),this,SLOT(ctxToggleArray()));
 
-    cm.addSeparator();
+        acm = cm.addAction(QIcon(":/wave"),trUtf8("Show waterfall"));
+        connect(acm,SIGNAL(triggered()),this,SLOT(ctxShowWaterfall()));
 
-    acm = cm.addAction(trUtf8("Remove all"));
-    connect(acm,SIGNAL(triggered()),this,SLOT(ctxRemoveAll()));
+        if (vtmodel->isEditEnabled())
+            cm.addSeparator();
+    }
+
+    if (vtmodel->isEditEnabled()) {
+        acm = cm.addAction(QIcon(":/new"),trUtf8("Add variable"));
+        connect(acm,SIGNAL(triggered()),this,SLOT(ctxNew()));
+
+        acm = cm.addAction(QIcon(":/delete"),trUtf8("Remove variable"));
+        connect(acm,SIGNAL(triggered()),this,SLOT(ctxRemove()));
+        acm->setEnabled(!(ui->tableVariables->selectionModel()->selectedIndexes().isEmpty()));
+
+        cm.addSeparator();
+
+        acm = cm.addAction(trUtf8("Remove all"));
+        connect(acm,SIGNAL(triggered()),this,SLOT(ctxRemoveAll()));
+    }
+    if (cm.isEmpty()) return;
 
     QPoint p = pos;
     p.setY(p.y()+ui->tableVariables->horizontalHeader()->height());
@@ -408,7 +528,7 @@ void MainWindow::variablesCtxMenu(QPoint pos)
 
 void MainWindow::ctxNew()
 {
-    vtmodel->insertRow(vtmodel->getCWPCount());
+    vtmodel->insertRow(vtmodel->rowCount());
 }
 
 void MainWindow::ctxRemove()
@@ -425,7 +545,30 @@ void MainWindow::ctxRemove()
 
 void MainWindow::ctxRemoveAll()
 {
-    vtmodel->removeRows(0,vtmodel->getCWPCount());
+    vtmodel->removeRows(0,vtmodel->rowCount());
+}
+
+void MainWindow::ctxToggleArray()
+{
+    if ((ctxRow<0) || (ctxRow>=vtmodel->getCWPCount())) return;
+    vtmodel->setExpanded(ctxRow,!vtmodel->isExpanded(ctxRow));
+}
+
+void MainWindow::ctxShowWaterfall()
+{
+    if ((ctxRow<0) || (ctxRow>=vtmodel->getCWPCount())) return;
+
+    CWaterfallForm* form = new CWaterfallForm(vtmodel->getCWP(ctxRow),this);
+    form->setWindowFlags(form->windowFlags() | Qt::Window);
+    form->setAttribute(Qt::WA_DeleteOnClose,true);
+    connect(form,SIGNAL(destroyed(QObject*)),this,SLOT(waterfallClosed(QObject*)));
+    waterfalls << form;
+    form->show();
+}
+
+void MainWindow::waterfallClosed(QObject *form)
+{
+    waterfalls.removeAll(static_cast<CWaterfallForm *>(form));
 }
 
 void MainWindow::settingsDlg()
@@ -433,7 +576,10 @@ void MainWindow::settingsDlg()
     CSettingsDialog dlg;
     dlg.setParams(gSet->outputCSVDir,gSet->outputFileTemplate,gSet->tmTCPTimeout,gSet->tmMaxRecErrorCount,
                   gSet->tmMaxConnectRetryCount,gSet->tmWaitReconnect,gSet->tmTotalRetryCount,gSet->suppressMsgBox,
-                  gSet->restoreCSV,gSet->plotVerticalSize,gSet->plotShowScatter,gSet->plotAntialiasing);
+                  gSet->restoreCSV,gSet->plotVerticalSize,gSet->plotShowScatter,gSet->plotAntialiasing,
+                  gSet->plotFrameRate,gSet->plotMemoryLimit,gSet->vatRefreshRate,
+                  gSet->liveSegment,gSet->liveSegmentName,gSet->streamServer,gSet->streamServerName,
+                  gSet->streamBroker);
     if (dlg.exec()) {
         gSet->tmTCPTimeout = dlg.getTCPTimeout();
         gSet->tmMaxRecErrorCount = dlg.getMaxRecErrorCount();
@@ -447,6 +593,25 @@ void MainWindow::settingsDlg()
         gSet->plotVerticalSize = dlg.getPlotVerticalSize();
         gSet->plotShowScatter = dlg.getPlotShowScatter();
         gSet->plotAntialiasing = dlg.getPlotAntialiasing();
+        gSet->plotFrameRate = dlg.getPlotFrameRate();
+        gSet->plotMemoryLimit = dlg.getPlotMemoryLimit();
+        gSet->vatRefreshRate = dlg.getVatRefreshRate();
+        gSet->liveSegment = dlg.getLiveSegment();
+        gSet->liveSegmentName = dlg.getLiveSegmentName();
+        liveSegment->setName(gSet->liveSegmentName);
+        if (!gSet->liveSegment)
+            liveSegment->close();
+        bool restartStream = (gSet->streamServer!=dlg.getStreamServer()) ||
+                             (gSet->streamServerName!=dlg.getStreamServerName());
+        gSet->streamServer = dlg.getStreamServer();
+        gSet->streamServerName = dlg.getStreamServerName();
+        gSet->streamBroker = dlg.getStreamBroker();
+        streamServer->setBrokerEnabled(gSet->streamBroker);
+        if (restartStream) {
+            streamServer->close();
+            if (gSet->streamServer)
+                streamServer->listen(gSet->streamServerName);
+        }
     }
 }
 
@@ -460,6 +625,62 @@ void MainWindow::loadConnection()
     loadConnectionFromFile(s);
 }
 
+void MainWindow::importSymbols()
+{
+    QStringList files = getOpenFileNamesD(this,trUtf8("Import symbols"),gSet->savedAuxDir,
+                                          CSymbolImporter::fileFilter());
+    if (files.isEmpty()) return;
+    gSet->savedAuxDir = QFileInfo(files.first()).absolutePath();
+
+    QElapsedTimer tmr;
+    tmr.start();
+
+    // symbol tables first, DB sources refer to DB and UDT symbols
+    CSymbolImporter importer;
+    for (int i=0;i<files.count();i++)
+        if (CSymbolImporter::isSymbolTable(files.at(i)))
+            importer.importFile(files.at(i));
+    for (int i=0;i<files.count();i++)
+        if (!CSymbolImporter::isSymbolTable(files.at(i)))
+            importer.importFile(files.at(i));
+
+    CWPList wpl = importer.watchpoints();
+    vtmodel->appendWatchpoints(wpl);
+
+    QStringList warns = importer.warnings();
+    for (int i=0;i<warns.count();i++)
+        appendLog(warns.at(i));
+    appendLog(trUtf8("%1 variables imported from %2 files in %3 ms, %4 entries skipped.")
+              .arg(wpl.count()).arg(files.count()).arg(tmr.elapsed()).arg(importer.skippedCount()));
+}
+
+void MainWindow::extractSnapshots()
+{
+    QString src = getOpenFileNameD(this,trUtf8("CSV recording with snapshots"),gSet->savedAuxDir,
+                                   trUtf8("CSV files (*.csv)"));
+    if (src.isEmpty()) return;
+    gSet->savedAuxDir = QFileInfo(src).absolutePath();
+    QString dst = getSaveFileNameD(this,trUtf8("Save extracted variables"),gSet->savedAuxDir,
+                                   trUtf8("CSV files (*.csv)"));
+    if (dst.isEmpty()) return;
+
+    // variable table defines typed views over recorded images
+    CWPList views;
+    for (int i=0;i<vtmodel->getCWPCount();i++)
+        views << vtmodel->getCWP(i);
+
+    QElapsedTimer tmr;
+    tmr.start();
+    CSnapshotExtractor extractor;
+    if (!extractor.extract(src,dst,views)) {
+        appendLog(extractor.errorMessage());
+        QMessageBox::critical(this,trUtf8("PLC recorder error"),extractor.errorMessage());
+        return;
+    }
+    appendLog(trUtf8("%1 variables extracted from %2 scans of %3 in %4 ms.")
+              .arg(extractor.viewCount()).arg(extractor.scans()).arg(src).arg(tmr.elapsed()));
+}
+
 void MainWindow::saveConnection()
 {
     QString s = getSaveFileNameD(this,trUtf8("Save connection settings file"),gSet->savedAuxDir,
@@ -484,6 +705,12 @@ void MainWindow::saveConnection()
     }
 }
 
+void MainWindow::csvRecToggled(bool checked)
+{
+    // acquisition waits for CSV writer only while recording
+    csvReader->setPolicy(checked ? CSampleReader::spBlock : CSampleReader::spDropOldest);
+}
+
 void MainWindow::csvControl()
 {
     bool fileOpened = false;
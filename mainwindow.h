@@ -8,6 +8,10 @@
 #include "plc.h"
 #include "graphform.h"
 #include "csvhandler.h"
+#include "waterfallform.h"
+#include "samplebus.h"
+#include "livesegment.h"
+#include "streamserver.h"
 
 class CVarModel;
 class CVarDelegate;
@@ -38,10 +42,21 @@ private:
     QThread* plcThread;
     QLabel* lblState;
     QLabel* lblScanTime;
+    QLabel* lblBus;
+    CSampleReader* vatReader;
+    CSampleReader* csvReader;
+    CSampleReader* plotReader;
+    CSampleReader* waterfallReader;
+    CSampleReader* liveReader;
+    CLiveSegment* liveSegment;
+    CSampleReader* streamReader;
+    CStreamServer* streamServer;
     int agcRestartCounter;
     bool autoOnLogging;
     bool savedCSVActive;
     bool aggregatedStartActive;
+    QList<CWaterfallForm*> waterfalls;
+    int ctxRow;
 
     void loadConnectionFromFile(const QString& fname);
 
@@ -58,7 +73,13 @@ public slots:
     void plcStopped();
     void plcStartFailed();
     void plcErrorMsg(const QString &msg, bool critical);
-    void plcVariablesUpdatedConsistent(const CWPList& wp, const QDateTime& stm);
+    void vatFrame(const CWPList& wp, const QDateTime& stm);
+    void csvFrame(const CWPList& wp, const QDateTime& stm);
+    void plotFrame(const CWPList& wp, const QDateTime& stm);
+    void waterfallFrame(const CWPList& wp, const QDateTime& stm);
+    void liveFrame(const CWPList& wp, const QDateTime& stm);
+    void streamFrame(const CWPList& wp, const QDateTime& stm);
+    void busStats();
 
     void connectPLC();
     void aboutMsg();
@@ -67,6 +88,8 @@ public slots:
     void settingsDlg();
     void loadConnection();
     void saveConnection();
+    void importSymbols();
+    void extractSnapshots();
 
     void plotControl();
     void plotStop();
@@ -74,6 +97,7 @@ public slots:
     void vatControl();
 
     void csvControl();
+    void csvRecToggled(bool checked);
 
     void ctlAggregatedStart();
     void ctlAggregatedStartForce();
@@ -90,6 +114,9 @@ public slots:
     void ctxNew();
     void ctxRemove();
     void ctxRemoveAll();
+    void ctxToggleArray();
+    void ctxShowWaterfall();
+    void waterfallClosed(QObject* form);
 
 signals:
     void plcSetAddress(const QString& Ip, int Rack, int Slot, int Timeout);
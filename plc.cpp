@@ -1,4 +1,10 @@
 #include <limits.h>
+#include <cstring>
+#include <qnumeric.h>
+#include <QtEndian>
+#include <QAtomicInt>
+#include <QHash>
+#include <new>
 #include "specwidgets.h"
 #include "plc.h"
 #include "plc_p.h"
@@ -10,6 +16,10 @@ extern "C" {
 
 #include <QDebug>
 
+const static int maxPDU = 200; // single request payload, larger arrays are read with daveReadManyBytes
+const static int minSubscriptionInterval = 10; // ms, fastest scan broker clients may request
+const static int maxSnapshotLength = 65534; // bytes, largest DB of S7-300/400 CPUs
+
 CPLC::CPLC(QObject *parent) :
     QObject(parent),
     dptr(new CPLCPrivate(this))
@@ -32,6 +42,10 @@ CPLC::CPLC(QObject *parent) :
     dptr->daveConn = NULL;
 
     dptr->watchpoints.clear();
+    dptr->subscribers.clear();
+    dptr->subscribers << CPLCSubscriber();
+    dptr->ownerDirect = true;
+    dptr->acqInterval = 100;
 
     dptr->mainClock = NULL;
     dptr->resClock = NULL;
@@ -45,6 +59,11 @@ CPLC::~CPLC()
     dptr->deleteLater();
 }
 
+CSampleBus *CPLC::sampleBus() const
+{
+    return dptr->bus;
+}
+
 void CPLC::plcSetWatchpoints(const CWPList &aWatchpoints)
 {
     if (dptr->state!=splcDisconnected) {
@@ -52,13 +71,165 @@ void CPLC::plcSetWatchpoints(const CWPList &aWatchpoints)
         return;
     }
 
-    dptr->watchpoints = aWatchpoints;
+    dptr->subscribers[0].wp = aWatchpoints;
+    dptr->subscribers[0].wp.setSchemaId(CWPList::newSchemaId());
 
-    if (!dptr->rearrangeWatchpoints()) {
-        dptr->watchpoints.clear();
-        dptr->pairings.clear();
+    QString msg;
+    if (!dptr->buildReadPlan(msg)) {
+        dptr->subscribers[0].wp.clear();
+        dptr->buildReadPlan(msg);
+        return;
+    }
+}
+
+void CPLC::plcSubscribe(int id, const CWPList &aWatchpoints, int interval)
+{
+    if (id<=0) return;
+    plcUnsubscribe(id);
+
+    CPLCSubscriber s;
+    s.id = id;
+    s.wp = aWatchpoints;
+    s.wp.setSchemaId(CWPList::newSchemaId());
+    s.interval = ((interval>0) ? qMax(interval,minSubscriptionInterval) : 0);
+    dptr->subscribers << s;
+
+    QString msg;
+    if (!dptr->buildReadPlan(msg)) {
+        dptr->subscribers.removeLast();
+        QString dummy;
+        dptr->buildReadPlan(dummy);
+        emit plcSubscriptionFailed(id,msg);
+        return;
+    }
+    dptr->updateScanInterval();
+}
+
+void CPLC::plcUnsubscribe(int id)
+{
+    if (id<=0) return;
+    for (int i=1;i<dptr->subscribers.count();i++) {
+        if (dptr->subscribers.at(i).id==id) {
+            dptr->subscribers.removeAt(i);
+            QString msg;
+            dptr->buildReadPlan(msg);
+            dptr->updateScanInterval();
+            return;
+        }
+    }
+}
+
+void CPLC::plcSubscriptionConsumed(int id)
+{
+    for (int i=1;i<dptr->subscribers.count();i++) {
+        CPLCSubscriber &s = dptr->subscribers[i];
+        if (s.id!=id) continue;
+        if (s.conflated) {
+            s.conflated = false;
+            emit plcSubscriptionData(s.id,s.latest,s.time);
+        } else
+            s.inFlight = false;
+        return;
+    }
+}
+
+static QString wpReadKey(const CWP& wp)
+{
+    return QString("%1/%2/%3/%4/%5/%6").arg(static_cast<int>(wp.varea)).arg(wp.vdb).arg(wp.offset)
+            .arg(wp.bitnum).arg(static_cast<int>(wp.vtype)).arg(wp.count);
+}
+
+bool CPLCPrivate::buildReadPlan(QString &errorMsg)
+{
+    // same variable of several lists is read and decoded once
+    watchpoints.clear();
+    QHash<QString,int> keys;
+    for (int i=0;i<subscribers.count();i++) {
+        CPLCSubscriber &s = subscribers[i];
+        s.map.clear();
+        for (int j=0;j<s.wp.count();j++) {
+            QString key = wpReadKey(s.wp.at(j));
+            int idx = keys.value(key,-1);
+            if (idx<0) {
+                idx = watchpoints.count();
+                watchpoints << s.wp.at(j);
+                keys.insert(key,idx);
+            }
+            s.map << idx;
+        }
+    }
+    ownerDirect = ((subscribers.count()==1) && (watchpoints.count()==subscribers.first().wp.count()));
+    if (ownerDirect)
+        watchpoints.setSchemaId(subscribers.first().wp.schemaId());
+    else
+        watchpoints.setSchemaId(CWPList::newSchemaId());
+
+    // broker clients may subscribe while recording, plan is rebuilt between scans
+    if ((daveConn!=NULL) && !resolveSnapshots(errorMsg))
+        return false;
+    if (!rearrangeWatchpoints()) {
+        errorMsg = trUtf8("Unable to parse and rearrange variable list.");
+        return false;
+    }
+    return true;
+}
+
+void CPLCPrivate::updateScanInterval()
+{
+    int interval = acqInterval;
+    subscribers[0].interval = acqInterval;
+    for (int i=1;i<subscribers.count();i++) {
+        if (subscribers.at(i).interval>0)
+            interval = qMin(interval,subscribers.at(i).interval);
+    }
+    if ((mainClock!=NULL) && (mainClock->interval()!=interval))
+        mainClock->setInterval(interval);
+}
+
+CWPList CPLCPrivate::subscriberFrame(const CPLCSubscriber &s) const
+{
+    // published frame is new list, read plan is decoded in place and never shared with consumers
+    CWPList frame;
+    frame.reserve(s.map.count());
+    for (int j=0;j<s.map.count();j++) {
+        const CWP &src = watchpoints.at(s.map.at(j));
+        frame << s.wp.at(j);
+        frame.last().data = src.data;
+        frame.last().dataSign = src.dataSign;
+    }
+    frame.setSchemaId(s.wp.schemaId());
+    return frame;
+}
+
+void CPLCPrivate::fanOut(const QDateTime &tms)
+{
+    if (ownerDirect) {
+        bus->publish(subscriberFrame(subscribers.first()),tms);
         return;
     }
+
+    qint64 now = tms.toMSecsSinceEpoch();
+    int scanInterval = mainClock->interval();
+    for (int i=0;i<subscribers.count();i++) {
+        CPLCSubscriber &s = subscribers[i];
+        // half of scan interval absorbs timer jitter
+        if ((s.lastSent>=0) && ((now-s.lastSent+scanInterval/2)<s.interval)) continue;
+        s.lastSent = now;
+        if (i==0) {
+            bus->publish(subscriberFrame(s),tms);
+            continue;
+        }
+
+        // one frame per client in event queue, slow client gets latest values only
+        s.latest = subscriberFrame(s);
+        s.time = tms;
+        if (s.inFlight) {
+            s.conflated = true;
+            continue;
+        }
+        s.inFlight = true;
+        emit qptr->plcSubscriptionData(s.id,s.latest,tms);
+    }
 }
 
 void CPLC::plcSetRetryParams(int maxErrorCnt, int maxRetryCnt, int waitReconnect)
@@ -68,18 +239,63 @@ void CPLC::plcSetRetryParams(int maxErrorCnt, int maxRetryCnt, int waitReconnect
     dptr->tmWaitReconnect = waitReconnect;
 }
 
-bool CPLCPrivate::rearrangeWatchpoints()
+bool CPLCPrivate::resolveSnapshots(QString &errorMsg)
 {
-    if (state != CPLC::splcDisconnected) {
-        qDebug() << "ERROR: rearrange called after connection";
+    // whole DB snapshots get length from block info, called after connect but before state change
+    bool resolved = false;
+    for (int i=0;i<watchpoints.count();i++) {
+        const CWP &wp = watchpoints.at(i);
+        if (!wp.isSnapshot() || (wp.offset>=0)) continue;
+        // block info is filled only for reply of expected size
+        daveBlockInfo dbi;
+        memset(&dbi,0,sizeof(dbi));
+        int res = daveGetBlockInfo(daveConn,&dbi,daveBlockType_DB,wp.vdb);
+        if (res!=0) {
+            errorMsg = trUtf8("Unable to get length of DB%1 for snapshot '%2'. %3")
+                       .arg(wp.vdb).arg(wp.label).arg(QString(daveStrerror(res)));
+            return false;
+        }
+        if ((dbi.length==0) || (static_cast<int>(dbi.length)>maxSnapshotLength)) {
+            errorMsg = trUtf8("Invalid length %1 of DB%2 for snapshot '%3'.")
+                       .arg(dbi.length).arg(wp.vdb).arg(wp.label);
+            return false;
+        }
+        watchpoints[i].offset = 0;
+        watchpoints[i].count = dbi.length;
+        resolved = true;
+    }
+    if (resolved) {
+        // lengths are passed to lists of subscribers, their consumers see new schema
+        for (int i=0;i<subscribers.count();i++) {
+            CPLCSubscriber &s = subscribers[i];
+            bool changed = false;
+            for (int j=0;j<s.map.count();j++) {
+                const CWP &wp = watchpoints.at(s.map.at(j));
+                if (!wp.isSnapshot() || (s.wp.at(j).offset==wp.offset)) continue;
+                s.wp[j].offset = wp.offset;
+                s.wp[j].count = wp.count;
+                changed = true;
+            }
+            if (changed)
+                s.wp.setSchemaId(CWPList::newSchemaId());
+        }
+        if (ownerDirect)
+            watchpoints.setSchemaId(subscribers.first().wp.schemaId());
+        else
+            watchpoints.setSchemaId(CWPList::newSchemaId());
+    }
+    if (resolved && !rearrangeWatchpoints()) {
+        errorMsg = trUtf8("Unable to rearrange variable list for snapshot lengths.");
         return false;
     }
+    return true;
+}
 
+bool CPLCPrivate::rearrangeWatchpoints()
+{
     // clear pairing
     pairings.clear();
 
-    int maxPDU = 200;
-
     // pairing
     for (int i=0;i<watchpoints.count();i++) {
         // udefined variable
@@ -94,7 +310,9 @@ bool CPLCPrivate::rearrangeWatchpoints()
             for (int j=0;j<pairings.count();j++) {
                 if ((watchpoints.at(i).varea!=pairings.at(j).area) || (watchpoints.at(i).vdb!=pairings.at(j).db)) continue;
 
-                if (pairings[j].sizeWith(watchpoints.at(i)) < maxPDU) {
+                // ranges inside of oversized pairing are read with it
+                int sz = pairings[j].sizeWith(watchpoints.at(i));
+                if ((sz < maxPDU) || (sz == pairings[j].size())) {
                     pairings[j].items << i;
                     pairings[j].calcSize();
                     paired = true;
@@ -126,7 +344,8 @@ void CPLC::plcSetAddress(const QString &Ip, int Rack, int Slot, int Timeout)
 
 void CPLC::plcSetAcqInterval(int Milliseconds)
 {
-    dptr->mainClock->setInterval(Milliseconds);
+    dptr->acqInterval = Milliseconds;
+    dptr->updateScanInterval();
 }
 
 void CPLC::plcConnect()
@@ -156,10 +375,21 @@ void CPLC::plcConnect()
                 dptr->daveConn = daveNewConnection(dptr->daveIntf,0,dptr->rack,dptr->slot);
                 if (dptr->daveConn != NULL) {
                     int res = daveConnectPLC(dptr->daveConn);
-                    if (res == 0) {
+                    QString msg;
+                    if ((res == 0) && dptr->resolveSnapshots(msg)) {
                         dptr->state = splcConnected;
                         emit plcOnConnect();
                         return;
+                    } else if (res == 0) {
+                        daveDisconnectPLC(dptr->daveConn);
+                        daveDisconnectAdapter(dptr->daveIntf);
+                        closeSocket(dptr->fds.rfd);
+                        dptr->daveConn = NULL;
+                        dptr->daveIntf = NULL;
+                        dptr->fds.rfd = 0; dptr->fds.wfd = 0;
+                        emit plcError(msg,true);
+                        emit plcConnectFailed();
+                        return;
                     } else {
                         daveDisconnectPLC(dptr->daveConn);
                         daveDisconnectAdapter(dptr->daveIntf);
@@ -257,7 +487,7 @@ void CPLC::correctToThread()
     dptr->resClock = new QTimer(this);
     dptr->infClock = new QTimer(this);
 
-    dptr->mainClock->setInterval(100);
+    dptr->mainClock->setInterval(dptr->acqInterval);
     dptr->resClock->setInterval(120*60*1000); // 2 min for reset accumulated record errors
     dptr->infClock->setInterval(2000);
 
@@ -290,84 +520,29 @@ void CPLC::plcClock()
         if ((area!=daveDB) && (area!=daveDI))
             db = 0;
 
-        int res = daveReadBytes(dptr->daveConn,area,db,ofs,sz,NULL);
+        // only single large array or snapshot gets its own oversized pairing
+        int res;
+        const uchar* buf;
+        if (sz>maxPDU) {
+            dptr->readBuffer.resize(sz);
+            res = daveReadManyBytes(dptr->daveConn,area,db,ofs,sz,dptr->readBuffer.data());
+            buf = reinterpret_cast<const uchar *>(dptr->readBuffer.constData());
+        } else {
+            res = daveReadBytes(dptr->daveConn,area,db,ofs,sz,NULL);
+            buf = dptr->daveConn->resultPointer;
+        }
         if (res==0) {
             for (int j=0;j<dptr->pairings.at(i).items.count();j++) {
                 int idx = dptr->pairings.at(i).items.at(j);
                 int iofs = dptr->watchpoints.at(idx).offset;
-                CWP::VType t = dptr->watchpoints.at(idx).vtype;
-                if (area==CWP::Counters) {
-                    dptr->watchpoints[idx].data = QVariant(daveGetCounterValueAt(dptr->daveConn,0));
+                if (dptr->watchpoints.at(idx).isArray()) {
+                    dptr->watchpoints[idx].decodeArray(buf+iofs-ofs);
+                } else if (area==CWP::Counters) {
+                    dptr->watchpoints[idx].data = CWPValue(daveGetCounterValueAt(dptr->daveConn,0));
                 } else if (area==CWP::Timers) {
-                    dptr->watchpoints[idx].data = QVariant(daveGetSecondsAt(dptr->daveConn,0));
-                } else {
-                    switch (t) {
-                        case CWP::S7BOOL:
-                            dptr->watchpoints[idx].data = QVariant(((daveGetU8At(dptr->daveConn,iofs-ofs) &
-                                                         (0x01 << dptr->watchpoints.at(idx).bitnum)) > 0));
-                            break;
-                        case CWP::S7BYTE:
-                            dptr->watchpoints[idx].data = QVariant(static_cast<uint>(daveGetU8At(dptr->daveConn,iofs-ofs)));
-                            break;
-                        case CWP::S7WORD:
-                            dptr->watchpoints[idx].data = QVariant(static_cast<uint>(daveGetU16At(dptr->daveConn,iofs-ofs)));
-                            break;
-                        case CWP::S7DWORD:
-                            dptr->watchpoints[idx].data = QVariant(static_cast<uint>(daveGetU32At(dptr->daveConn,iofs-ofs)));
-                            break;
-                        case CWP::S7INT:
-                            dptr->watchpoints[idx].data = QVariant(daveGetS16At(dptr->daveConn,iofs-ofs));
-                            break;
-                        case CWP::S7DINT:
-                            dptr->watchpoints[idx].data = QVariant(daveGetS32At(dptr->daveConn,iofs-ofs));
-                            break;
-                        case CWP::S7REAL:
-                            dptr->watchpoints[idx].data = QVariant(static_cast<double>(daveGetFloatAt(dptr->daveConn,iofs-ofs)));
-                            break;
-                        case CWP::S7TIME:
-                            if (true) {
-                                QTime t = QTime(0,0,0);
-                                int tm = daveGetS32At(dptr->daveConn,iofs-ofs);
-                                t = t.addMSecs(abs(tm));
-                                dptr->watchpoints[idx].data = QVariant(t);
-                                dptr->watchpoints[idx].dataSign = (tm>=0);
-                            }
-                            break;
-                        case CWP::S7DATE:
-                            if (true) {
-                                QDate d = QDate(1990,1,1);
-                                d = d.addDays(static_cast<uint>(daveGetU16At(dptr->daveConn,iofs-ofs)));
-                                dptr->watchpoints[idx].data = QVariant(d);
-                            }
-                            break;
-                        case CWP::S7S5TIME:
-                            if (true) {
-                                uint s5 = static_cast<uint>(daveGetU16At(dptr->daveConn,iofs-ofs));
-                                uint s5mode = (s5 >> 12) & 0x03;
-                                s5 = s5 & 0x0fff;
-                                uint mult;
-                                if (s5mode == 0) mult=10;
-                                else if (s5mode == 1) mult=100;
-                                else if (s5mode == 2) mult=1000;
-                                else mult = 10000;
-                                uint msecs = ((s5 >> 8) & 0x0f)*100 + ((s5 >> 4) & 0x0f)*10 + (s5 & 0x0f);
-                                QTime t = QTime(0,0,0,0);
-                                t = t.addMSecs(static_cast<int>(msecs*mult));
-                                dptr->watchpoints[idx].data = QVariant(t);
-                            }
-                            break;
-                        case CWP::S7TIME_OF_DAY:
-                            if (true) {
-                                QTime t = QTime();
-                                t = t.addMSecs(static_cast<int>(daveGetU32At(dptr->daveConn,iofs-ofs)));
-                                dptr->watchpoints[idx].data = QVariant(t);
-                            }
-                            break;
-                        default:
-                            dptr->watchpoints[idx].data = QVariant();
-                            break;
-                    }
-                }
+                    dptr->watchpoints[idx].data = CWPValue(static_cast<double>(daveGetSecondsAt(dptr->daveConn,0)));
+                } else
+                    dptr->watchpoints[idx].decodeValue(buf+iofs-ofs);
             }
         } else {
             if (dptr->tmMaxRecErrorCount>0) {
@@ -383,7 +558,7 @@ void CPLC::plcClock()
                 dptr->recErrorsCount = 0;
         }
     }
-    emit plcVariablesUpdatedConsistent(dptr->watchpoints,tms);
+    dptr->fanOut(tms);
     emit plcVariablesUpdated();
     dptr->clockInterlock.unlock();
 }
@@ -401,6 +576,331 @@ void CPLC::infClock()
         emit plcScanTime(trUtf8("- ms"));
 }
 
+static QAtomicInt schemaCounter(0);
+
+CWPValue::CWPValue()
+{
+    val.u = 0;
+    vkind = vkNull;
+}
+
+CWPValue::CWPValue(bool v)
+{
+    val.i = v ? 1 : 0;
+    vkind = vkBool;
+}
+
+CWPValue::CWPValue(int v)
+{
+    val.i = v;
+    vkind = vkInt;
+}
+
+CWPValue::CWPValue(uint v)
+{
+    val.u = v;
+    vkind = vkUInt;
+}
+
+CWPValue::CWPValue(double v)
+{
+    val.d = v;
+    vkind = vkDouble;
+}
+
+CWPValue::CWPValue(const QTime &v)
+{
+    val.i = v.isValid() ? QTime(0,0).msecsTo(v) : -1;
+    vkind = vkTime;
+}
+
+CWPValue::CWPValue(const QDate &v)
+{
+    val.i = v.toJulianDay();
+    vkind = vkDate;
+}
+
+CWPValue::CWPValue(const QByteArray &v)
+{
+    new (val.ba) QByteArray(v);
+    vkind = vkBytes;
+}
+
+CWPValue::CWPValue(const CWPValue &other)
+{
+    vkind = other.vkind;
+    if (vkind==vkBytes)
+        new (val.ba) QByteArray(*reinterpret_cast<const QByteArray *>(other.val.ba));
+    else
+        val.u = other.val.u;
+}
+
+CWPValue::~CWPValue()
+{
+    clearBytes();
+}
+
+void CWPValue::clearBytes()
+{
+    if (vkind==vkBytes)
+        reinterpret_cast<QByteArray *>(val.ba)->~QByteArray();
+    vkind = vkNull;
+    val.u = 0;
+}
+
+CWPValue &CWPValue::operator =(const CWPValue &other)
+{
+    if (this==&other) return *this;
+    if ((vkind==vkBytes) && (other.vkind==vkBytes)) {
+        *reinterpret_cast<QByteArray *>(val.ba) = *reinterpret_cast<const QByteArray *>(other.val.ba);
+        return *this;
+    }
+    clearBytes();
+    vkind = other.vkind;
+    if (vkind==vkBytes)
+        new (val.ba) QByteArray(*reinterpret_cast<const QByteArray *>(other.val.ba));
+    else
+        val.u = other.val.u;
+    return *this;
+}
+
+bool CWPValue::operator ==(const CWPValue &ref) const
+{
+    if (vkind!=ref.vkind) return false;
+    switch (vkind) {
+        case vkNull:
+            return true;
+        case vkDouble:
+            return (val.d==ref.val.d);
+        case vkBytes:
+            return (*reinterpret_cast<const QByteArray *>(val.ba)==*reinterpret_cast<const QByteArray *>(ref.val.ba));
+        default:
+            return (val.u==ref.val.u);
+    }
+}
+
+bool CWPValue::operator !=(const CWPValue &ref) const
+{
+    return !operator==(ref);
+}
+
+CWPValue::ValueKind CWPValue::kind() const
+{
+    return static_cast<ValueKind>(vkind);
+}
+
+bool CWPValue::isValid() const
+{
+    return (vkind!=vkNull);
+}
+
+bool CWPValue::isNull() const
+{
+    switch (vkind) {
+        case vkNull:
+            return true;
+        case vkTime:
+            return (val.i<0);
+        case vkDate:
+            return !toDate().isValid();
+        case vkBytes:
+            return reinterpret_cast<const QByteArray *>(val.ba)->isNull();
+        default:
+            return false;
+    }
+}
+
+bool CWPValue::toBool() const
+{
+    switch (vkind) {
+        case vkBool:
+        case vkInt:
+        case vkUInt:
+            return (val.u!=0);
+        case vkDouble:
+            return (val.d!=0.0);
+        default:
+            return false;
+    }
+}
+
+int CWPValue::toInt() const
+{
+    switch (vkind) {
+        case vkBool:
+        case vkInt:
+        case vkUInt:
+            return static_cast<int>(val.i);
+        case vkDouble:
+            return qRound(val.d);
+        default:
+            return 0;
+    }
+}
+
+uint CWPValue::toUInt() const
+{
+    switch (vkind) {
+        case vkBool:
+        case vkInt:
+        case vkUInt:
+            return static_cast<uint>(val.u);
+        case vkDouble:
+            return static_cast<uint>(qRound64(val.d));
+        default:
+            return 0;
+    }
+}
+
+double CWPValue::toDouble() const
+{
+    switch (vkind) {
+        case vkBool:
+        case vkInt:
+            return static_cast<double>(val.i);
+        case vkUInt:
+            return static_cast<double>(val.u);
+        case vkDouble:
+            return val.d;
+        default:
+            return 0.0;
+    }
+}
+
+QTime CWPValue::toTime() const
+{
+    if ((vkind!=vkTime) || (val.i<0)) return QTime();
+    return QTime(0,0).addMSecs(static_cast<int>(val.i));
+}
+
+QDate CWPValue::toDate() const
+{
+    if (vkind!=vkDate) return QDate();
+    return QDate::fromJulianDay(val.i);
+}
+
+QByteArray CWPValue::toByteArray() const
+{
+    if (vkind!=vkBytes) return QByteArray();
+    return *reinterpret_cast<const QByteArray *>(val.ba);
+}
+
+QString CWPValue::toString() const
+{
+    switch (vkind) {
+        case vkBool:
+            return (val.i!=0) ? QString("true") : QString("false");
+        case vkInt:
+            return QString::number(val.i);
+        case vkUInt:
+            return QString::number(val.u);
+        case vkDouble:
+            return QString::number(val.d,'g',6);
+        case vkTime:
+            return toTime().toString(Qt::ISODate);
+        case vkDate:
+            return toDate().toString(Qt::ISODate);
+        case vkBytes:
+            return QString::fromLatin1(toByteArray());
+        default:
+            return QString();
+    }
+}
+
+QVariant CWPValue::toVariant() const
+{
+    switch (vkind) {
+        case vkBool:    return QVariant(val.i!=0);
+        case vkInt:     return QVariant(static_cast<int>(val.i));
+        case vkUInt:    return QVariant(static_cast<uint>(val.u));
+        case vkDouble:  return QVariant(val.d);
+        case vkTime:    return QVariant(toTime());
+        case vkDate:    return QVariant(toDate());
+        case vkBytes:   return QVariant(toByteArray());
+        default:        return QVariant();
+    }
+}
+
+CWPValue CWPValue::fromVariant(const QVariant &v)
+{
+    switch (v.userType()) {
+        case QMetaType::Bool:
+            return CWPValue(v.toBool());
+        case QMetaType::Int:
+        case QMetaType::Short:
+        case QMetaType::LongLong:
+            return CWPValue(v.toInt());
+        case QMetaType::UInt:
+        case QMetaType::UShort:
+        case QMetaType::UChar:
+        case QMetaType::ULongLong:
+            return CWPValue(v.toUInt());
+        case QMetaType::Double:
+        case QMetaType::Float:
+            return CWPValue(v.toDouble());
+        case QMetaType::QTime:
+            return CWPValue(v.toTime());
+        case QMetaType::QDate:
+            return CWPValue(v.toDate());
+        case QMetaType::QByteArray:
+            return CWPValue(v.toByteArray());
+        default:
+            return CWPValue();
+    }
+}
+
+CWPList::CWPList() :
+    QList<CWP>()
+{
+    schema = 0;
+}
+
+CWPList::CWPList(const QList<CWP> &other) :
+    QList<CWP>(other)
+{
+    schema = 0;
+}
+
+int CWPList::schemaId() const
+{
+    return schema;
+}
+
+void CWPList::setSchemaId(int id)
+{
+    schema = id;
+}
+
+int CWPList::newSchemaId()
+{
+    return schemaCounter.fetchAndAddRelaxed(1)+1;
+}
+
+bool CWPList::operator ==(const CWPList &ref) const
+{
+    // same nonzero id - same watchpoints, otherwise compare by uuid
+    if ((schema!=0) && (schema==ref.schema)) return true;
+    return (static_cast<const QList<CWP> &>(*this)==static_cast<const QList<CWP> &>(ref));
+}
+
+bool CWPList::operator !=(const CWPList &ref) const
+{
+    return !operator==(ref);
+}
+
+QDataStream &operator <<(QDataStream &out, const CWPList &obj)
+{
+    out << static_cast<const QList<CWP> &>(obj);
+    return out;
+}
+
+QDataStream &operator >>(QDataStream &in, CWPList &obj)
+{
+    in >> static_cast<QList<CWP> &>(obj);
+    obj.setSchemaId(0);
+    return in;
+}
+
 CWP::CWP()
 {
     label = QString();
@@ -409,12 +909,13 @@ CWP::CWP()
     vdb = -1;
     offset = -1;
     bitnum = -1;
-    data = QVariant();
+    count = 1;
+    data = CWPValue();
     dataSign = true;
     uuid = QUuid::createUuid();
 }
 
-CWP::CWP(QString aLabel, CWP::VArea aArea, VType aType, int aVdb, int aOffset, int aBitnum)
+CWP::CWP(QString aLabel, CWP::VArea aArea, VType aType, int aVdb, int aOffset, int aBitnum, int aCount)
 {
     label = aLabel;
     varea = aArea;
@@ -422,7 +923,8 @@ CWP::CWP(QString aLabel, CWP::VArea aArea, VType aType, int aVdb, int aOffset, i
     vdb = aVdb;
     offset = aOffset;
     bitnum = aBitnum;
-    data = QVariant();
+    count = aCount;
+    data = CWPValue();
     dataSign = true;
     uuid = QUuid::createUuid();
 }
@@ -435,6 +937,7 @@ CWP &CWP::operator =(const CWP &other)
     vdb = other.vdb;
     offset = other.offset;
     bitnum = other.bitnum;
+    count = other.count;
     data = other.data;
     dataSign = other.dataSign;
     uuid = other.uuid;
@@ -451,9 +954,23 @@ bool CWP::operator !=(const CWP &ref) const
     return (uuid!=ref.uuid);
 }
 
+QUuid CWP::getUuid() const
+{
+    return uuid;
+}
+
 int CWP::size()
 {
     if ((varea==Counters) || (varea==Timers)) return 2;
+    if (vtype==S7SNAPSHOT) // whole DB length is unknown until connect
+        return (offset<0) ? 0 : qMax(count,0);
+    if ((vtype==S7BOOL) && isArray())
+        return (qMax(bitnum,0)+count+7)/8;
+    return elementSize()*qMax(count,1);
+}
+
+int CWP::elementSize() const
+{
     switch (vtype) {
         case S7BOOL:
         case S7BYTE:
@@ -474,6 +991,199 @@ int CWP::size()
     }
 }
 
+bool CWP::isArray() const
+{
+    return (count>1) && (vtype!=S7SNAPSHOT);
+}
+
+bool CWP::isSnapshot() const
+{
+    return (vtype==S7SNAPSHOT);
+}
+
+static void swapCopy16(const uchar* src, quint16* dst, int n)
+{
+    for (int i=0;i<n;i++)
+        dst[i] = static_cast<quint16>((src[2*i] << 8) | src[2*i+1]);
+}
+
+static void swapCopy32(const uchar* src, quint32* dst, int n)
+{
+    for (int i=0;i<n;i++)
+        dst[i] = (static_cast<quint32>(src[4*i]) << 24) | (static_cast<quint32>(src[4*i+1]) << 16) |
+                 (static_cast<quint32>(src[4*i+2]) << 8) | static_cast<quint32>(src[4*i+3]);
+}
+
+void CWP::decodeArray(const uchar *src)
+{
+    // whole array in one pass from big-endian PLC buffer to packed native vector,
+    // swap loops are vectorized with -ftree-vectorize from project file
+    int esz = elementSize();
+    if (esz==0) {
+        data = CWPValue();
+        return;
+    }
+    QByteArray ba(esz*count,Qt::Uninitialized);
+    uchar* dst = reinterpret_cast<uchar *>(ba.data());
+    if (vtype==S7BOOL) {
+        int bit0 = qMax(bitnum,0);
+        for (int i=0;i<count;i++)
+            dst[i] = (src[(bit0+i) >> 3] >> ((bit0+i) & 7)) & 0x01;
+    } else if (esz==1)
+        memcpy(dst,src,static_cast<size_t>(count));
+    else if (esz==2)
+        swapCopy16(src,reinterpret_cast<quint16 *>(dst),count);
+    else
+        swapCopy32(src,reinterpret_cast<quint32 *>(dst),count);
+    data = CWPValue(ba);
+}
+
+void CWP::decodeValue(const uchar *src)
+{
+    // scalar or snapshot from big-endian PLC buffer, timers and counters are decoded by libnodave
+    switch (vtype) {
+        case S7BOOL:
+            data = CWPValue(((src[0] & (0x01 << bitnum)) > 0));
+            break;
+        case S7BYTE:
+            data = CWPValue(static_cast<uint>(src[0]));
+            break;
+        case S7WORD:
+            data = CWPValue(static_cast<uint>(qFromBigEndian<quint16>(src)));
+            break;
+        case S7DWORD:
+            data = CWPValue(static_cast<uint>(qFromBigEndian<quint32>(src)));
+            break;
+        case S7INT:
+            data = CWPValue(static_cast<int>(static_cast<qint16>(qFromBigEndian<quint16>(src))));
+            break;
+        case S7DINT:
+            data = CWPValue(static_cast<int>(static_cast<qint32>(qFromBigEndian<quint32>(src))));
+            break;
+        case S7REAL:
+            if (true) {
+                quint32 u32 = qFromBigEndian<quint32>(src);
+                float f;
+                memcpy(&f,&u32,sizeof(f));
+                data = CWPValue(static_cast<double>(f));
+            }
+            break;
+        case S7TIME:
+            if (true) {
+                QTime t = QTime(0,0,0);
+                int tm = static_cast<qint32>(qFromBigEndian<quint32>(src));
+                t = t.addMSecs(abs(tm));
+                data = CWPValue(t);
+                dataSign = (tm>=0);
+            }
+            break;
+        case S7DATE:
+            if (true) {
+                QDate d = QDate(1990,1,1);
+                d = d.addDays(qFromBigEndian<quint16>(src));
+                data = CWPValue(d);
+            }
+            break;
+        case S7S5TIME:
+            if (true) {
+                uint s5 = qFromBigEndian<quint16>(src);
+                uint s5mode = (s5 >> 12) & 0x03;
+                s5 = s5 & 0x0fff;
+                uint mult;
+                if (s5mode == 0) mult=10;
+                else if (s5mode == 1) mult=100;
+                else if (s5mode == 2) mult=1000;
+                else mult = 10000;
+                uint msecs = ((s5 >> 8) & 0x0f)*100 + ((s5 >> 4) & 0x0f)*10 + (s5 & 0x0f);
+                QTime t = QTime(0,0,0,0);
+                t = t.addMSecs(static_cast<int>(msecs*mult));
+                data = CWPValue(t);
+            }
+            break;
+        case S7TIME_OF_DAY:
+            if (true) {
+                QTime t = QTime();
+                t = t.addMSecs(static_cast<int>(qFromBigEndian<quint32>(src)));
+                data = CWPValue(t);
+            }
+            break;
+        case S7SNAPSHOT:
+            data = CWPValue(QByteArray(reinterpret_cast<const char *>(src),size()));
+            break;
+        default:
+            data = CWPValue();
+            break;
+    }
+}
+
+static double arrayElement(const char* p, CWP::VType vtype)
+{
+    quint16 u16;
+    qint16 s16;
+    quint32 u32;
+    qint32 s32;
+    float f;
+    switch (vtype) {
+        case CWP::S7BOOL:
+        case CWP::S7BYTE:
+            return static_cast<uchar>(*p);
+        case CWP::S7INT:
+            memcpy(&s16,p,sizeof(s16));
+            return s16;
+        case CWP::S7WORD:
+        case CWP::S7S5TIME:
+        case CWP::S7DATE:
+            memcpy(&u16,p,sizeof(u16));
+            return u16;
+        case CWP::S7DINT:
+        case CWP::S7TIME:
+            memcpy(&s32,p,sizeof(s32));
+            return s32;
+        case CWP::S7REAL:
+            memcpy(&f,p,sizeof(f));
+            return static_cast<double>(f);
+        case CWP::S7DWORD:
+        case CWP::S7TIME_OF_DAY:
+            memcpy(&u32,p,sizeof(u32));
+            return u32;
+        default:
+            return qQNaN();
+    }
+}
+
+double CWP::arrayValue(int idx) const
+{
+    const QByteArray ba = data.toByteArray();
+    int esz = elementSize();
+    if ((idx<0) || (idx>=count) || (esz==0) || (ba.size()<(idx+1)*esz)) return qQNaN();
+    return arrayElement(ba.constData()+idx*esz,vtype);
+}
+
+QVector<double> CWP::arrayValues() const
+{
+    QVector<double> res;
+    const QByteArray ba = data.toByteArray();
+    int esz = elementSize();
+    if ((esz==0) || (ba.size()<count*esz)) return res;
+    res.resize(count);
+    const char* p = ba.constData();
+    for (int i=0;i<count;i++)
+        res[i] = arrayElement(p+i*esz,vtype);
+    return res;
+}
+
+
+CPLCSubscriber::CPLCSubscriber()
+{
+    id = 0;
+    wp.clear();
+    map.clear();
+    interval = 0;
+    lastSent = -1;
+    inFlight = false;
+    conflated = false;
+    latest.clear();
+}
 
 CPairing::CPairing()
 {
@@ -566,7 +1276,7 @@ void CPairing::calcSize()
     int stop1 = ofs + sz;
     for (int i=0;i<cnt;i++) {
         int start2 = wlist->at(items.at(i)).offset;
-        int stop2 = (*wlist)[i].size() + start2;
+        int stop2 = (*wlist)[items.at(i)].size() + start2;
         if (start1 == -1) {
             start1 = start2;
             stop1 = stop2;
@@ -581,17 +1291,21 @@ void CPairing::calcSize()
 
 QDataStream &operator <<(QDataStream &out, const CWP &obj)
 {
+    // array length is packed into type field, scalar records stay compatible with older files
     int a = static_cast<int>(obj.varea);
-    int b = static_cast<int>(obj.vtype);
-    out << obj.uuid << a << b <<  obj.vdb << obj.offset << obj.bitnum << obj.label << obj.data << obj.dataSign;
+    int b = static_cast<int>(obj.vtype) | ((qMax(obj.count,1)-1) << 8);
+    out << obj.uuid << a << b <<  obj.vdb << obj.offset << obj.bitnum << obj.label << obj.data.toVariant() << obj.dataSign;
     return out;
 }
 
 QDataStream &operator >>(QDataStream &in, CWP &obj)
 {
     int a,b;
-    in >> obj.uuid >> a >> b >> obj.vdb >> obj.offset >> obj.bitnum >> obj.label >> obj.data >> obj.dataSign;
+    QVariant data;
+    in >> obj.uuid >> a >> b >> obj.vdb >> obj.offset >> obj.bitnum >> obj.label >> data >> obj.dataSign;
+    obj.data = CWPValue::fromVariant(data);
     obj.varea = static_cast<CWP::VArea>(a);
-    obj.vtype = static_cast<CWP::VType>(b);
+    obj.vtype = static_cast<CWP::VType>(b & 0xff);
+    obj.count = (b >> 8) + 1;
     return in;
 }
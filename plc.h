@@ -8,9 +8,70 @@
 #include <QUuid>
 #include <QList>
 #include <QTime>
+#include <QVector>
+#include <QDate>
+#include <QDateTime>
+#include <QByteArray>
 
 class CVarModel;
 
+// Compact tagged value of watchpoint, replaces QVariant in acquisition and plot paths.
+// Byte arrays (arrays, snapshots) are kept in place as implicitly shared QByteArray.
+class CWPValue
+{
+public:
+    enum ValueKind {
+        vkNull,
+        vkBool,
+        vkInt,
+        vkUInt,
+        vkDouble,
+        vkTime, // msecs since midnight, -1 for invalid time
+        vkDate, // julian day
+        vkBytes
+    };
+    CWPValue();
+    explicit CWPValue(bool v);
+    explicit CWPValue(int v);
+    explicit CWPValue(uint v);
+    explicit CWPValue(double v);
+    explicit CWPValue(const QTime& v);
+    explicit CWPValue(const QDate& v);
+    explicit CWPValue(const QByteArray& v);
+    CWPValue(const CWPValue& other);
+    ~CWPValue();
+    CWPValue &operator=(const CWPValue& other);
+    bool operator==(const CWPValue& ref) const;
+    bool operator!=(const CWPValue& ref) const;
+
+    ValueKind kind() const;
+    bool isValid() const;
+    bool isNull() const;
+    bool toBool() const;
+    int toInt() const;
+    uint toUInt() const;
+    double toDouble() const;
+    QTime toTime() const;
+    QDate toDate() const;
+    QByteArray toByteArray() const;
+    QString toString() const;
+
+    // QDataStream format of watchpoints stays QVariant based
+    QVariant toVariant() const;
+    static CWPValue fromVariant(const QVariant& v);
+
+private:
+    union {
+        qint64 i;
+        quint64 u;
+        double d;
+        char ba[sizeof(QByteArray)];
+    } val;
+    quint8 vkind;
+
+    void clearBytes();
+};
+
 class CWP
 {
     friend QDataStream &operator<<(QDataStream &out, const CWP &obj);
@@ -39,7 +100,8 @@ public:
         S7TIME,
         S7DATE,
         S7S5TIME,
-        S7TIME_OF_DAY
+        S7TIME_OF_DAY,
+        S7SNAPSHOT // raw image of whole DB or byte range, count is length in bytes
     };
 
     QString label;
@@ -48,19 +110,45 @@ public:
     int vdb;
     int offset;
     int bitnum;
-    QVariant data;
+    int count; // array elements, 1 for scalar
+    CWPValue data; // arrays: packed native-endian element vector, snapshots: raw PLC bytes
     bool dataSign;
     CWP();
-    CWP(QString aLabel, VArea aArea, VType aType, int aVdb, int aOffset, int aBitnum);
+    CWP(QString aLabel, VArea aArea, VType aType, int aVdb, int aOffset, int aBitnum, int aCount = 1);
     CWP &operator=(const CWP& other);
     bool operator==(const CWP& ref) const;
     bool operator!=(const CWP& ref) const;
     int size();
+    int elementSize() const;
+    bool isArray() const;
+    double arrayValue(int idx) const;
+    QVector<double> arrayValues() const;
+    void decodeArray(const uchar* src);
+    void decodeValue(const uchar* src);
+    bool isSnapshot() const;
+    QUuid getUuid() const;
 private:
     QUuid uuid;
 };
 
-typedef QList<CWP> CWPList;
+// Scan of watchpoints. Schema id is assigned by acquisition to its watchpoint list,
+// copies of same list compare equal by id without walking uuids.
+class CWPList : public QList<CWP>
+{
+public:
+    CWPList();
+    CWPList(const QList<CWP>& other);
+    int schemaId() const;
+    void setSchemaId(int id);
+    static int newSchemaId();
+    bool operator==(const CWPList& ref) const;
+    bool operator!=(const CWPList& ref) const;
+private:
+    int schema; // 0 for unknown schema
+};
+
+QDataStream &operator<<(QDataStream &out, const CWPList &obj);
+QDataStream &operator>>(QDataStream &in, CWPList &obj);
 
 class CPairing {
 public:
@@ -83,6 +171,7 @@ private:
 };
 
 class CPLCPrivate;
+class CSampleBus;
 
 class CPLC : public QObject
 {
@@ -96,6 +185,9 @@ public:
     explicit CPLC(QObject *parent = NULL);
     virtual ~CPLC();
 
+    // scans are delivered to consumers through bounded ring, see CSampleReader
+    CSampleBus* sampleBus() const;
+
 private:
     CPLCPrivate* dptr;
 
@@ -108,8 +200,9 @@ signals:
     void plcOnStart();
     void plcOnStop();
     void plcVariablesUpdated();
-    void plcVariablesUpdatedConsistent(const CWPList& aWatchpoints, const QDateTime& tm);
     void plcScanTime(const QString& msg);
+    void plcSubscriptionData(int id, const CWPList& wp, const QDateTime& time);
+    void plcSubscriptionFailed(int id, const QString& msg);
     
 public slots:
     void plcSetAddress(const QString& Ip, int Rack, int Slot, int Timeout = 5000000);
@@ -120,6 +213,13 @@ public slots:
     void plcStart();
     void plcStop();
     void plcDisconnect();
+    // Broker clients share this connection: their lists are merged with own list into
+    // one read plan, scan runs at fastest requested interval, each client gets its
+    // own list at its own interval with plcSubscriptionData. Next frame for client is
+    // sent after plcSubscriptionConsumed, frames of slow clients are conflated.
+    void plcSubscribe(int id, const CWPList& aWatchpoints, int interval);
+    void plcUnsubscribe(int id);
+    void plcSubscriptionConsumed(int id);
     void correctToThread();
 
 private slots:
@@ -7,12 +7,31 @@
 #include <QTimer>
 #include "global.h"
 #include "plc.h"
+#include "samplebus.h"
 
 extern "C" {
 #include "libnodave/nodave.h"
 #include "libnodave/openSocket.h"
 }
 
+// Watchlist of one consumer of shared acquisition. Id 0 is list of connection owner,
+// delivered to sample bus, others are broker clients.
+class CPLCSubscriber
+{
+public:
+    int id;
+    CWPList wp;
+    QVector<int> map; // index of each variable in read plan
+    int interval; // ms, 0 for every scan
+    qint64 lastSent;
+    bool inFlight; // frame queued to client, not consumed yet
+    bool conflated; // latest frame waits until client consumes previous one
+    CWPList latest;
+    QDateTime time;
+
+    CPLCSubscriber();
+};
+
 class CPLCPrivate : public QObject
 {
     Q_OBJECT
@@ -43,14 +62,24 @@ public:
     int tmMaxConnectRetryCount;
     int tmWaitReconnect;
 
-    CWPList watchpoints;
+    CWPList watchpoints; // read plan, union of subscriber lists
+    QList<CPLCSubscriber> subscribers;
+    bool ownerDirect; // read plan is owner list, published on every scan
+    int acqInterval;
 
     QList<CPairing> pairings;
+    QByteArray readBuffer; // oversized array requests
+    CSampleBus* bus;
 
-    CPLCPrivate(CPLC* q) : QObject(q), qptr(q) { }
-    virtual ~CPLCPrivate() { }
+    CPLCPrivate(CPLC* q) : QObject(q), qptr(q), bus(new CSampleBus()) { }
+    virtual ~CPLCPrivate() { delete bus; }
 
     bool rearrangeWatchpoints();
+    bool resolveSnapshots(QString &errorMsg);
+    bool buildReadPlan(QString &errorMsg);
+    void updateScanInterval();
+    CWPList subscriberFrame(const CPLCSubscriber& s) const;
+    void fanOut(const QDateTime& tms);
 };
 
 #endif // PLC_P_H
@@ -0,0 +1,201 @@
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "plclive.h"
+
+#define PLCLIVE_RETRIES 64
+
+struct plclive_reader {
+    const unsigned char* base;
+    size_t size;
+    const plclive_header* hdr;
+};
+
+static uint32_t load32(const uint32_t* p)
+{
+    return __atomic_load_n(p,__ATOMIC_ACQUIRE);
+}
+
+static uint64_t load64(const uint64_t* p)
+{
+    return __atomic_load_n(p,__ATOMIC_ACQUIRE);
+}
+
+static int validHeader(const plclive_header* hdr, size_t size)
+{
+    uint64_t schemaEnd, ringEnd;
+
+    if (load32(&hdr->magic)!=PLCLIVE_MAGIC) return 0;
+    if (hdr->version!=PLCLIVE_VERSION) return 0;
+    if (hdr->segment_size>size) return 0;
+    if ((hdr->depth==0) || ((hdr->depth & (hdr->depth-1))!=0)) return 0;
+    if (hdr->frame_size<(sizeof(plclive_slot)+(uint64_t)hdr->capacity*sizeof(double))) return 0;
+
+    schemaEnd = (uint64_t)hdr->schema_offset+(uint64_t)hdr->capacity*sizeof(plclive_channel);
+    ringEnd = (uint64_t)hdr->ring_offset+(uint64_t)hdr->depth*hdr->frame_size;
+    if ((hdr->schema_offset<sizeof(plclive_header)) || (schemaEnd>hdr->ring_offset)) return 0;
+    if (ringEnd>hdr->segment_size) return 0;
+    return 1;
+}
+
+plclive_reader* plclive_open(const char* name)
+{
+    char path[256];
+    struct stat st;
+    plclive_reader* reader;
+    void* p;
+    int fd;
+
+    if ((name==NULL) || (name[0]==0)) return NULL;
+    snprintf(path,sizeof(path),"%s%s",(name[0]=='/') ? "" : "/",name);
+
+    fd = shm_open(path,O_RDONLY,0);
+    if (fd<0) return NULL;
+    if ((fstat(fd,&st)!=0) || (st.st_size<(off_t)sizeof(plclive_header))) {
+        close(fd);
+        return NULL;
+    }
+    p = mmap(NULL,(size_t)st.st_size,PROT_READ,MAP_SHARED,fd,0);
+    close(fd);
+    if (p==MAP_FAILED) return NULL;
+
+    /* writer sets magic last, partially initialized segment is rejected */
+    if (!validHeader((const plclive_header*)p,(size_t)st.st_size)) {
+        munmap(p,(size_t)st.st_size);
+        return NULL;
+    }
+
+    reader = (plclive_reader*)malloc(sizeof(plclive_reader));
+    if (reader==NULL) {
+        munmap(p,(size_t)st.st_size);
+        return NULL;
+    }
+    reader->base = (const unsigned char*)p;
+    reader->size = (size_t)st.st_size;
+    reader->hdr = (const plclive_header*)p;
+    return reader;
+}
+
+void plclive_close(plclive_reader* reader)
+{
+    if (reader==NULL) return;
+    munmap((void*)reader->base,reader->size);
+    free(reader);
+}
+
+int plclive_is_stale(const plclive_reader* reader)
+{
+    if (reader==NULL) return 1;
+    return (load32(&reader->hdr->stale)!=0);
+}
+
+int plclive_writer_pid(const plclive_reader* reader)
+{
+    if (reader==NULL) return 0;
+    return reader->hdr->writer_pid;
+}
+
+uint32_t plclive_depth(const plclive_reader* reader)
+{
+    if (reader==NULL) return 0;
+    return reader->hdr->depth;
+}
+
+uint64_t plclive_head(const plclive_reader* reader)
+{
+    if (reader==NULL) return 0;
+    return load64(&reader->hdr->head);
+}
+
+int plclive_schema(const plclive_reader* reader, uint32_t* schema_id,
+                   plclive_channel* channels, int max_channels)
+{
+    const plclive_header* hdr;
+    uint32_t s1, s2, cnt, id;
+    int i, n;
+
+    if ((reader==NULL) || (max_channels<0)) return PLCLIVE_ERROR;
+    hdr = reader->hdr;
+    for (i=0;i<PLCLIVE_RETRIES;i++) {
+        if (load32(&hdr->stale)!=0) return PLCLIVE_STALE;
+        s1 = load32(&hdr->schema_seq);
+        if ((s1 & 1)!=0) continue;
+
+        cnt = hdr->channel_count;
+        if (cnt>hdr->capacity) cnt = hdr->capacity;
+        id = hdr->schema_id;
+        n = ((int)cnt<max_channels) ? (int)cnt : max_channels;
+        if ((channels!=NULL) && (n>0))
+            memcpy(channels,reader->base+hdr->schema_offset,(size_t)n*sizeof(plclive_channel));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&hdr->schema_seq,__ATOMIC_RELAXED);
+        if (s1==s2) {
+            if (schema_id!=NULL)
+                *schema_id = id;
+            return (int)cnt;
+        }
+    }
+    return PLCLIVE_BUSY;
+}
+
+int plclive_read(const plclive_reader* reader, uint64_t frame, plclive_frame* info,
+                 double* values, int max_values)
+{
+    const plclive_header* hdr;
+    const plclive_slot* slot;
+    uint64_t head, want, s1, s2;
+    uint32_t cnt;
+    int n;
+
+    if ((reader==NULL) || (max_values<0)) return PLCLIVE_ERROR;
+    hdr = reader->hdr;
+    if (load32(&hdr->stale)!=0) return PLCLIVE_STALE;
+
+    head = load64(&hdr->head);
+    if (frame>=head) return PLCLIVE_NODATA;
+    if ((head-frame)>hdr->depth) return PLCLIVE_OVERWRITTEN;
+
+    slot = (const plclive_slot*)(reader->base+hdr->ring_offset+
+                                 (size_t)(frame & (hdr->depth-1))*hdr->frame_size);
+    want = 2*frame+2;
+    s1 = load64(&slot->seq);
+    if (s1!=want) return PLCLIVE_OVERWRITTEN; /* head is advanced after slot is complete */
+
+    cnt = slot->channel_count;
+    if (cnt>hdr->capacity) cnt = hdr->capacity;
+    n = ((int)cnt<max_values) ? (int)cnt : max_values;
+    if (info!=NULL) {
+        info->frame = frame;
+        info->timestamp = slot->timestamp;
+        info->schema_id = slot->schema_id;
+        info->channel_count = cnt;
+    }
+    if ((values!=NULL) && (n>0))
+        memcpy(values,(const unsigned char*)slot+sizeof(plclive_slot),(size_t)n*sizeof(double));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    s2 = __atomic_load_n(&slot->seq,__ATOMIC_RELAXED);
+    if (s1!=s2) return PLCLIVE_OVERWRITTEN;
+    return (int)cnt;
+}
+
+int plclive_latest(const plclive_reader* reader, plclive_frame* info,
+                   double* values, int max_values)
+{
+    uint64_t head;
+    int i, res;
+
+    if (reader==NULL) return PLCLIVE_ERROR;
+    for (i=0;i<PLCLIVE_RETRIES;i++) {
+        head = plclive_head(reader);
+        if (head==0) return (plclive_is_stale(reader) ? PLCLIVE_STALE : PLCLIVE_NODATA);
+        res = plclive_read(reader,head-1,info,values,max_values);
+        if (res!=PLCLIVE_OVERWRITTEN) return res;
+    }
+    return PLCLIVE_BUSY;
+}
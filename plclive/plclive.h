@@ -0,0 +1,103 @@
+/*
+ * plclive - reader for live data segment of PLC recorder.
+ *
+ * Recorder publishes every scan into POSIX shared memory segment (shm_open name,
+ * "/plcrecorder" by default). Segment is mapped read-only, reading does not involve
+ * recorder threads or PLC connection. Plain C, link plclive.c into consumer.
+ *
+ * Layout: header, schema block of capacity channel entries, ring of depth frame slots.
+ * Schema and each slot are protected by sequence counters (seqlock): odd while
+ * writer is updating, reader retries when counter changes during copy.
+ */
+
+#ifndef PLCLIVE_H
+#define PLCLIVE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PLCLIVE_MAGIC 0x564c5250u /* "PRLV" */
+#define PLCLIVE_VERSION 1
+#define PLCLIVE_LABEL_SIZE 64
+#define PLCLIVE_ADDR_SIZE 32
+
+typedef struct plclive_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t segment_size;
+    uint32_t capacity;      /* max channels in schema and frames */
+    uint32_t depth;         /* frames in history ring, power of two */
+    uint32_t frame_size;    /* bytes per ring slot */
+    uint32_t schema_offset;
+    uint32_t ring_offset;
+    int32_t writer_pid;
+    uint32_t stale;         /* nonzero when writer removed segment, reopen by name */
+    uint32_t schema_seq;    /* seqlock of schema_id, channel_count and schema block */
+    uint32_t schema_id;
+    uint32_t channel_count;
+    uint32_t reserved0;
+    uint64_t head;          /* frames published, latest frame is head-1 */
+    uint64_t reserved1[8];
+} plclive_header;           /* 128 bytes */
+
+typedef struct plclive_channel {
+    char label[PLCLIVE_LABEL_SIZE];  /* UTF-8, zero terminated */
+    char address[PLCLIVE_ADDR_SIZE]; /* S7 address, e.g. DB10.DBD4 */
+    int32_t type;                    /* S7 type: 1 BOOL, 2 BYTE, 3 WORD, 4 DWORD, 5 INT, 6 DINT,
+                                        7 REAL, 8 TIME, 9 DATE, 10 S5TIME, 11 TIME_OF_DAY */
+    int32_t element;                 /* array element index, -1 for scalar variable */
+} plclive_channel;                   /* 104 bytes */
+
+typedef struct plclive_slot {
+    uint64_t seq;           /* 2*frame+1 while written, 2*frame+2 when complete */
+    int64_t timestamp;      /* msecs since epoch, UTC */
+    uint32_t schema_id;
+    uint32_t channel_count;
+    uint64_t reserved;
+    /* double values[channel_count] follow: numbers as is, BOOL 0/1, TIME and
+       TIME_OF_DAY in msecs, DATE as julian day, NaN when not read */
+} plclive_slot;             /* 32 bytes */
+
+typedef struct plclive_frame {
+    uint64_t frame;
+    int64_t timestamp;
+    uint32_t schema_id;
+    uint32_t channel_count;
+} plclive_frame;
+
+enum {
+    PLCLIVE_OK = 0,
+    PLCLIVE_ERROR = -1,       /* bad arguments or segment */
+    PLCLIVE_NODATA = -2,      /* frame is not published yet */
+    PLCLIVE_OVERWRITTEN = -3, /* frame left history ring */
+    PLCLIVE_BUSY = -4,        /* writer kept updating during retries */
+    PLCLIVE_STALE = -5        /* segment was removed by writer, reopen */
+};
+
+typedef struct plclive_reader plclive_reader;
+
+plclive_reader* plclive_open(const char* name);
+void plclive_close(plclive_reader* reader);
+int plclive_is_stale(const plclive_reader* reader);
+int plclive_writer_pid(const plclive_reader* reader);
+uint32_t plclive_depth(const plclive_reader* reader);
+uint64_t plclive_head(const plclive_reader* reader);
+
+/* copies schema, returns channel count or error */
+int plclive_schema(const plclive_reader* reader, uint32_t* schema_id,
+                   plclive_channel* channels, int max_channels);
+
+/* copies frame from history ring, values are truncated to max_values */
+int plclive_read(const plclive_reader* reader, uint64_t frame, plclive_frame* info,
+                 double* values, int max_values);
+int plclive_latest(const plclive_reader* reader, plclive_frame* info,
+                   double* values, int max_values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLCLIVE_H */
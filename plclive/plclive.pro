@@ -0,0 +1,19 @@
+#-------------------------------------------------
+#
+# Reader library for live data segment, plain C
+#
+#-------------------------------------------------
+
+TEMPLATE = lib
+TARGET = plclive
+
+CONFIG += staticlib warn_on
+CONFIG -= qt
+
+SOURCES += plclive.c
+
+HEADERS += plclive.h
+
+unix {
+    LIBS += -lrt
+}
@@ -4,13 +4,13 @@
 #
 #-------------------------------------------------
 
-QT       += core gui printsupport
+QT       += core gui printsupport network
 
 TARGET = plcrecorder
 TEMPLATE = app
 
 greaterThan(QT_MAJOR_VERSION, 4) {
-  QT += widgets
+  QT += widgets concurrent
   DEFINES += HAVE_QT5
 }
 
@@ -27,7 +27,20 @@ SOURCES += libnodave/nodave.c \
     qcustomplot-source/qcustomplot.cpp \
     graphform.cpp \
     settingsdialog.cpp \
-    csvhandler.cpp
+    csvhandler.cpp \
+    csvloader.cpp \
+    plotindex.cpp \
+    plotgraph.cpp \
+    plotdata.cpp \
+    plotexport.cpp \
+    plotanalysis.cpp \
+    waterfallform.cpp \
+    symimport.cpp \
+    snapshot.cpp \
+    samplebus.cpp \
+    livesegment.cpp \
+    streamserver.cpp \
+    analysisform.cpp
 
 HEADERS  += mainwindow.h \
     libnodave/log2.h \
@@ -40,10 +53,26 @@ HEADERS  += mainwindow.h \
     graphform.h \
     plc_p.h \
     settingsdialog.h \
-    csvhandler.h
+    csvhandler.h \
+    csvloader.h \
+    plotindex.h \
+    plotgraph.h \
+    plotdata.h \
+    plotexport.h \
+    plotanalysis.h \
+    waterfallform.h \
+    symimport.h \
+    snapshot.h \
+    samplebus.h \
+    livesegment.h \
+    streamserver.h \
+    plclive/plclive.h \
+    analysisform.h
 
 FORMS    += mainwindow.ui \
     graphform.ui \
+    analysisform.ui \
+    waterfallform.ui \
     settingsdialog.ui
 
 RESOURCES += \
@@ -52,8 +81,14 @@ RESOURCES += \
 CONFIG += warn_on \
     link_pkgconfig \
 
+# array decoding and FFT loops rely on auto-vectorization, which default -O2 does not do
+gcc|clang {
+    QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize
+}
+
 unix {
     DEFINES += LINUX
+    LIBS += -lrt
     SOURCES += libnodave/setport.c \
         libnodave/openSocket.c
     HEADERS += libnodave/openSocket.h \
@@ -0,0 +1,22 @@
+#include <QCoreApplication>
+#include "global.h"
+#include "plc.h"
+#include "recorderd.h"
+
+CGlobal *gSet = NULL;
+
+int main(int argc, char *argv[])
+{
+    qRegisterMetaType<CWP>("CWP");
+    qRegisterMetaType<CWPList>("CWPList");
+
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("plcrecorderd");
+    gSet = new CGlobal(&a);
+
+    CRecorderDaemon d;
+    if (!d.init(a.arguments()))
+        return 1;
+
+    return a.exec();
+}
@@ -0,0 +1,71 @@
+#-------------------------------------------------
+#
+# Headless recorder, QtCore only
+#
+#-------------------------------------------------
+
+QT       += core network
+QT       -= gui
+
+TARGET = plcrecorderd
+TEMPLATE = app
+
+CONFIG += console
+CONFIG -= app_bundle
+
+greaterThan(QT_MAJOR_VERSION, 4) {
+  DEFINES += HAVE_QT5
+}
+
+DEFINES += DAVE_LITTLE_ENDIAN PLCRECORDERD
+
+
+SOURCES += libnodave/nodave.c \
+    plcrecorderd.cpp \
+    recorderd.cpp \
+    plc.cpp \
+    global.cpp \
+    specwidgets.cpp \
+    csvhandler.cpp \
+    snapshot.cpp \
+    samplebus.cpp \
+    livesegment.cpp \
+    streamserver.cpp
+
+HEADERS  += libnodave/log2.h \
+    libnodave/nodave.h \
+    recorderd.h \
+    plc.h \
+    plc_p.h \
+    global.h \
+    specwidgets.h \
+    csvhandler.h \
+    snapshot.h \
+    samplebus.h \
+    livesegment.h \
+    streamserver.h \
+    plclive/plclive.h
+
+CONFIG += warn_on
+
+# array decoding loops rely on auto-vectorization, which default -O2 does not do
+gcc|clang {
+    QMAKE_CXXFLAGS_RELEASE += -ftree-vectorize
+}
+
+unix {
+    DEFINES += LINUX
+    LIBS += -lrt
+    SOURCES += libnodave/setport.c \
+        libnodave/openSocket.c
+    HEADERS += libnodave/openSocket.h \
+        libnodave/setport.h \
+}
+
+win32 {
+    DEFINES += BCCWIN DOEXPORT
+    LIBS += -lws2_32
+    SOURCES += libnodave/openSocketw.c \
+        libnodave/setportw.c
+    HEADERS += libnodave/openS7online.h
+}
@@ -0,0 +1,162 @@
+#include <QtMath>
+#include <QObject>
+#include "plotanalysis.h"
+
+const static int maxFFTSize = 1 << 20; // longer windows are decimated by resampling grid
+const static int minHistogramBins = 16;
+const static int maxHistogramBins = 256;
+
+CAnalysisResult::CAnalysisResult()
+{
+    binWidth = 0.0;
+    sampleRate = 0.0;
+    peakFrequency = qQNaN();
+    samples = 0;
+    fftSize = 0;
+    errorMsg = QString();
+}
+
+static void butterflies(double * __restrict ar, double * __restrict ai, double * __restrict br,
+                        double * __restrict bi, const double * __restrict cre,
+                        const double * __restrict cim, int half)
+{
+    // halves of a group never overlap, restrict lets compiler vectorize without alias checks
+    for (int k=0;k<half;k++) {
+        double tr = br[k]*cre[k]-bi[k]*cim[k];
+        double ti = br[k]*cim[k]+bi[k]*cre[k];
+        br[k] = ar[k]-tr;
+        bi[k] = ai[k]-ti;
+        ar[k] += tr;
+        ai[k] += ti;
+    }
+}
+
+static void fft(double *re, double *im, int n)
+{
+    // iterative radix-2, in place; butterflies run over contiguous arrays without branches
+    // and are vectorized with -ftree-vectorize from project file
+    for (int i=1,j=0;i<n;i++) {
+        int bit = n >> 1;
+        for (;(j & bit)!=0;bit >>= 1)
+            j ^= bit;
+        j ^= bit;
+        if (i<j) {
+            qSwap(re[i],re[j]);
+            qSwap(im[i],im[j]);
+        }
+    }
+
+    QVector<double> wre(n/2);
+    QVector<double> wim(n/2);
+    for (int i=0;i<n/2;i++) {
+        wre[i] = qCos(-2.0*M_PI*i/n);
+        wim[i] = qSin(-2.0*M_PI*i/n);
+    }
+
+    // twiddles of current stage, gathered once per stage for unit stride in butterflies
+    QVector<double> sre(n/2);
+    QVector<double> sim(n/2);
+    double *cre = sre.data();
+    double *cim = sim.data();
+
+    for (int len=2;len<=n;len <<= 1) {
+        int half = len >> 1;
+        int step = n/len;
+        for (int k=0;k<half;k++) {
+            cre[k] = wre.at(k*step);
+            cim[k] = wim.at(k*step);
+        }
+        for (int i=0;i<n;i+=len)
+            butterflies(re+i,im+i,re+i+half,im+i+half,cre,cim,half);
+    }
+}
+
+CAnalysisResult analyzeSignal(const QVector<double> &keys, const QVector<double> &values)
+{
+    CAnalysisResult res;
+    int n = qMin(keys.count(),values.count());
+
+    double sum = 0.0;
+    double vmin = qQNaN();
+    double vmax = qQNaN();
+    int valid = 0;
+    for (int i=0;i<n;i++) {
+        double v = values.at(i);
+        if (qIsNaN(v)) continue;
+        sum += v;
+        if (valid==0 || v<vmin) vmin = v;
+        if (valid==0 || v>vmax) vmax = v;
+        valid++;
+    }
+    res.samples = valid;
+    if (valid<4 || keys.at(n-1)<=keys.first()) {
+        res.errorMsg = QObject::trUtf8("Not enough samples for analysis.");
+        return res;
+    }
+    double mean = sum/valid;
+
+    // histogram
+    int bins = qBound(minHistogramBins,static_cast<int>(qSqrt(valid)),maxHistogramBins);
+    double span = vmax-vmin;
+    if (span<=0.0)
+        span = 1.0;
+    res.binWidth = span/bins;
+    res.binCenter.resize(bins);
+    res.binCount.fill(0.0,bins);
+    for (int i=0;i<bins;i++)
+        res.binCenter[i] = vmin+res.binWidth*(i+0.5);
+    for (int i=0;i<n;i++) {
+        double v = values.at(i);
+        if (qIsNaN(v)) continue;
+        int bin = qBound(0,static_cast<int>((v-vmin)/res.binWidth),bins-1);
+        res.binCount[bin] += 1.0;
+    }
+
+    // step-hold resampling to uniform grid, power of two points
+    int size = 64;
+    while (size<n && size<maxFFTSize)
+        size <<= 1;
+    double t0 = keys.first();
+    double dt = (keys.at(n-1)-t0)/size;
+    res.fftSize = size;
+    res.sampleRate = 1.0/dt;
+
+    QVector<double> re(size);
+    QVector<double> im(size,0.0);
+    int j = 0;
+    double last = mean;
+    for (int i=0;i<size;i++) {
+        double t = t0+dt*i;
+        while ((j+1)<n && keys.at(j+1)<=t)
+            j++;
+        if (!qIsNaN(values.at(j)))
+            last = values.at(j);
+        re[i] = last;
+    }
+
+    // mean removal and Hann window
+    double windowPower = 0.0;
+    for (int i=0;i<size;i++) {
+        double w = 0.5*(1.0-qCos(2.0*M_PI*i/(size-1)));
+        re[i] = (re.at(i)-mean)*w;
+        windowPower += w*w;
+    }
+
+    fft(re.data(),im.data(),size);
+
+    int half = size/2;
+    res.frequency.resize(half+1);
+    res.power.resize(half+1);
+    double peak = -1.0;
+    for (int k=0;k<=half;k++) {
+        double p = (re.at(k)*re.at(k)+im.at(k)*im.at(k))*2.0/windowPower;
+        res.frequency[k] = k*res.sampleRate/size;
+        res.power[k] = 10.0*log10(qMax(p,1e-30));
+        if (k>0 && p>peak) {
+            peak = p;
+            res.peakFrequency = res.frequency.at(k);
+        }
+    }
+
+    return res;
+}
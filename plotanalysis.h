@@ -0,0 +1,26 @@
+#ifndef PLOTANALYSIS_H
+#define PLOTANALYSIS_H
+
+#include <QVector>
+#include <QString>
+
+class CAnalysisResult
+{
+public:
+    QVector<double> frequency; // Hz
+    QVector<double> power; // dB, Hann window, mean removed
+    QVector<double> binCenter;
+    QVector<double> binCount;
+    double binWidth;
+    double sampleRate; // uniform grid used for spectrum
+    double peakFrequency;
+    int samples;
+    int fftSize;
+    QString errorMsg;
+    CAnalysisResult();
+};
+
+// thread-safe, called in worker thread with snapshot of channel rows
+CAnalysisResult analyzeSignal(const QVector<double> &keys, const QVector<double> &values);
+
+#endif // PLOTANALYSIS_H
@@ -0,0 +1,550 @@
+#include <algorithm>
+#include <QtMath>
+#include "plotdata.h"
+
+class CKeyOrder
+{
+public:
+    const QVector<double> &keys;
+    CKeyOrder(const QVector<double> &rowKeys) : keys(rowKeys) {}
+    bool operator()(int a, int b) const { return keys.at(a)<keys.at(b); }
+};
+
+CPlotColumn::CPlotColumn(bool wideValues)
+{
+    wide = wideValues;
+    clear();
+}
+
+bool CPlotColumn::isWide() const
+{
+    return wide;
+}
+
+int CPlotColumn::count() const
+{
+    if (wide) return wideData.count();
+    return narrowData.count();
+}
+
+void CPlotColumn::append(double value)
+{
+    if (wide)
+        wideData.append(value);
+    else
+        narrowData.append(static_cast<float>(value));
+    lodIndex.append(value);
+}
+
+void CPlotColumn::remove(int first, int count)
+{
+    if (wide) {
+        wideData.remove(first,count);
+        wideData.squeeze();
+    } else {
+        narrowData.remove(first,count);
+        narrowData.squeeze();
+    }
+    lodIndex.rebuild(*this);
+}
+
+void CPlotColumn::clear()
+{
+    narrowData.clear();
+    wideData.clear();
+    lodIndex.clear();
+}
+
+qint64 CPlotColumn::memoryUsage() const
+{
+    return narrowData.capacity()*static_cast<qint64>(sizeof(float)) +
+            wideData.capacity()*static_cast<qint64>(sizeof(double)) +
+            lodIndex.memoryUsage();
+}
+
+const CMinMaxIndex &CPlotColumn::index() const
+{
+    return lodIndex;
+}
+
+CRangeStats::CRangeStats()
+{
+    min = qQNaN();
+    max = qQNaN();
+    mean = qQNaN();
+    stdDev = qQNaN();
+    integral = qQNaN();
+    timeHigh = qQNaN();
+    edges = -1;
+}
+
+CDigitalData::CDigitalData()
+{
+    clear();
+}
+
+void CDigitalData::appendData(const QVector<double> &keys, const QVector<double> &values)
+{
+    for (int i=0;i<keys.count() && i<values.count();i++) {
+        double key = keys.at(i);
+        bool level = (values.at(i)>0.5);
+
+        // transitions must be in time order, late samples are dropped
+        if (!edgeKeys.isEmpty() && key<lastSampleKey) continue;
+
+        if (edgeKeys.isEmpty() || edgeLevels.last()!=level) {
+            if (edgeKeys.isEmpty())
+                highPrefix.append(0.0);
+            else if (edgeLevels.last())
+                highPrefix.append(highPrefix.last()+key-edgeKeys.last());
+            else
+                highPrefix.append(highPrefix.last());
+            edgeKeys.append(key);
+            edgeLevels.append(level);
+        }
+        lastSampleKey = key;
+    }
+}
+
+void CDigitalData::clear()
+{
+    edgeKeys.clear();
+    edgeLevels.clear();
+    highPrefix.clear();
+    lastSampleKey = qQNaN();
+}
+
+bool CDigitalData::isEmpty() const
+{
+    return edgeKeys.isEmpty();
+}
+
+int CDigitalData::count() const
+{
+    return edgeKeys.count();
+}
+
+qint64 CDigitalData::memoryUsage() const
+{
+    return edgeKeys.capacity()*static_cast<qint64>(sizeof(double)) +
+            edgeLevels.capacity()*static_cast<qint64>(sizeof(bool)) +
+            highPrefix.capacity()*static_cast<qint64>(sizeof(double));
+}
+
+int CDigitalData::removeDataBefore(double key)
+{
+    if (edgeKeys.isEmpty() || key<=edgeKeys.first()) return 0;
+
+    int cnt = edgeKeys.count();
+    if (key>lastSampleKey) {
+        clear();
+        return cnt;
+    }
+
+    // level at key is kept, starting from key
+    int idx = edgeIndex(key);
+    edgeKeys.remove(0,idx);
+    edgeLevels.remove(0,idx);
+    edgeKeys[0] = key;
+    edgeKeys.squeeze();
+    edgeLevels.squeeze();
+    rebuildHighTime();
+
+    return idx;
+}
+
+void CDigitalData::rebuildHighTime()
+{
+    highPrefix.resize(edgeKeys.count());
+    highPrefix.squeeze();
+    for (int i=0;i<edgeKeys.count();i++) {
+        if (i==0)
+            highPrefix[i] = 0.0;
+        else if (edgeLevels.at(i-1))
+            highPrefix[i] = highPrefix.at(i-1)+edgeKeys.at(i)-edgeKeys.at(i-1);
+        else
+            highPrefix[i] = highPrefix.at(i-1);
+    }
+}
+
+double CDigitalData::highTime(double key) const
+{
+    int idx = edgeIndex(key);
+    if (idx<0) return 0.0;
+
+    double res = highPrefix.at(idx);
+    if (edgeLevels.at(idx))
+        res += qMin(key,lastSampleKey)-edgeKeys.at(idx);
+    return res;
+}
+
+double CDigitalData::lastKey() const
+{
+    return lastSampleKey;
+}
+
+QCPRange CDigitalData::keyRange() const
+{
+    if (edgeKeys.isEmpty()) return QCPRange(qQNaN(),qQNaN());
+    return QCPRange(edgeKeys.first(),lastSampleKey);
+}
+
+int CDigitalData::edgeIndex(double key) const
+{
+    // last transition at or before key, -1 for key before signal start
+    QVector<double>::const_iterator it = std::upper_bound(edgeKeys.constBegin(),edgeKeys.constEnd(),key);
+    return static_cast<int>(it-edgeKeys.constBegin())-1;
+}
+
+bool CDigitalData::valueAt(double key, double &value) const
+{
+    if (edgeKeys.isEmpty() || key<edgeKeys.first() || key>lastSampleKey) return false;
+
+    int idx = edgeIndex(key);
+    if (idx<0) return false;
+
+    if (edgeLevels.at(idx))
+        value = 1.0;
+    else
+        value = 0.0;
+    return true;
+}
+
+CPlotData::CPlotData()
+{
+    dataGeneration = 0;
+    clear();
+}
+
+void CPlotData::clear()
+{
+    keys.clear();
+    columns.clear();
+    sums.clear();
+    digitals.clear();
+    dataGeneration++;
+}
+
+void CPlotData::clearRows()
+{
+    keys.clear();
+    for (int i=0;i<columns.count();i++) {
+        columns[i].clear();
+        sums[i].clear();
+    }
+    for (int i=0;i<digitals.count();i++)
+        digitals[i].clear();
+    dataGeneration++;
+}
+
+int CPlotData::addColumn(bool wideValues)
+{
+    // rows added before this column are empty
+    CPlotColumn column(wideValues);
+    CSumIndex index;
+    for (int i=0;i<keys.count();i++) {
+        column.append(qQNaN());
+        index.append(keys.at(i),qQNaN());
+    }
+    columns.append(column);
+    sums.append(index);
+    return columns.count()-1;
+}
+
+int CPlotData::columnCount() const
+{
+    return columns.count();
+}
+
+const CPlotColumn &CPlotData::column(int idx) const
+{
+    return columns.at(idx);
+}
+
+int CPlotData::addDigital()
+{
+    digitals.append(CDigitalData());
+    return digitals.count()-1;
+}
+
+int CPlotData::digitalCount() const
+{
+    return digitals.count();
+}
+
+const CDigitalData &CPlotData::digital(int idx) const
+{
+    return digitals.at(idx);
+}
+
+int CPlotData::count() const
+{
+    return keys.count();
+}
+
+bool CPlotData::isEmpty() const
+{
+    return keys.isEmpty();
+}
+
+QCPRange CPlotData::keyRange() const
+{
+    QCPRange res(qQNaN(),qQNaN());
+    if (!keys.isEmpty())
+        res = QCPRange(keys.first(),keys.last());
+    for (int i=0;i<digitals.count();i++) {
+        if (digitals.at(i).isEmpty()) continue;
+        if (QCPRange::validRange(res))
+            res.expand(digitals.at(i).keyRange());
+        else
+            res = digitals.at(i).keyRange();
+    }
+    return res;
+}
+
+int CPlotData::findBegin(double key) const
+{
+    // first row at or after key
+    return static_cast<int>(std::lower_bound(keys.constBegin(),keys.constEnd(),key)-keys.constBegin());
+}
+
+int CPlotData::findEnd(double key) const
+{
+    // first row after key
+    return static_cast<int>(std::upper_bound(keys.constBegin(),keys.constEnd(),key)-keys.constBegin());
+}
+
+int CPlotData::rowAt(double key) const
+{
+    // last row at or before key, -1 outside of data
+    if (keys.isEmpty() || key<keys.first() || key>keys.last()) return -1;
+    return findEnd(key)-1;
+}
+
+void CPlotData::appendRows(const QVector<double> &rowKeys, const QVector<const QVector<double> *> &values)
+{
+    if (rowKeys.isEmpty()) return;
+
+    bool unsorted = false;
+    for (int i=0;i<rowKeys.count();i++) {
+        if (!keys.isEmpty() && rowKeys.at(i)<keys.last())
+            unsorted = true;
+        keys.append(rowKeys.at(i));
+    }
+
+    for (int i=0;i<columns.count();i++) {
+        CPlotColumn &column = columns[i];
+        CSumIndex &index = sums[i];
+        const QVector<double> *data = NULL;
+        if (i<values.count())
+            data = values.at(i);
+        for (int j=0;j<rowKeys.count();j++) {
+            double value = qQNaN();
+            if (data!=NULL && j<data->count())
+                value = data->at(j);
+            column.append(value);
+            index.append(rowKeys.at(j),value);
+        }
+    }
+
+    // full resort only for out-of-order timestamps
+    if (unsorted)
+        sortRows();
+}
+
+void CPlotData::appendDigital(int idx, const QVector<double> &keys, const QVector<double> &values)
+{
+    if (idx<0 || idx>=digitals.count()) return;
+    digitals[idx].appendData(keys,values);
+}
+
+void CPlotData::sortRows()
+{
+    QVector<int> order(keys.count());
+    for (int i=0;i<order.count();i++)
+        order[i] = i;
+    std::stable_sort(order.begin(),order.end(),CKeyOrder(keys));
+
+    QVector<double> sortedKeys(keys.count());
+    for (int i=0;i<order.count();i++)
+        sortedKeys[i] = keys.at(order.at(i));
+    keys = sortedKeys;
+
+    for (int i=0;i<columns.count();i++) {
+        const CPlotColumn &column = columns.at(i);
+        CPlotColumn sorted(column.isWide());
+        for (int j=0;j<order.count();j++)
+            sorted.append(column.value(order.at(j)));
+        columns[i] = sorted;
+    }
+    rebuildSums();
+    dataGeneration++;
+}
+
+CMinMax CPlotData::totalRange(int column) const
+{
+    if (column<0 || column>=columns.count()) return CMinMax();
+    return columns.at(column).index().total();
+}
+
+bool CPlotData::valueRange(int column, const QCPRange &keyRange, CMinMax &range) const
+{
+    range = CMinMax();
+    if (column<0 || column>=columns.count()) return false;
+
+    const CPlotColumn &data = columns.at(column);
+    return data.index().valueRange(data,findBegin(keyRange.lower),findEnd(keyRange.upper)-1,range);
+}
+
+bool CPlotData::rangeStats(int column, const QCPRange &keyRange, CRangeStats &stats) const
+{
+    stats = CRangeStats();
+    if (column<0 || column>=columns.count()) return false;
+
+    const CPlotColumn &data = columns.at(column);
+    const CSumIndex &index = sums.at(column);
+    int first = findBegin(keyRange.lower);
+    int last = findEnd(keyRange.upper)-1;
+    if (first>last) return false;
+
+    CSums head = index.prefix(keys,data,first);
+    CSums tail = index.prefix(keys,data,last+1);
+    qint64 cnt = tail.count-head.count;
+    if (cnt<=0) return false;
+
+    CMinMax range;
+    data.index().valueRange(data,first,last,range);
+    stats.min = range.min;
+    stats.max = range.max;
+
+    double sum = tail.sum-head.sum;
+    double sumSq = tail.sumSq-head.sumSq;
+    double n = static_cast<double>(cnt);
+    stats.mean = index.origin()+sum/n;
+    stats.stdDev = qSqrt(qMax(0.0,(sumSq-sum*sum/n)/n));
+
+    // prefix difference covers rows [first-1..last-1] intervals, trimmed to key range at both sides
+    stats.integral = tail.integral-head.integral;
+    if (first>0 && !qIsNaN(data.value(first-1)))
+        stats.integral -= data.value(first-1)*(keyRange.lower-keys.at(first-1));
+    if ((last+1)<keys.count() && !qIsNaN(data.value(last)))
+        stats.integral += data.value(last)*(keyRange.upper-keys.at(last));
+
+    return true;
+}
+
+bool CPlotData::digitalStats(int idx, const QCPRange &keyRange, CRangeStats &stats) const
+{
+    stats = CRangeStats();
+    if (idx<0 || idx>=digitals.count()) return false;
+
+    const CDigitalData &data = digitals.at(idx);
+    if (data.isEmpty()) return false;
+
+    double lower = qMax(keyRange.lower,data.edgeKey(0));
+    double upper = qMin(keyRange.upper,data.lastKey());
+    if (lower>upper) return false;
+
+    stats.timeHigh = data.highTime(upper)-data.highTime(lower);
+    stats.integral = stats.timeHigh;
+    stats.edges = data.edgeIndex(upper)-data.edgeIndex(lower);
+
+    double level = 0.0;
+    if (data.edgeLevel(data.edgeIndex(lower)))
+        level = 1.0;
+    if (stats.edges>0) {
+        stats.min = 0.0;
+        stats.max = 1.0;
+    } else {
+        stats.min = level;
+        stats.max = level;
+    }
+
+    if (upper>lower)
+        stats.mean = stats.timeHigh/(upper-lower);
+    else
+        stats.mean = level;
+
+    return true;
+}
+
+qint64 CPlotData::memoryUsage() const
+{
+    qint64 res = keys.capacity()*static_cast<qint64>(sizeof(double));
+    for (int i=0;i<columns.count();i++)
+        res += columns.at(i).memoryUsage()+sums.at(i).memoryUsage();
+    for (int i=0;i<digitals.count();i++)
+        res += digitals.at(i).memoryUsage();
+    return res;
+}
+
+int CPlotData::downsampleBefore(double key, int factor)
+{
+    // rows older than key replaced with min/max envelope, two rows per factor rows,
+    // extremums of all channels share bucket timestamps
+    int cnt = findBegin(key);
+    if (factor<2 || cnt<(factor*2)) return 0;
+
+    QVector<double> newKeys;
+    newKeys.reserve(2*(cnt/factor+1));
+    for (int i=0;i<cnt;i+=factor) {
+        int end = qMin(i+factor,cnt);
+        newKeys.append(keys.at(i));
+        if ((end-i)>1)
+            newKeys.append(keys.at((i+end)/2));
+    }
+
+    for (int c=0;c<columns.count();c++) {
+        const CPlotColumn &column = columns.at(c);
+        CPlotColumn envelope(column.isWide());
+        for (int i=0;i<cnt;i+=factor) {
+            int end = qMin(i+factor,cnt);
+            CMinMax range;
+            for (int j=i;j<end;j++)
+                range.merge(column.value(j));
+            envelope.append(range.min);
+            if ((end-i)>1)
+                envelope.append(range.max);
+        }
+        for (int j=cnt;j<keys.count();j++)
+            envelope.append(column.value(j));
+        columns[c] = envelope;
+    }
+
+    int removed = cnt-newKeys.count();
+    newKeys += keys.mid(cnt);
+    keys = newKeys;
+    rebuildSums();
+    dataGeneration++;
+
+    return removed;
+}
+
+int CPlotData::removeDataBefore(double key)
+{
+    dataGeneration++;
+    for (int i=0;i<digitals.count();i++)
+        digitals[i].removeDataBefore(key);
+
+    int cnt = findBegin(key);
+    if (cnt<=0) return 0;
+
+    keys.remove(0,cnt);
+    keys.squeeze();
+    for (int i=0;i<columns.count();i++)
+        columns[i].remove(0,cnt);
+    rebuildSums();
+
+    return cnt;
+}
+
+int CPlotData::generation() const
+{
+    return dataGeneration;
+}
+
+void CPlotData::rebuildSums()
+{
+    for (int i=0;i<columns.count();i++)
+        sums[i].rebuild(keys,columns.at(i));
+}
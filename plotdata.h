@@ -0,0 +1,138 @@
+#ifndef PLOTDATA_H
+#define PLOTDATA_H
+
+#include <QVector>
+#include "qcustomplot-source/qcustomplot.h"
+#include "plotindex.h"
+
+class CPlotColumn
+{
+public:
+    CPlotColumn(bool wideValues = false);
+
+    bool isWide() const;
+    int count() const;
+    inline double value(int row) const {
+        if (wide) return wideData.at(row);
+        return static_cast<double>(narrowData.at(row));
+    }
+
+    void append(double value);
+    void remove(int first, int count);
+    void clear();
+    qint64 memoryUsage() const;
+    const CMinMaxIndex& index() const;
+
+private:
+    // 32-bit integers does not fit in float mantissa
+    bool wide;
+    QVector<float> narrowData;
+    QVector<double> wideData;
+    CMinMaxIndex lodIndex;
+
+};
+
+class CRangeStats
+{
+public:
+    double min;
+    double max;
+    double mean; // time-weighted duty cycle for BOOL
+    double stdDev;
+    double integral; // step-hold, in value*seconds
+    double timeHigh; // BOOL only
+    int edges; // BOOL only, -1 for analogue
+    CRangeStats();
+};
+
+class CDigitalData
+{
+public:
+    CDigitalData();
+
+    void appendData(const QVector<double> &keys, const QVector<double> &values);
+    void clear();
+    bool isEmpty() const;
+    int count() const;
+    qint64 memoryUsage() const;
+    int removeDataBefore(double key);
+
+    inline double edgeKey(int idx) const { return edgeKeys.at(idx); }
+    inline bool edgeLevel(int idx) const { return edgeLevels.at(idx); }
+    double lastKey() const;
+    QCPRange keyRange() const;
+
+    // accumulated high level duration from signal start to key, O(log n)
+    double highTime(double key) const;
+
+    // signal level at key, O(log n)
+    int edgeIndex(double key) const;
+    bool valueAt(double key, double &value) const;
+
+private:
+    // run-length storage: level changes only, last sample key closes the signal
+    QVector<double> edgeKeys;
+    QVector<bool> edgeLevels;
+    QVector<double> highPrefix; // high level duration before each transition
+    double lastSampleKey;
+
+    void rebuildHighTime();
+
+};
+
+class CPlotData
+{
+public:
+    CPlotData();
+
+    void clear();
+    void clearRows();
+    int addColumn(bool wideValues);
+    int columnCount() const;
+    const CPlotColumn& column(int idx) const;
+    int addDigital();
+    int digitalCount() const;
+    const CDigitalData& digital(int idx) const;
+
+    int count() const;
+    bool isEmpty() const;
+    inline double key(int row) const { return keys.at(row); }
+    QCPRange keyRange() const;
+
+    // row search in analogue data, one binary search shared by all channels
+    int findBegin(double key) const;
+    int findEnd(double key) const;
+    int rowAt(double key) const;
+
+    // values for missing columns are NaN
+    void appendRows(const QVector<double> &rowKeys, const QVector<const QVector<double> *> &values);
+    void appendDigital(int idx, const QVector<double> &keys, const QVector<double> &values);
+
+    CMinMax totalRange(int column) const;
+    bool valueRange(int column, const QCPRange &keyRange, CMinMax &range) const;
+
+    // statistics between cursors from prefix sums and min/max index, without rows scanning
+    bool rangeStats(int column, const QCPRange &keyRange, CRangeStats &stats) const;
+    bool digitalStats(int idx, const QCPRange &keyRange, CRangeStats &stats) const;
+
+    // memory limiting for long history
+    qint64 memoryUsage() const;
+    int downsampleBefore(double key, int factor);
+    int removeDataBefore(double key);
+
+    // changed on every modification except appending, used for render caches invalidation
+    int generation() const;
+
+private:
+    QVector<double> keys; // shared timestamps column
+    QVector<CPlotColumn> columns;
+    QVector<CSumIndex> sums; // for each column
+    QVector<CDigitalData> digitals;
+    int dataGeneration;
+
+    void sortRows();
+    void rebuildSums();
+
+};
+
+#endif // PLOTDATA_H
@@ -0,0 +1,367 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSet>
+#include <QThread>
+#include <QTextStream>
+#include <QCommandLineParser>
+#include <QtConcurrentMap>
+#include "plotexport.h"
+#include "csvloader.h"
+#include "global.h"
+
+const static int linesPerChunk = 1024;
+const static int defaultExportWidth = 1600; // pixels, also LOD decimation base for vector output
+
+CExportOptions::CExportOptions()
+{
+    outputDir = QDir::currentPath();
+    format = QString("pdf");
+    keyRange = QCPRange(qQNaN(),qQNaN());
+    channels.clear();
+    width = defaultExportWidth;
+    rowHeight = 100;
+}
+
+bool CExportOptions::isChannelSelected(const CWP &wp) const
+{
+    if (channels.isEmpty()) return true;
+    return (channels.contains(wp.label) || channels.contains(gSet->plcGetAddrName(wp)));
+}
+
+CExportRecording::CExportRecording()
+{
+    fileName = QString();
+    errorMsg = QString();
+    channels.clear();
+}
+
+CRecordingLoader::CRecordingLoader(const CExportOptions &options)
+{
+    exportOptions = options;
+}
+
+CExportRecording CRecordingLoader::operator()(const QString &fname) const
+{
+    CExportRecording rec;
+    rec.fileName = fname;
+
+    QFile f(fname);
+    if (!f.open(QIODevice::ReadOnly)) {
+        rec.errorMsg = QObject::trUtf8("Unable to open file %1.").arg(fname);
+        return rec;
+    }
+    QByteArray s = f.readLine();
+    if (!s.startsWith("\"Time\"; ")) {
+        rec.errorMsg = QObject::trUtf8("Unrecognized CSV file %1.").arg(fname);
+        return rec;
+    }
+
+    // files are already processed in parallel, chunks are decoded in this thread
+    int lineNum = 2;
+    while (!f.atEnd() && rec.errorMsg.isEmpty()) {
+        QList<QByteArray> lines;
+        int firstLine = lineNum;
+        while (!f.atEnd() && lines.count()<linesPerChunk) {
+            lines.append(f.readLine());
+            lineNum++;
+        }
+
+        CCSVChunk chunk = CCSVLoader::decodeChunk(lines,firstLine);
+        for (int i=0;i<chunk.batches.count();i++)
+            appendBatch(rec,chunk.batches.at(i));
+        if (!chunk.errorMsg.isEmpty())
+            rec.errorMsg = chunk.errorMsg.arg(fname).arg(chunk.errorLine);
+    }
+    f.close();
+
+    return rec;
+}
+
+void CRecordingLoader::appendBatch(CExportRecording &rec, const CPlotBatch &batch) const
+{
+    if (batch.isEmpty()) return;
+
+    // channels matched by uuid, so WPs added in the middle of recording become new channels
+    QVector<int> map;
+    for (int i=0;i<batch.schema.count();i++) {
+        const CWP &wp = batch.schema.at(i);
+        if (!CGraphForm::isPlottable(wp)) continue;
+
+        int channel = -1;
+        for (int j=0;j<rec.channels.count();j++) {
+            if (rec.channels.at(j).wp==wp) {
+                channel = j;
+                break;
+            }
+        }
+
+        if (channel<0 && exportOptions.isChannelSelected(wp)) {
+            CPlotChannel ch;
+            ch.wp = wp;
+            switch (wp.vtype) {
+                case CWP::S7BOOL:
+                    ch.digital = rec.data.addDigital();
+                    break;
+                case CWP::S7BYTE:
+                case CWP::S7WORD:
+                case CWP::S7DWORD:
+                case CWP::S7INT:
+                case CWP::S7DINT:
+                case CWP::S7REAL:
+                    ch.column = rec.data.addColumn(wp.vtype==CWP::S7DINT || wp.vtype==CWP::S7DWORD);
+                    break;
+                default:
+                    break;
+            }
+            if (ch.column>=0 || ch.digital>=0) {
+                rec.channels.append(ch);
+                channel = rec.channels.count()-1;
+            }
+        }
+        map.append(channel);
+    }
+
+    // scans outside of requested time range are skipped
+    const QCPRange &range = exportOptions.keyRange;
+    QVector<int> rows;
+    for (int i=0;i<batch.keys.count();i++) {
+        double key = batch.keys.at(i);
+        if ((qIsNaN(range.lower) || key>=range.lower) &&
+                (qIsNaN(range.upper) || key<=range.upper))
+            rows.append(i);
+    }
+    if (rows.isEmpty()) return;
+
+    bool allRows = (rows.count()==batch.keys.count());
+    QVector<double> keys = batch.keys;
+    if (!allRows) {
+        keys.clear();
+        for (int i=0;i<rows.count();i++)
+            keys.append(batch.keys.at(rows.at(i)));
+    }
+
+    QVector<QVector<double> > values(map.count());
+    QVector<const QVector<double> *> columns(rec.data.columnCount(),NULL);
+    for (int i=0;i<map.count() && i<batch.values.count();i++) {
+        if (map.at(i)<0) continue;
+
+        if (allRows)
+            values[i] = batch.values.at(i);
+        else {
+            values[i].reserve(rows.count());
+            for (int j=0;j<rows.count();j++)
+                values[i].append(batch.values.at(i).at(rows.at(j)));
+        }
+
+        const CPlotChannel &channel = rec.channels.at(map.at(i));
+        if (channel.column>=0)
+            columns[channel.column] = &(values.at(i));
+        else
+            rec.data.appendDigital(channel.digital,keys,values.at(i));
+    }
+    rec.data.appendRows(keys,columns);
+}
+
+bool CPlotExporter::renderRecording(const CExportRecording &rec, const CExportOptions &options,
+                                    const QString &outputFile)
+{
+    QCPRange keyRange = rec.data.keyRange();
+    if (!qIsNaN(options.keyRange.lower))
+        keyRange.lower = options.keyRange.lower;
+    if (!qIsNaN(options.keyRange.upper))
+        keyRange.upper = options.keyRange.upper;
+    if (rec.channels.isEmpty() || qIsNaN(keyRange.lower) || qIsNaN(keyRange.upper) ||
+            keyRange.size()<=0.0) return false;
+
+    // all selected channels in one page, same rows as in plot window
+    QCustomPlot plot;
+    QCPLayoutGrid* grid = plot.plotLayout();
+    grid->clear();
+    grid->setRowSpacing(0);
+    int rowHeight = qMax(20,options.rowHeight);
+
+    for (int i=0;i<rec.channels.count();i++) {
+        const CPlotChannel &channel = rec.channels.at(i);
+
+        QCPAxisRect* rect = new QCPAxisRect(&plot,false);
+        grid->addElement(i,0,rect);
+        rect->setMinimumMargins(QMargins(0,0,0,0));
+        rect->setMinimumSize(100,rowHeight);
+        rect->setMaximumSize(QWIDGETSIZE_MAX,rowHeight);
+
+        QCPAxis* xAxis = rect->addAxis(QCPAxis::atTop);
+        QCPAxis* yAxis = rect->addAxis(QCPAxis::atLeft);
+
+        QFont font = yAxis->labelFont();
+        font.setPointSize(6);
+        yAxis->setLabelFont(font);
+        yAxis->setTickLabelSide(QCPAxis::lsInside);
+        yAxis->setTickLabelFont(font);
+
+        if (i==0) {
+            QSharedPointer<QCPAxisTickerDateTime> dateTicker(new QCPAxisTickerDateTime);
+            dateTicker->setDateTimeFormat("h:mm:ss.zzz\nd.MM.yyyy");
+            xAxis->setTicker(dateTicker);
+            xAxis->setTickLabelFont(font);
+        } else
+            xAxis->setTickLabels(false);
+
+        xAxis->grid()->setVisible(true);
+        yAxis->grid()->setVisible(true);
+
+        QFontMetrics fm(yAxis->labelFont());
+        QString yLabel = fm.elidedText(channel.wp.label,Qt::ElideRight,rowHeight);
+        yAxis->setLabel(QString("%1\n%2").arg(yLabel,gSet->plcGetAddrName(channel.wp)));
+        yAxis->setTickLabels(channel.wp.vtype!=CWP::S7BOOL);
+
+        // LOD graphs, vector output gets about two points per pixel of export width
+        if (channel.digital>=0) {
+            CDigitalGraph* graph = new CDigitalGraph(xAxis,yAxis,&(rec.data),channel.digital);
+            graph->setAntialiased(gSet->plotAntialiasing);
+            yAxis->setRange(-0.1,1.1);
+        } else {
+            CLODGraph* graph = new CLODGraph(xAxis,yAxis,&(rec.data),channel.column);
+            graph->setAntialiased(gSet->plotAntialiasing);
+            CMinMax range;
+            rec.data.valueRange(channel.column,keyRange,range);
+            if (qIsNaN(range.min))
+                yAxis->setRange(channel.valueRange);
+            else {
+                double increment = (range.max-range.min)*0.1;
+                if (increment<=0.0)
+                    increment = 1.0;
+                yAxis->setRange(range.min-increment,range.max+increment);
+            }
+        }
+
+        xAxis->setRange(keyRange);
+    }
+
+    int width = qMax(200,options.width);
+    int height = rowHeight*rec.channels.count()+rowHeight/2;
+
+    if (options.format==QString("png"))
+        return plot.savePng(outputFile,width,height);
+    return plot.savePdf(outputFile,width,height);
+}
+
+int CPlotExporter::exec(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::trUtf8("PLC recorder - batch plot export"));
+    parser.addHelpOption();
+    QCommandLineOption exportOption("export",QObject::trUtf8("Export recordings to output directory."),
+                                    QObject::trUtf8("directory"));
+    QCommandLineOption formatOption("format",QObject::trUtf8("Output format, pdf or png."),
+                                    QObject::trUtf8("format"),QString("pdf"));
+    QCommandLineOption fromOption("from",QObject::trUtf8("Range start, ISO 8601 date and time."),
+                                  QObject::trUtf8("time"));
+    QCommandLineOption toOption("to",QObject::trUtf8("Range end, ISO 8601 date and time."),
+                                QObject::trUtf8("time"));
+    QCommandLineOption channelsOption("channels",QObject::trUtf8("Comma separated WP labels or addresses."),
+                                      QObject::trUtf8("list"));
+    QCommandLineOption widthOption("width",QObject::trUtf8("Page width in pixels."),
+                                   QObject::trUtf8("pixels"),QString::number(defaultExportWidth));
+    QCommandLineOption rowHeightOption("row-height",QObject::trUtf8("Channel row height in pixels."),
+                                       QObject::trUtf8("pixels"));
+    parser.addOption(exportOption);
+    parser.addOption(formatOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.addOption(channelsOption);
+    parser.addOption(widthOption);
+    parser.addOption(rowHeightOption);
+    parser.addPositionalArgument("files",QObject::trUtf8("CSV recordings."),QString("files..."));
+    parser.process(arguments);
+
+    gSet = new CGlobal();
+    gSet->loadSettings();
+
+    CExportOptions options;
+    options.outputDir = parser.value(exportOption);
+    options.format = parser.value(formatOption).toLower();
+    options.width = parser.value(widthOption).toInt();
+    options.rowHeight = gSet->plotVerticalSize;
+    if (parser.isSet(rowHeightOption))
+        options.rowHeight = parser.value(rowHeightOption).toInt();
+    if (parser.isSet(channelsOption))
+        options.channels = parser.value(channelsOption).split(',',QString::SkipEmptyParts);
+    if (parser.isSet(fromOption)) {
+        QDateTime time = QDateTime::fromString(parser.value(fromOption),Qt::ISODate);
+        if (time.isValid())
+            options.keyRange.lower = static_cast<double>(time.toMSecsSinceEpoch())/1000.0;
+    }
+    if (parser.isSet(toOption)) {
+        QDateTime time = QDateTime::fromString(parser.value(toOption),Qt::ISODate);
+        if (time.isValid())
+            options.keyRange.upper = static_cast<double>(time.toMSecsSinceEpoch())/1000.0;
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.isEmpty() || (options.format!=QString("pdf") && options.format!=QString("png"))) {
+        err << parser.helpText();
+        err.flush();
+        return 1;
+    }
+    if (!QDir().mkpath(options.outputDir)) {
+        err << QObject::trUtf8("Unable to create directory %1.").arg(options.outputDir) << endl;
+        return 1;
+    }
+
+    // outputs named by recordings, same names from different directories get numeric suffix
+    QStringList outputs;
+    QSet<QString> usedNames;
+    for (int i=0;i<files.count();i++) {
+        QString base = QFileInfo(files.at(i)).completeBaseName();
+        QString name = base;
+        for (int n=2;usedNames.contains(name.toLower());n++)
+            name = QString("%1_%2").arg(base).arg(n);
+        usedNames.insert(name.toLower());
+        outputs << QDir(options.outputDir).filePath(QString("%1.%2").arg(name,options.format));
+    }
+
+    // recordings loaded in parallel, one group at a time, rendering stays in main thread.
+    // Group is bounded by thread count and by plot memory limit, decoded recording
+    // takes about size of its CSV file.
+    int failed = 0;
+    int maxGroup = qMax(1,QThread::idealThreadCount());
+    qint64 budget = static_cast<qint64>(gSet->plotMemoryLimit)*1024*1024; // 0 for no limit
+    CRecordingLoader loader(options);
+    int group = 0;
+    while (group<files.count()) {
+        int groupSize = 1;
+        qint64 groupBytes = QFileInfo(files.at(group)).size();
+        while (((group+groupSize)<files.count()) && (groupSize<maxGroup)) {
+            qint64 bytes = QFileInfo(files.at(group+groupSize)).size();
+            if ((budget>0) && ((groupBytes+bytes)>budget)) break;
+            groupBytes += bytes;
+            groupSize++;
+        }
+
+        QList<CExportRecording> recordings = QtConcurrent::blockingMapped<QList<CExportRecording> >(
+                                                 files.mid(group,groupSize),loader);
+        for (int i=0;i<recordings.count();i++) {
+            const CExportRecording &rec = recordings.at(i);
+            const QString outputFile = outputs.at(group+i);
+            if (!rec.errorMsg.isEmpty()) {
+                err << rec.errorMsg << endl;
+                failed++;
+            } else if (!renderRecording(rec,options,outputFile)) {
+                err << QObject::trUtf8("Nothing to export from %1.").arg(rec.fileName) << endl;
+                failed++;
+            } else
+                out << QObject::trUtf8("%1 exported to %2.").arg(rec.fileName,outputFile) << endl;
+        }
+        group += groupSize;
+    }
+
+    delete gSet;
+    gSet = NULL;
+
+    if (failed>0) return 2;
+    return 0;
+}
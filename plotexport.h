@@ -0,0 +1,61 @@
+#ifndef PLOTEXPORT_H
+#define PLOTEXPORT_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "qcustomplot-source/qcustomplot.h"
+#include "plc.h"
+#include "plotdata.h"
+#include "graphform.h"
+
+class CExportOptions
+{
+public:
+    QString outputDir;
+    QString format; // pdf or png
+    QCPRange keyRange; // NaN bounds for whole recording
+    QStringList channels; // WP labels or addresses, empty for all plottable WPs
+    int width;
+    int rowHeight;
+    CExportOptions();
+
+    bool isChannelSelected(const CWP &wp) const;
+};
+
+class CExportRecording
+{
+public:
+    QString fileName;
+    QString errorMsg;
+    QVector<CPlotChannel> channels;
+    CPlotData data;
+    CExportRecording();
+};
+
+class CRecordingLoader
+{
+public:
+    typedef CExportRecording result_type;
+
+    // thread-safe, recordings are loaded in parallel
+    explicit CRecordingLoader(const CExportOptions &options);
+    CExportRecording operator()(const QString &fname) const;
+
+private:
+    CExportOptions exportOptions;
+
+    void appendBatch(CExportRecording &rec, const CPlotBatch &batch) const;
+};
+
+class CPlotExporter
+{
+public:
+    // command line batch export, returns process exit code
+    static int exec(const QStringList &arguments);
+
+    // GUI thread only, QCustomPlot is widget
+    static bool renderRecording(const CExportRecording &rec, const CExportOptions &options, const QString &outputFile);
+};
+
+#endif // PLOTEXPORT_H
@@ -0,0 +1,467 @@
+#include <cstring>
+#include "plotgraph.h"
+
+const static int stripMargin = 3; // pixels redrawn left of previous data end, covers partial LOD buckets
+
+CCachedPlottable::CCachedPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data) :
+    QCPAbstractPlottable(keyAxis,valueAxis)
+{
+    plotData = data;
+    follow = false;
+    cacheValid = false;
+    cacheKeyLower = 0.0;
+    cacheScale = 0.0;
+    cacheDataEnd = qQNaN();
+    cacheGeneration = 0;
+}
+
+bool CCachedPlottable::followMode() const
+{
+    return follow;
+}
+
+void CCachedPlottable::setFollowMode(bool enabled)
+{
+    follow = enabled;
+    invalidateCache();
+}
+
+void CCachedPlottable::invalidateCache()
+{
+    cacheValid = false;
+    cacheImage = QImage();
+}
+
+static void shiftImage(QImage &image, int dx)
+{
+    // horizontal scroll by dx pixels to the left, exposed strip is redrawn later
+    int bpp = image.depth()/8;
+    int width = image.width()-qAbs(dx);
+    for (int y=0;y<image.height();y++) {
+        uchar *line = image.scanLine(y);
+        if (dx>0)
+            memmove(line,line+dx*bpp,width*bpp);
+        else
+            memmove(line-dx*bpp,line,width*bpp);
+    }
+}
+
+void CCachedPlottable::renderCache()
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis || !mVisible) return;
+
+    QCPRange range = keyAxis->range();
+    QRect area = keyAxis->axisRect()->rect();
+    if (range.size()<=0.0 || area.width()<1 || area.height()<1) {
+        cacheValid = false;
+        return;
+    }
+    double scale = range.size()/static_cast<double>(area.width());
+    double dataEnd = dataEndKey();
+
+    // full redraw on resize, zoom, value axis change and data modifications other than appending
+    int dx = 0;
+    bool full = (!cacheValid || cacheArea!=area || cacheValueRange!=valueAxis->range() ||
+                 cacheGeneration!=plotData->generation() ||
+                 (qIsNaN(cacheDataEnd) && !qIsNaN(dataEnd)) ||
+                 qAbs(cacheScale-scale)>(cacheScale*1e-9));
+    if (!full) {
+        if (follow) {
+            dx = qRound((range.lower-cacheKeyLower)/scale);
+            if (qAbs(dx)>=area.width())
+                full = true;
+        } else if (range.lower!=cacheKeyLower)
+            full = true;
+    }
+
+    if (full) {
+        if (cacheImage.size()!=area.size())
+            cacheImage = QImage(area.size(),QImage::Format_ARGB32_Premultiplied);
+        cacheImage.fill(Qt::transparent);
+        cacheArea = area;
+        cacheValueRange = valueAxis->range();
+        cacheScale = scale;
+        cacheGeneration = plotData->generation();
+        cacheKeyLower = range.lower;
+        cacheValid = true;
+        renderStrip(area.left(),area.right()+1);
+        return;
+    }
+
+    int left = area.right()+1;
+    int right = area.right()+1;
+    if (dx!=0) {
+        shiftImage(cacheImage,dx);
+        cacheKeyLower += dx*scale;
+        if (dx>0) {
+            left = area.right()+1-dx;
+        } else {
+            left = area.left();
+            right = area.left()-dx;
+        }
+    }
+
+    // samples appended since last frame
+    if (dataEnd>cacheDataEnd) {
+        int tail = qRound(keyAxis->coordToPixel(cacheDataEnd))-stripMargin;
+        left = qMin(left,tail);
+        right = area.right()+1;
+    }
+
+    left = qMax(left,area.left());
+    right = qMin(right,area.right()+1);
+    if (right>left)
+        renderStrip(left,right);
+}
+
+void CCachedPlottable::draw(QCPPainter *painter)
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    if (!keyAxis || !mValueAxis) return;
+
+    // export - direct drawing, vector output and any scale
+    if (painter->modes().testFlag(QCPPainter::pmNoCaching) ||
+            painter->modes().testFlag(QCPPainter::pmVectorized)) {
+        if (keyAxis->range().size()>0.0)
+            drawKeyRange(painter,keyAxis->range());
+        return;
+    }
+
+    // no-op when image is already prepared in worker thread
+    renderCache();
+    if (cacheValid)
+        painter->drawImage(cacheArea.topLeft(),cacheImage);
+}
+
+void CCachedPlottable::renderStrip(int left, int right)
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QRect strip(left,cacheArea.top(),right-left,cacheArea.height());
+
+    QCPPainter painter(&cacheImage);
+    painter.translate(-cacheArea.topLeft());
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(strip,Qt::transparent);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.setClipRect(strip);
+
+    // slightly wider key range, so line joins and bar edges are outside of clipping
+    QCPRange keys(keyAxis->pixelToCoord(left-stripMargin),keyAxis->pixelToCoord(right+stripMargin));
+    keys.normalize();
+    drawKeyRange(&painter,keys);
+
+    cacheDataEnd = dataEndKey();
+}
+
+CLODGraph::CLODGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data, int column) :
+    CCachedPlottable(keyAxis,valueAxis,data)
+{
+    dataColumn = column;
+    setPen(QPen(Qt::blue,0));
+}
+
+int CLODGraph::column() const
+{
+    return dataColumn;
+}
+
+void CLODGraph::setColumn(int column)
+{
+    dataColumn = column;
+    invalidateCache();
+}
+
+QCPScatterStyle CLODGraph::scatterStyle() const
+{
+    return mScatterStyle;
+}
+
+void CLODGraph::setScatterStyle(const QCPScatterStyle &style)
+{
+    mScatterStyle = style;
+}
+
+bool CLODGraph::valueAt(double key, double &value) const
+{
+    int row = plotData->rowAt(key);
+    if (row<0 || dataColumn<0 || dataColumn>=plotData->columnCount()) return false;
+
+    value = plotData->column(dataColumn).value(row);
+    return !qIsNaN(value);
+}
+
+double CLODGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+    Q_UNUSED(details)
+
+    if ((onlySelectable && mSelectable==QCP::stNone) || plotData->isEmpty()) return -1;
+    if (!mKeyAxis || !mValueAxis) return -1;
+    if (!mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint())) return -1;
+
+    double value;
+    if (!valueAt(mKeyAxis.data()->pixelToCoord(pos.x()),value)) return -1;
+    return qAbs(pos.y()-mValueAxis.data()->coordToPixel(value));
+}
+
+QCPRange CLODGraph::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
+{
+    foundRange = (!plotData->isEmpty() && inSignDomain!=QCP::sdNegative);
+    if (!foundRange) return QCPRange();
+    return QCPRange(plotData->key(0),plotData->key(plotData->count()-1));
+}
+
+QCPRange CLODGraph::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain,
+                                  const QCPRange &inKeyRange) const
+{
+    Q_UNUSED(inSignDomain)
+
+    CMinMax range;
+    if (dataColumn<0 || dataColumn>=plotData->columnCount()) {
+        foundRange = false;
+        return QCPRange();
+    }
+    if (inKeyRange==QCPRange())
+        range = plotData->totalRange(dataColumn);
+    else
+        plotData->valueRange(dataColumn,inKeyRange,range);
+
+    foundRange = !qIsNaN(range.min);
+    if (!foundRange) return QCPRange();
+    return QCPRange(range.min,range.max);
+}
+
+void CLODGraph::getStepLines(QVector<QPointF> *lines, QVector<QPointF> *scatters, int first, int last) const
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    const CPlotColumn &data = plotData->column(dataColumn);
+    const CMinMaxIndex &index = data.index();
+
+    double keyPixelSpan = qAbs(keyAxis->coordToPixel(plotData->key(first))-
+                               keyAxis->coordToPixel(plotData->key(last)));
+    int bucketPoints = static_cast<int>(static_cast<double>(last-first+1)/qMax(1.0,keyPixelSpan));
+    int level = index.levelForBucket(bucketPoints);
+
+    // NaN values break lines, empty QPointF used as separator
+    double prevY = qQNaN();
+    if (level<0) {
+        // fine zoom - raw points, not more than few base blocks per pixel
+        lines->reserve(2*(last-first+1));
+        for (int i=first;i<=last;i++) {
+            double value = data.value(i);
+            if (qIsNaN(value)) {
+                if (!qIsNaN(prevY))
+                    lines->append(QPointF(qQNaN(),qQNaN()));
+                prevY = qQNaN();
+                continue;
+            }
+            double x = keyAxis->coordToPixel(plotData->key(i));
+            double y = valueAxis->coordToPixel(value);
+            if (!qIsNaN(prevY))
+                lines->append(QPointF(x,prevY));
+            lines->append(QPointF(x,y));
+            if (scatters!=NULL)
+                scatters->append(QPointF(x,y));
+            prevY = y;
+        }
+        return;
+    }
+
+    // one min/max pair per pyramid block, about 2 points per pixel
+    int size = index.blockSize(level);
+    lines->reserve(4*((last-first)/size+2));
+    int i = first;
+    while (i<=last) {
+        int bucketLast = qMin(((i/size)+1)*size-1,last);
+        CMinMax range;
+        if ((i % size)==0 && bucketLast==(i+size-1))
+            range = index.block(level,i/size);
+        else
+            index.valueRange(data,i,bucketLast,range);
+
+        if (!qIsNaN(range.min)) {
+            double key0 = plotData->key(i);
+            double key1 = plotData->key(bucketLast);
+            double x0 = keyAxis->coordToPixel(key0+(key1-key0)*0.25);
+            double x1 = keyAxis->coordToPixel(key0+(key1-key0)*0.75);
+            double yMin = valueAxis->coordToPixel(range.min);
+            double yMax = valueAxis->coordToPixel(range.max);
+            if (!qIsNaN(prevY))
+                lines->append(QPointF(x0,prevY));
+            lines->append(QPointF(x0,yMin));
+            lines->append(QPointF(x1,yMin));
+            lines->append(QPointF(x1,yMax));
+            prevY = yMax;
+        }
+        i = bucketLast+1;
+    }
+}
+
+double CLODGraph::dataEndKey() const
+{
+    if (plotData->isEmpty()) return qQNaN();
+    return plotData->key(plotData->count()-1);
+}
+
+void CLODGraph::drawKeyRange(QCPPainter *painter, const QCPRange &range)
+{
+    if (!mKeyAxis || !mValueAxis || plotData->isEmpty()) return;
+    if (dataColumn<0 || dataColumn>=plotData->columnCount()) return;
+
+    // rows in range, with one row outside at both sides for continuous lines
+    int first = qMax(0,plotData->findBegin(range.lower)-1);
+    int last = qMin(plotData->count()-1,plotData->findEnd(range.upper));
+    if (first>last) return;
+
+    QVector<QPointF> lines, scatters;
+    getStepLines(&lines,(mScatterStyle.isNone() ? NULL : &scatters),first,last);
+
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->setBrush(Qt::NoBrush);
+    int segmentStart = 0;
+    for (int i=0;i<=lines.count();i++) {
+        if (i<lines.count() && !qIsNaN(lines.at(i).x())) continue;
+        if ((i-segmentStart)>1)
+            painter->drawPolyline(lines.constData()+segmentStart,i-segmentStart);
+        segmentStart = i+1;
+    }
+
+    if (!scatters.isEmpty()) {
+        applyScattersAntialiasingHint(painter);
+        mScatterStyle.applyTo(painter,mPen);
+        for (int i=0;i<scatters.count();i++)
+            mScatterStyle.drawShape(painter,scatters.at(i).x(),scatters.at(i).y());
+    }
+}
+
+void CLODGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->drawLine(QLineF(rect.left(),rect.top()+rect.height()/2.0,
+                             rect.right()+5,rect.top()+rect.height()/2.0));
+}
+
+CDigitalGraph::CDigitalGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data, int digital) :
+    CCachedPlottable(keyAxis,valueAxis,data)
+{
+    dataDigital = digital;
+    setPen(QPen(Qt::blue,0));
+    setBrush(QColor(0,0,255,60));
+}
+
+int CDigitalGraph::digital() const
+{
+    return dataDigital;
+}
+
+void CDigitalGraph::setDigital(int digital)
+{
+    dataDigital = digital;
+    invalidateCache();
+}
+
+bool CDigitalGraph::isValid() const
+{
+    return (dataDigital>=0 && dataDigital<plotData->digitalCount());
+}
+
+double CDigitalGraph::selectTest(const QPointF &pos, bool onlySelectable, QVariant *details) const
+{
+    Q_UNUSED(details)
+
+    if ((onlySelectable && mSelectable==QCP::stNone) || !isValid()) return -1;
+    if (!mKeyAxis || !mValueAxis) return -1;
+    if (!mKeyAxis.data()->axisRect()->rect().contains(pos.toPoint())) return -1;
+
+    double value;
+    if (!plotData->digital(dataDigital).valueAt(mKeyAxis.data()->pixelToCoord(pos.x()),value)) return -1;
+    return qAbs(pos.y()-mValueAxis.data()->coordToPixel(value));
+}
+
+QCPRange CDigitalGraph::getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain) const
+{
+    foundRange = (isValid() && !plotData->digital(dataDigital).isEmpty() && inSignDomain!=QCP::sdNegative);
+    if (!foundRange) return QCPRange();
+    return plotData->digital(dataDigital).keyRange();
+}
+
+QCPRange CDigitalGraph::getValueRange(bool &foundRange, QCP::SignDomain inSignDomain,
+                                      const QCPRange &inKeyRange) const
+{
+    Q_UNUSED(inKeyRange)
+
+    foundRange = (isValid() && !plotData->digital(dataDigital).isEmpty() && inSignDomain!=QCP::sdNegative);
+    if (!foundRange) return QCPRange();
+    if (inSignDomain==QCP::sdPositive)
+        return QCPRange(1.0,1.0);
+    return QCPRange(0.0,1.0);
+}
+
+double CDigitalGraph::dataEndKey() const
+{
+    if (!isValid() || plotData->digital(dataDigital).isEmpty()) return qQNaN();
+    return plotData->digital(dataDigital).lastKey();
+}
+
+void CDigitalGraph::drawKeyRange(QCPPainter *painter, const QCPRange &range)
+{
+    QCPAxis *keyAxis = mKeyAxis.data();
+    QCPAxis *valueAxis = mValueAxis.data();
+    if (!keyAxis || !valueAxis || !isValid()) return;
+
+    const CDigitalData &data = plotData->digital(dataDigital);
+    if (data.isEmpty()) return;
+
+    if (range.size()<=0.0 || range.upper<data.edgeKey(0) || range.lower>data.lastKey()) return;
+
+    double y0 = valueAxis->coordToPixel(0.0);
+    double y1 = valueAxis->coordToPixel(1.0);
+
+    // high level bars, bars closer than one pixel are merged, so drawing cost follows plot width
+    QVector<QRectF> bars;
+    double barStart = qQNaN();
+    double barEnd = qQNaN();
+    for (int i=qMax(0,data.edgeIndex(range.lower));i<data.count() && data.edgeKey(i)<=range.upper;i++) {
+        if (!data.edgeLevel(i)) continue;
+
+        double end = data.lastKey();
+        if ((i+1)<data.count())
+            end = data.edgeKey(i+1);
+        double x0 = keyAxis->coordToPixel(qMax(data.edgeKey(i),range.lower));
+        double x1 = keyAxis->coordToPixel(qMin(end,range.upper));
+
+        if (!qIsNaN(barStart) && (x0-barEnd)<1.0) {
+            barEnd = qMax(barEnd,x1);
+            continue;
+        }
+        if (!qIsNaN(barStart))
+            bars.append(QRectF(QPointF(barStart,y1),QPointF(qMax(barEnd,barStart+1.0),y0)));
+        barStart = x0;
+        barEnd = x1;
+    }
+    if (!qIsNaN(barStart))
+        bars.append(QRectF(QPointF(barStart,y1),QPointF(qMax(barEnd,barStart+1.0),y0)));
+
+    applyDefaultAntialiasingHint(painter);
+
+    // low level baseline over whole signal
+    painter->setPen(mPen);
+    painter->setBrush(Qt::NoBrush);
+    painter->drawLine(QLineF(keyAxis->coordToPixel(qMax(range.lower,data.edgeKey(0))),y0,
+                             keyAxis->coordToPixel(qMin(range.upper,data.lastKey())),y0));
+
+    painter->setBrush(mBrush);
+    painter->drawRects(bars);
+}
+
+void CDigitalGraph::drawLegendIcon(QCPPainter *painter, const QRectF &rect) const
+{
+    applyDefaultAntialiasingHint(painter);
+    painter->setPen(mPen);
+    painter->setBrush(mBrush);
+    painter->drawRect(rect.adjusted(0,rect.height()*0.25,-rect.width()*0.5,-rect.height()*0.25));
+}
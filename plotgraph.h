@@ -0,0 +1,102 @@
+#ifndef PLOTGRAPH_H
+#define PLOTGRAPH_H
+
+#include "qcustomplot-source/qcustomplot.h"
+#include "plotdata.h"
+
+class CCachedPlottable : public QCPAbstractPlottable
+{
+    Q_OBJECT
+public:
+    // data rendered into image tile, which may be prepared in worker thread before replot,
+    // in follow mode tile is shifted on key range scroll, only exposed strip and tail of data are drawn
+    explicit CCachedPlottable(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data);
+
+    bool followMode() const;
+    void setFollowMode(bool enabled);
+    void invalidateCache();
+
+    // thread-safe for different plottables, while plot data and axes are not modified
+    void renderCache();
+
+protected:
+    const CPlotData *plotData;
+
+    virtual void draw(QCPPainter *painter) Q_DECL_OVERRIDE;
+    virtual void drawKeyRange(QCPPainter *painter, const QCPRange &range) = 0;
+    virtual double dataEndKey() const = 0;
+
+private:
+    bool follow;
+    bool cacheValid;
+    QImage cacheImage;
+    QRect cacheArea;
+    QCPRange cacheValueRange;
+    double cacheKeyLower;
+    double cacheScale;
+    double cacheDataEnd;
+    int cacheGeneration;
+
+    void renderStrip(int left, int right);
+
+};
+
+class CLODGraph : public CCachedPlottable
+{
+    Q_OBJECT
+public:
+    // adapter for one value column of shared plot data, with QCPGraph-like drawing
+    explicit CLODGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data, int column);
+
+    int column() const;
+    void setColumn(int column);
+    QCPScatterStyle scatterStyle() const;
+    void setScatterStyle(const QCPScatterStyle &style);
+    bool valueAt(double key, double &value) const;
+
+    virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const Q_DECL_OVERRIDE;
+    virtual QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const Q_DECL_OVERRIDE;
+    virtual QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth,
+                                   const QCPRange &inKeyRange=QCPRange()) const Q_DECL_OVERRIDE;
+
+protected:
+    virtual void drawKeyRange(QCPPainter *painter, const QCPRange &range) Q_DECL_OVERRIDE;
+    virtual double dataEndKey() const Q_DECL_OVERRIDE;
+    virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+
+private:
+    int dataColumn;
+    QCPScatterStyle mScatterStyle;
+
+    void getStepLines(QVector<QPointF> *lines, QVector<QPointF> *scatters, int first, int last) const;
+
+};
+
+class CDigitalGraph : public CCachedPlottable
+{
+    Q_OBJECT
+public:
+    // adapter for run-length BOOL channel of shared plot data
+    explicit CDigitalGraph(QCPAxis *keyAxis, QCPAxis *valueAxis, const CPlotData *data, int digital);
+
+    int digital() const;
+    void setDigital(int digital);
+
+    virtual double selectTest(const QPointF &pos, bool onlySelectable, QVariant *details=0) const Q_DECL_OVERRIDE;
+    virtual QCPRange getKeyRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth) const Q_DECL_OVERRIDE;
+    virtual QCPRange getValueRange(bool &foundRange, QCP::SignDomain inSignDomain=QCP::sdBoth,
+                                   const QCPRange &inKeyRange=QCPRange()) const Q_DECL_OVERRIDE;
+
+protected:
+    virtual void drawKeyRange(QCPPainter *painter, const QCPRange &range) Q_DECL_OVERRIDE;
+    virtual double dataEndKey() const Q_DECL_OVERRIDE;
+    virtual void drawLegendIcon(QCPPainter *painter, const QRectF &rect) const Q_DECL_OVERRIDE;
+
+private:
+    int dataDigital;
+
+    bool isValid() const;
+
+};
+
+#endif // PLOTGRAPH_H
@@ -0,0 +1,252 @@
+#include "plotindex.h"
+#include "plotdata.h"
+
+const static int baseBlockSize = 16; // data points in level 0 block, partial blocks scanned directly
+
+CMinMax::CMinMax()
+{
+    min = qQNaN();
+    max = qQNaN();
+}
+
+CMinMax::CMinMax(double value)
+{
+    min = value;
+    max = value;
+}
+
+void CMinMax::merge(double value)
+{
+    if (qIsNaN(min) || value<min) min = value;
+    if (qIsNaN(max) || value>max) max = value;
+}
+
+void CMinMax::merge(const CMinMax &other)
+{
+    if (qIsNaN(other.min)) return;
+    if (qIsNaN(min) || other.min<min) min = other.min;
+    if (qIsNaN(max) || other.max>max) max = other.max;
+}
+
+CMinMaxIndex::CMinMaxIndex()
+{
+    clear();
+}
+
+void CMinMaxIndex::clear()
+{
+    levels.clear();
+    levels.append(QVector<CMinMax>());
+    totalRange = CMinMax();
+    cnt = 0;
+}
+
+void CMinMaxIndex::append(double value)
+{
+    totalRange.merge(value);
+
+    for (int level=0;level<levels.count();level++) {
+        int block = cnt / (baseBlockSize << level);
+        QVector<CMinMax> &blocks = levels[level];
+        if (block>=blocks.count())
+            blocks.append(CMinMax(value));
+        else
+            blocks[block].merge(value);
+    }
+    cnt++;
+
+    if (levels.last().count()>1)
+        addLevel();
+}
+
+void CMinMaxIndex::addLevel()
+{
+    const QVector<CMinMax> &top = levels.last();
+    QVector<CMinMax> next;
+    next.reserve((top.count()+1)/2);
+    for (int i=0;i<top.count();i+=2) {
+        CMinMax block = top.at(i);
+        if ((i+1)<top.count())
+            block.merge(top.at(i+1));
+        next.append(block);
+    }
+    levels.append(next);
+}
+
+void CMinMaxIndex::rebuild(const CPlotColumn &data)
+{
+    clear();
+    for (int i=0;i<data.count();i++)
+        append(data.value(i));
+}
+
+int CMinMaxIndex::count() const
+{
+    return cnt;
+}
+
+bool CMinMaxIndex::isEmpty() const
+{
+    return (cnt==0);
+}
+
+CMinMax CMinMaxIndex::total() const
+{
+    return totalRange;
+}
+
+qint64 CMinMaxIndex::memoryUsage() const
+{
+    qint64 res = 0;
+    for (int i=0;i<levels.count();i++)
+        res += levels.at(i).capacity()*static_cast<qint64>(sizeof(CMinMax));
+    return res;
+}
+
+int CMinMaxIndex::levelCount() const
+{
+    return levels.count();
+}
+
+int CMinMaxIndex::blockSize(int level) const
+{
+    return (baseBlockSize << level);
+}
+
+int CMinMaxIndex::levelForBucket(int points) const
+{
+    // largest decimation level with blocks not exceeding requested bucket size, -1 for raw data
+    int level = -1;
+    while ((level+1)<levels.count() && blockSize(level+1)<=points)
+        level++;
+    return level;
+}
+
+CMinMax CMinMaxIndex::block(int level, int idx) const
+{
+    if (level<0 || level>=levels.count()) return CMinMax();
+    if (idx<0 || idx>=levels.at(level).count()) return CMinMax();
+    return levels.at(level).at(idx);
+}
+
+bool CMinMaxIndex::valueRange(const CPlotColumn &data, int first, int last, CMinMax &range) const
+{
+    range = CMinMax();
+    if (first<0) first = 0;
+    if (last>=cnt) last = cnt-1;
+    if (last>=data.count()) last = data.count()-1;
+    if (first>last) return false;
+
+    int i = first;
+    while (i<=last) {
+        // unaligned head and tail points are scanned directly
+        if ((i % baseBlockSize)!=0 || (i+baseBlockSize-1)>last) {
+            range.merge(data.value(i));
+            i++;
+            continue;
+        }
+
+        // largest aligned block that fits in range
+        int level = 0;
+        while ((level+1)<levels.count()) {
+            int size = baseBlockSize << (level+1);
+            if ((i % size)!=0 || (i+size-1)>last) break;
+            level++;
+        }
+        int size = baseBlockSize << level;
+        range.merge(levels.at(level).at(i/size));
+        i += size;
+    }
+    return true;
+}
+
+CSums::CSums()
+{
+    sum = 0.0;
+    sumSq = 0.0;
+    integral = 0.0;
+    count = 0;
+}
+
+CSumIndex::CSumIndex()
+{
+    clear();
+}
+
+void CSumIndex::clear()
+{
+    blocks.clear();
+    running = CSums();
+    base = qQNaN();
+    lastKey = qQNaN();
+    lastValue = qQNaN();
+    cnt = 0;
+}
+
+void CSumIndex::add(CSums &sums, double prevKey, double prevValue, int row, double key, double value) const
+{
+    // interval from previous row is closed by this row
+    if (row>0 && !qIsNaN(prevValue))
+        sums.integral += prevValue*(key-prevKey);
+
+    if (qIsNaN(value)) return;
+    double v = value-base;
+    sums.sum += v;
+    sums.sumSq += v*v;
+    sums.count++;
+}
+
+void CSumIndex::append(double key, double value)
+{
+    if ((cnt % baseBlockSize)==0)
+        blocks.append(running);
+    if (qIsNaN(base) && !qIsNaN(value))
+        base = value;
+
+    add(running,lastKey,lastValue,cnt,key,value);
+    lastKey = key;
+    lastValue = value;
+    cnt++;
+}
+
+void CSumIndex::rebuild(const QVector<double> &keys, const CPlotColumn &data)
+{
+    clear();
+    for (int i=0;i<data.count() && i<keys.count();i++)
+        append(keys.at(i),data.value(i));
+}
+
+int CSumIndex::count() const
+{
+    return cnt;
+}
+
+double CSumIndex::origin() const
+{
+    if (qIsNaN(base)) return 0.0;
+    return base;
+}
+
+qint64 CSumIndex::memoryUsage() const
+{
+    return blocks.capacity()*static_cast<qint64>(sizeof(CSums));
+}
+
+CSums CSumIndex::prefix(const QVector<double> &keys, const CPlotColumn &data, int row) const
+{
+    if (row<=0) return CSums();
+    if (row>=cnt) return running;
+
+    int block = row/baseBlockSize;
+    CSums res = blocks.at(block);
+    for (int i=block*baseBlockSize;i<row;i++) {
+        double prevKey = qQNaN();
+        double prevValue = qQNaN();
+        if (i>0) {
+            prevKey = keys.at(i-1);
+            prevValue = data.value(i-1);
+        }
+        add(res,prevKey,prevValue,i,keys.at(i),data.value(i));
+    }
+    return res;
+}
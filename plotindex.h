@@ -0,0 +1,90 @@
+#ifndef PLOTINDEX_H
+#define PLOTINDEX_H
+
+#include <QVector>
+
+class CMinMax
+{
+public:
+    double min;
+    double max;
+    CMinMax();
+    CMinMax(double value);
+    void merge(double value);
+    void merge(const CMinMax& other);
+};
+Q_DECLARE_TYPEINFO(CMinMax, Q_PRIMITIVE_TYPE);
+
+class CPlotColumn;
+
+class CMinMaxIndex
+{
+public:
+    CMinMaxIndex();
+
+    void clear();
+    void append(double value);
+    void rebuild(const CPlotColumn &data);
+
+    int count() const;
+    bool isEmpty() const;
+    CMinMax total() const;
+    qint64 memoryUsage() const;
+
+    // decimation levels access, for level-of-detail rendering
+    int levelCount() const;
+    int blockSize(int level) const;
+    int levelForBucket(int points) const;
+    CMinMax block(int level, int idx) const;
+
+    // values range of data points [first..last], O(log n)
+    bool valueRange(const CPlotColumn &data, int first, int last, CMinMax &range) const;
+
+private:
+    // level L block covers (baseBlockSize << L) data points
+    QVector<QVector<CMinMax> > levels;
+    CMinMax totalRange;
+    int cnt;
+
+    void addLevel();
+};
+
+class CSums
+{
+public:
+    double sum; // values relative to index origin
+    double sumSq;
+    double integral; // step-hold, from first row key to last row key
+    qint64 count; // non-NaN values
+    CSums();
+};
+Q_DECLARE_TYPEINFO(CSums, Q_PRIMITIVE_TYPE);
+
+class CSumIndex
+{
+public:
+    CSumIndex();
+
+    void clear();
+    void append(double key, double value);
+    void rebuild(const QVector<double> &keys, const CPlotColumn &data);
+
+    int count() const;
+    double origin() const;
+    qint64 memoryUsage() const;
+
+    // cumulative sums of rows [0..row), block prefix and scan of partial block
+    CSums prefix(const QVector<double> &keys, const CPlotColumn &data, int row) const;
+
+private:
+    QVector<CSums> blocks; // cumulative sums at each block start
+    CSums running;
+    double base; // first valid value, reduces cancellation in sum of squares
+    double lastKey;
+    double lastValue;
+    int cnt;
+
+    void add(CSums &sums, double prevKey, double prevValue, int row, double key, double value) const;
+};
+
+#endif // PLOTINDEX_H
@@ -0,0 +1,566 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSaveFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSocketNotifier>
+#include <QTextStream>
+#include <stdio.h>
+#include "recorderd.h"
+#include "global.h"
+
+#ifdef LINUX
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static int sigFd[2] = { -1, -1 };
+
+static void daemonSigHandler(int sig)
+{
+    // only async-signal-safe write here, signal is processed in event loop
+    char c = static_cast<char>(sig);
+    ssize_t res = ::write(sigFd[0],&c,1);
+    Q_UNUSED(res);
+}
+#endif
+
+CRecorderUnit::CRecorderUnit(const QString &aFileName, QObject *parent) :
+    QObject(parent)
+{
+    plrFile = aFileName;
+    ip.clear();
+    rack = 0;
+    slot = 0;
+    acqInterval = 100;
+    watchpoints.clear();
+    state = usStopped;
+    stopping = false;
+    connected = false;
+    scans = 0;
+    reconnects = 0;
+    lastError.clear();
+
+    plc = new CPLC();
+    plcThread = new QThread();
+    csvHandler = new CCSVHandler(this);
+    csvReader = new CSampleReader(plc->sampleBus(),CSampleReader::spBlock,this);
+    liveReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    liveSegment = new CLiveSegment(this);
+    streamReader = new CSampleReader(plc->sampleBus(),CSampleReader::spDropOldest,this);
+    streamServer = new CStreamServer(this);
+
+    reconnectTimer = new QTimer(this);
+    reconnectTimer->setSingleShot(true);
+    connect(reconnectTimer,SIGNAL(timeout()),this,SLOT(connectPLC()));
+
+    plc->moveToThread(plcThread);
+    plcThread->start();
+    QMetaObject::invokeMethod(plc,"correctToThread",Qt::QueuedConnection);
+
+    connect(plc,SIGNAL(plcError(QString,bool)),this,SLOT(plcError(QString,bool)),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcConnectFailed()),this,SLOT(plcFailed()),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcStartFailed()),this,SLOT(plcFailed()),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcOnConnect()),this,SLOT(plcConnected()),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcOnDisconnect()),this,SLOT(plcDisconnected()),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcOnStart()),this,SLOT(plcStarted()),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcOnStop()),this,SLOT(plcStopped()),Qt::QueuedConnection);
+
+    connect(this,SIGNAL(plcSetAddress(QString,int,int,int)),plc,SLOT(plcSetAddress(QString,int,int,int)));
+    connect(this,SIGNAL(plcSetAcqInterval(int)),plc,SLOT(plcSetAcqInterval(int)));
+    connect(this,SIGNAL(plcSetWatchpoints(CWPList)),plc,SLOT(plcSetWatchpoints(CWPList)));
+    connect(this,SIGNAL(plcSetRetryParams(int,int,int)),plc,SLOT(plcSetRetryParams(int,int,int)));
+    connect(this,SIGNAL(plcConnect()),plc,SLOT(plcConnect()));
+    connect(this,SIGNAL(plcStart()),plc,SLOT(plcStart()));
+    connect(this,SIGNAL(plcDisconnect()),plc,SLOT(plcDisconnect()));
+
+    connect(csvReader,SIGNAL(frameReady(CWPList,QDateTime)),this,SLOT(csvFrame(CWPList,QDateTime)));
+    connect(csvHandler,SIGNAL(errorMessage(QString)),this,SLOT(csvError(QString)));
+    connect(csvHandler,SIGNAL(appendLog(QString)),this,SLOT(appendLog(QString)));
+    connect(liveReader,SIGNAL(frameReady(CWPList,QDateTime)),
+            liveSegment,SLOT(publish(CWPList,QDateTime)));
+    connect(liveSegment,SIGNAL(errorMessage(QString)),this,SLOT(appendLog(QString)));
+    connect(streamReader,SIGNAL(frameReady(CWPList,QDateTime)),
+            streamServer,SLOT(publish(CWPList,QDateTime)));
+    connect(streamServer,SIGNAL(logMessage(QString)),this,SLOT(appendLog(QString)));
+    connect(streamServer,SIGNAL(brokerSubscribe(int,CWPList,int)),plc,SLOT(plcSubscribe(int,CWPList,int)));
+    connect(streamServer,SIGNAL(brokerUnsubscribe(int)),plc,SLOT(plcUnsubscribe(int)));
+    connect(streamServer,SIGNAL(brokerConsumed(int)),plc,SLOT(plcSubscriptionConsumed(int)));
+    connect(plc,SIGNAL(plcSubscriptionData(int,CWPList,QDateTime)),
+            streamServer,SLOT(brokerData(int,CWPList,QDateTime)),Qt::QueuedConnection);
+    connect(plc,SIGNAL(plcSubscriptionFailed(int,QString)),
+            streamServer,SLOT(brokerFailed(int,QString)),Qt::QueuedConnection);
+}
+
+CRecorderUnit::~CRecorderUnit()
+{
+    stop();
+    // readers are detached from sample bus before bus is deleted with PLC,
+    // PLC and its timers are deleted in own thread when thread finishes
+    delete csvReader;
+    delete liveReader;
+    delete streamReader;
+    connect(plcThread,SIGNAL(finished()),plc,SLOT(deleteLater()));
+    plcThread->quit();
+    plcThread->wait();
+    delete plcThread;
+}
+
+bool CRecorderUnit::load()
+{
+    QFile f(plrFile);
+    if (!f.open(QIODevice::ReadOnly)) {
+        lastError = trUtf8("Unable to load file %1.").arg(plrFile);
+        return false;
+    }
+
+    QDataStream in(&f);
+    in.setVersion(QDataStream::Qt_4_8);
+    int v, cnt;
+    in >> v;
+    if (v!=PLR_VERSION) {
+        lastError = trUtf8("Unable to load file %1. Incompatible version.").arg(plrFile);
+        return false;
+    }
+    in >> ip >> rack >> slot >> acqInterval;
+    in >> cnt >> watchpoints;
+    f.close();
+
+    if ((in.status()!=QDataStream::Ok) || watchpoints.isEmpty()) {
+        lastError = trUtf8("Unable to load file %1. Variables list is empty or corrupted.").arg(plrFile);
+        return false;
+    }
+    return true;
+}
+
+void CRecorderUnit::setFileTemplate(const QString &aTemplate)
+{
+    csvHandler->setFileTemplate(aTemplate);
+    streamServer->setFileTemplate(aTemplate);
+}
+
+void CRecorderUnit::setLiveSegmentName(const QString &aName)
+{
+    liveSegment->setName(aName);
+}
+
+bool CRecorderUnit::setStreamName(const QString &aName, bool broker)
+{
+    streamServer->setBrokerEnabled(broker);
+    return streamServer->listen(aName);
+}
+
+QString CRecorderUnit::fileName() const
+{
+    return plrFile;
+}
+
+QString CRecorderUnit::errorString() const
+{
+    return lastError;
+}
+
+QJsonObject CRecorderUnit::status() const
+{
+    QString st;
+    switch (state) {
+        case usConnecting: st = QString("connecting"); break;
+        case usWaiting: st = QString("waiting"); break;
+        case usRecording: st = QString("recording"); break;
+        case usStopped: st = QString("stopped"); break;
+    }
+
+    QJsonObject res;
+    res.insert("file",plrFile);
+    res.insert("plc",QString("%1 %2/%3").arg(ip).arg(rack).arg(slot));
+    res.insert("state",st);
+    res.insert("csv",csvHandler->fileName());
+    res.insert("live",(liveSegment->isOpen() ? liveSegment->name() : QString()));
+    res.insert("stream",(streamServer->isListening() ? streamServer->name() : QString()));
+    res.insert("clients",streamServer->clientCount());
+    res.insert("scans",static_cast<double>(scans));
+    res.insert("lastScan",lastScan.toString(Qt::ISODate));
+    res.insert("queue",csvReader->pending());
+    res.insert("dropped",csvReader->dropped());
+    res.insert("reconnects",reconnects);
+    res.insert("lastError",lastError);
+    res.insert("lastErrorTime",lastErrorTime.toString(Qt::ISODate));
+    return res;
+}
+
+void CRecorderUnit::setError(const QString &msg)
+{
+    lastError = msg;
+    lastErrorTime = QDateTime::currentDateTime();
+    appendLog(msg);
+}
+
+void CRecorderUnit::start()
+{
+    stopping = false;
+    connectPLC();
+}
+
+void CRecorderUnit::stop()
+{
+    if (stopping) return;
+
+    stopping = true;
+    reconnectTimer->stop();
+    QMetaObject::invokeMethod(plc,"plcDisconnect",Qt::BlockingQueuedConnection);
+
+    // scans already in ring are written before file is closed
+    QCoreApplication::processEvents();
+    csvHandler->stopClose();
+    liveSegment->close();
+    streamServer->close();
+    state = usStopped;
+}
+
+void CRecorderUnit::rotate()
+{
+    if (state==usRecording)
+        csvHandler->rotateFile();
+}
+
+void CRecorderUnit::sync()
+{
+    // retry CSV opening after failure, flush and rotate at 0:00 otherwise
+    if ((state==usRecording) && csvHandler->fileName().isEmpty())
+        csvHandler->rotateFile();
+    else
+        csvHandler->timerSync();
+}
+
+void CRecorderUnit::connectPLC()
+{
+    if (stopping) return;
+    state = usConnecting;
+    emit plcSetWatchpoints(watchpoints);
+    emit plcSetRetryParams(gSet->tmMaxRecErrorCount, gSet->tmMaxConnectRetryCount, gSet->tmWaitReconnect);
+    emit plcSetAcqInterval(acqInterval);
+    emit plcSetAddress(ip, rack, slot, gSet->tmTCPTimeout);
+    emit plcConnect();
+}
+
+void CRecorderUnit::plcError(const QString &msg, bool critical)
+{
+    if (stopping) return;
+    setError(msg);
+
+    // list parsing errors do not emit failure signal
+    if (critical && (state==usConnecting))
+        plcFailed();
+}
+
+void CRecorderUnit::plcConnected()
+{
+    connected = true;
+    if (stopping) return;
+    appendLog(trUtf8("Connected to PLC."));
+    emit plcStart();
+}
+
+void CRecorderUnit::plcDisconnected()
+{
+    connected = false;
+    appendLog(trUtf8("Disconnected from PLC."));
+    csvHandler->stopClose();
+    plcFailed();
+}
+
+void CRecorderUnit::plcStarted()
+{
+    if (stopping) return;
+    state = usRecording;
+    csvReader->resetDropped();
+    appendLog(trUtf8("Activating ONLINE."));
+    csvHandler->rotateFile();
+}
+
+void CRecorderUnit::plcStopped()
+{
+    appendLog(trUtf8("Deactivating ONLINE."));
+    csvHandler->stopClose();
+    liveSegment->close();
+}
+
+void CRecorderUnit::plcFailed()
+{
+    if (stopping) return;
+    state = usWaiting;
+    if (connected) {
+        // start failed, reconnect is scheduled on disconnection
+        emit plcDisconnect();
+        return;
+    }
+
+    // daemon retries forever, total retry count from settings is for GUI only
+    if (!reconnectTimer->isActive()) {
+        reconnects++;
+        reconnectTimer->setInterval(qMax(1,gSet->tmWaitReconnect)*1000);
+        reconnectTimer->start();
+    }
+}
+
+void CRecorderUnit::csvFrame(const CWPList &wp, const QDateTime &stm)
+{
+    scans++;
+    lastScan = stm;
+    csvHandler->addData(wp,stm);
+}
+
+void CRecorderUnit::csvError(const QString &msg)
+{
+    lastError = msg;
+    lastErrorTime = QDateTime::currentDateTime();
+}
+
+void CRecorderUnit::appendLog(const QString &msg)
+{
+    emit logMessage(QString("%1: %2").arg(QFileInfo(plrFile).fileName(),msg));
+}
+
+CRecorderDaemon::CRecorderDaemon(QObject *parent) :
+    QObject(parent)
+{
+    units.clear();
+    statusFile.clear();
+    startTime = QDateTime::currentDateTime();
+    sigNotifier = NULL;
+    statusFailed = false;
+    shuttingDown = false;
+
+    syncTimer = new QTimer(this);
+    syncTimer->setInterval(60000);
+    connect(syncTimer,SIGNAL(timeout()),this,SLOT(syncUnits()));
+
+    statusTimer = new QTimer(this);
+    connect(statusTimer,SIGNAL(timeout()),this,SLOT(writeStatus()));
+}
+
+CRecorderDaemon::~CRecorderDaemon()
+{
+    shutdown();
+}
+
+bool CRecorderDaemon::init(const QStringList &arguments)
+{
+    QCommandLineParser parser;
+    parser.setApplicationDescription(trUtf8("Headless PLC recorder."));
+    parser.addHelpOption();
+    QCommandLineOption settingsOption("settings",trUtf8("Settings ini file, user settings of GUI by default."),
+                                      QString("file"));
+    QCommandLineOption csvDirOption("csv-dir",trUtf8("Directory for CSV files."),QString("dir"));
+    QCommandLineOption templateOption("template",trUtf8("CSV file name prefix."),QString("name"));
+    QCommandLineOption liveOption("live",trUtf8("Publish live data to shared memory segment with this name."),
+                                  QString("name"));
+    QCommandLineOption streamOption("stream",trUtf8("Serve live data and history on local socket with this name."),
+                                    QString("name"));
+    QCommandLineOption brokerOption("broker",trUtf8("Stream clients may add own variables to PLC scan."));
+    QCommandLineOption statusOption("status",trUtf8("Status JSON file, plcrecorderd.json in CSV directory by default."),
+                                    QString("file"));
+    QCommandLineOption statusIntervalOption("status-interval",trUtf8("Status update interval in seconds."),
+                                            QString("sec"),QString("5"));
+    parser.addOption(settingsOption);
+    parser.addOption(csvDirOption);
+    parser.addOption(templateOption);
+    parser.addOption(liveOption);
+    parser.addOption(streamOption);
+    parser.addOption(brokerOption);
+    parser.addOption(statusOption);
+    parser.addOption(statusIntervalOption);
+    parser.addPositionalArgument("files",trUtf8("PLC recorder connection files (*.plr)."),QString("files..."));
+    parser.process(arguments);
+
+    const QStringList files = parser.positionalArguments();
+    if (files.isEmpty()) {
+        appendLog(trUtf8("No connection files specified."));
+        return false;
+    }
+
+    gSet->loadSettings(parser.value(settingsOption));
+    if (parser.isSet(csvDirOption))
+        gSet->outputCSVDir = parser.value(csvDirOption);
+    if (parser.isSet(templateOption))
+        gSet->outputFileTemplate = parser.value(templateOption);
+    if (parser.isSet(liveOption)) {
+        gSet->liveSegment = true;
+        gSet->liveSegmentName = parser.value(liveOption);
+    }
+    if (parser.isSet(streamOption)) {
+        gSet->streamServer = true;
+        gSet->streamServerName = parser.value(streamOption);
+    }
+    if (parser.isSet(brokerOption))
+        gSet->streamBroker = true;
+    if (!QDir(gSet->outputCSVDir).exists()) {
+        appendLog(trUtf8("Directory for creating CSV files not found: %1.").arg(gSet->outputCSVDir));
+        return false;
+    }
+
+    statusFile = parser.value(statusOption);
+    if (statusFile.isEmpty())
+        statusFile = QDir(gSet->outputCSVDir).filePath(QString("plcrecorderd.json"));
+
+    for (int i=0;i<files.count();i++) {
+        CRecorderUnit* unit = new CRecorderUnit(files.at(i),this);
+        connect(unit,SIGNAL(logMessage(QString)),this,SLOT(appendLog(QString)));
+        if (!unit->load()) {
+            appendLog(unit->errorString());
+            return false;
+        }
+
+        // CSV files of several connections are distinguished by .plr name
+        QString base = QFileInfo(files.at(i)).completeBaseName();
+        if (gSet->outputFileTemplate.isEmpty())
+            unit->setFileTemplate(base);
+        else if (files.count()>1)
+            unit->setFileTemplate(QString("%1_%2").arg(gSet->outputFileTemplate,base));
+        else
+            unit->setFileTemplate(gSet->outputFileTemplate);
+        if (gSet->liveSegment && !gSet->liveSegmentName.isEmpty()) {
+            if (files.count()>1)
+                unit->setLiveSegmentName(QString("%1_%2").arg(gSet->liveSegmentName,base));
+            else
+                unit->setLiveSegmentName(gSet->liveSegmentName);
+        }
+        if (gSet->streamServer && !gSet->streamServerName.isEmpty()) {
+            bool ok;
+            if (files.count()>1)
+                ok = unit->setStreamName(QString("%1_%2").arg(gSet->streamServerName,base),gSet->streamBroker);
+            else
+                ok = unit->setStreamName(gSet->streamServerName,gSet->streamBroker);
+            if (!ok) return false;
+        }
+        units << unit;
+    }
+
+    if (!setupSignals())
+        appendLog(trUtf8("Unable to install signal handlers."));
+
+    statusTimer->setInterval(qMax(1,parser.value(statusIntervalOption).toInt())*1000);
+    statusTimer->start();
+    syncTimer->start();
+
+    for (int i=0;i<units.count();i++)
+        units.at(i)->start();
+    appendLog(trUtf8("Recording %1 connections to %2.").arg(units.count()).arg(gSet->outputCSVDir));
+    writeStatus();
+    return true;
+}
+
+bool CRecorderDaemon::setupSignals()
+{
+#ifdef LINUX
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, sigFd)!=0)
+        return false;
+    sigNotifier = new QSocketNotifier(sigFd[1],QSocketNotifier::Read,this);
+    connect(sigNotifier,SIGNAL(activated(int)),this,SLOT(sysSignal()));
+
+    struct sigaction sa;
+    sa.sa_handler = daemonSigHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = 0;
+    sa.sa_flags |= SA_RESTART;
+    bool res = true;
+    res = res && (sigaction(SIGTERM, &sa, NULL)==0);
+    res = res && (sigaction(SIGINT, &sa, NULL)==0);
+    res = res && (sigaction(SIGHUP, &sa, NULL)==0);
+
+    // write errors are handled by each socket, broken client pipe must not stop process
+    sa.sa_handler = SIG_IGN;
+    res = res && (sigaction(SIGPIPE, &sa, NULL)==0);
+    return res;
+#else
+    return true;
+#endif
+}
+
+void CRecorderDaemon::sysSignal()
+{
+#ifdef LINUX
+    char c;
+    if (::read(sigFd[1],&c,1)!=1) return;
+
+    switch (static_cast<int>(c)) {
+        case SIGTERM:
+        case SIGINT:
+            appendLog(trUtf8("Termination signal received."));
+            shutdown();
+            QCoreApplication::quit();
+            break;
+        case SIGHUP:
+            appendLog(trUtf8("SIGHUP received. Rotating CSV files."));
+            rotate();
+            break;
+        default:
+            break;
+    }
+#endif
+}
+
+void CRecorderDaemon::appendLog(const QString &msg)
+{
+    QTextStream err(stderr);
+    err << QString("%1: %2\n").
+           arg(QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss")).
+           arg(msg);
+}
+
+void CRecorderDaemon::writeStatus()
+{
+    if (statusFile.isEmpty()) return;
+
+    QJsonArray recorders;
+    for (int i=0;i<units.count();i++)
+        recorders.append(units.at(i)->status());
+
+    QJsonObject root;
+    root.insert("pid",static_cast<double>(QCoreApplication::applicationPid()));
+    root.insert("started",startTime.toString(Qt::ISODate));
+    root.insert("updated",QDateTime::currentDateTime().toString(Qt::ISODate));
+    root.insert("running",!shuttingDown);
+    root.insert("csvDir",gSet->outputCSVDir);
+    root.insert("recorders",recorders);
+
+    // readers never see partially written file
+    QSaveFile f(statusFile);
+    bool res = f.open(QIODevice::WriteOnly);
+    if (res) {
+        f.write(QJsonDocument(root).toJson());
+        res = f.commit();
+    }
+    if (!res && !statusFailed)
+        appendLog(trUtf8("Unable to write status file %1.").arg(statusFile));
+    statusFailed = !res;
+}
+
+void CRecorderDaemon::shutdown()
+{
+    if (shuttingDown) return;
+    shuttingDown = true;
+
+    statusTimer->stop();
+    syncTimer->stop();
+    for (int i=0;i<units.count();i++)
+        units.at(i)->stop();
+    writeStatus();
+    appendLog(trUtf8("Recording stopped."));
+}
+
+void CRecorderDaemon::rotate()
+{
+    for (int i=0;i<units.count();i++)
+        units.at(i)->rotate();
+    writeStatus();
+}
+
+void CRecorderDaemon::syncUnits()
+{
+    for (int i=0;i<units.count();i++)
+        units.at(i)->sync();
+}
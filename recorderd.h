@@ -0,0 +1,133 @@
+#ifndef RECORDERD_H
+#define RECORDERD_H
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QDateTime>
+#include <QStringList>
+#include <QJsonObject>
+#include "plc.h"
+#include "csvhandler.h"
+#include "samplebus.h"
+#include "livesegment.h"
+#include "streamserver.h"
+
+class QSocketNotifier;
+
+// One PLC connection from .plr file, recorded to own CSV files
+class CRecorderUnit : public QObject
+{
+    Q_OBJECT
+public:
+    enum UnitState {
+        usConnecting,
+        usWaiting, // for reconnect after failure
+        usRecording,
+        usStopped
+    };
+    explicit CRecorderUnit(const QString& aFileName, QObject *parent = NULL);
+    virtual ~CRecorderUnit();
+
+    bool load(); // reads .plr file, errorString() on failure
+    void setFileTemplate(const QString& aTemplate);
+    void setLiveSegmentName(const QString& aName); // empty to disable
+    bool setStreamName(const QString& aName, bool broker);
+    QString fileName() const;
+    QString errorString() const;
+    QJsonObject status() const;
+
+private:
+    QString plrFile;
+    QString ip;
+    int rack, slot, acqInterval;
+    CWPList watchpoints;
+
+    CPLC* plc;
+    QThread* plcThread;
+    CCSVHandler* csvHandler;
+    CSampleReader* csvReader;
+    CSampleReader* liveReader;
+    CLiveSegment* liveSegment;
+    CSampleReader* streamReader;
+    CStreamServer* streamServer;
+    QTimer* reconnectTimer;
+
+    UnitState state;
+    bool stopping;
+    bool connected;
+    qint64 scans;
+    int reconnects;
+    QDateTime lastScan;
+    QString lastError;
+    QDateTime lastErrorTime;
+
+    void setError(const QString& msg);
+
+signals:
+    void logMessage(const QString& msg);
+
+    void plcSetAddress(const QString& ip, int rack, int slot, int timeout);
+    void plcSetAcqInterval(int interval);
+    void plcSetWatchpoints(const CWPList& wp);
+    void plcSetRetryParams(int maxErrorCnt, int maxRetryCnt, int waitReconnect);
+    void plcConnect();
+    void plcStart();
+    void plcDisconnect();
+
+public slots:
+    void start();
+    void stop(); // blocks until PLC is disconnected, PLC thread is finished by destructor
+    void rotate();
+    void sync();
+
+private slots:
+    void connectPLC();
+    void plcError(const QString& msg, bool critical);
+    void plcConnected();
+    void plcDisconnected();
+    void plcStarted();
+    void plcStopped();
+    void plcFailed();
+    void csvFrame(const CWPList& wp, const QDateTime& stm);
+    void csvError(const QString& msg);
+    void appendLog(const QString& msg);
+
+};
+
+// Recording without GUI: .plr files and options from command line,
+// status is periodically written to JSON file
+class CRecorderDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CRecorderDaemon(QObject *parent = NULL);
+    virtual ~CRecorderDaemon();
+
+    bool init(const QStringList& arguments);
+
+private:
+    QList<CRecorderUnit*> units;
+    QString statusFile;
+    QDateTime startTime;
+    QTimer* syncTimer;
+    QTimer* statusTimer;
+    QSocketNotifier* sigNotifier;
+    bool statusFailed;
+    bool shuttingDown;
+
+    bool setupSignals();
+
+public slots:
+    void appendLog(const QString& msg);
+    void writeStatus();
+    void shutdown();
+    void rotate();
+
+private slots:
+    void syncUnits();
+    void sysSignal();
+
+};
+
+#endif // RECORDERD_H
@@ -0,0 +1,238 @@
+#include <QThread>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+#include "samplebus.h"
+#include "specwidgets.h"
+
+const static int busBlockTimeout = 1000; // ms, stalled blocking reader then loses frames
+const static int busMaxReaders = 32;
+
+CSampleFrame::CSampleFrame()
+{
+    wp.clear();
+    time = QDateTime();
+}
+
+CSampleSlot::CSampleSlot() :
+    seq(-1),
+    readers(0)
+{
+}
+
+CSampleBus::CSampleBus(int aDepth)
+{
+    ringDepth = 1;
+    while (ringDepth<aDepth)
+        ringDepth <<= 1;
+    ringMask = ringDepth-1;
+    ring = new CSampleSlot[ringDepth];
+    headSeq.storeRelease(0);
+    readerTable = new QAtomicPointer<CSampleReader>[busMaxReaders];
+    for (int i=0;i<busMaxReaders;i++)
+        readerTable[i].storeRelease(NULL);
+    readerWalkers.storeRelease(0);
+}
+
+CSampleBus::~CSampleBus()
+{
+    delete[] readerTable;
+    delete[] ring;
+}
+
+int CSampleBus::seqDiff(int a, int b)
+{
+    // sequences wrap, difference is valid while it fits into int
+    return static_cast<int>(static_cast<uint>(a)-static_cast<uint>(b));
+}
+
+int CSampleBus::seqAdd(int seq, int n)
+{
+    return static_cast<int>(static_cast<uint>(seq)+static_cast<uint>(n));
+}
+
+void CSampleBus::publish(const CWPList &wp, const QDateTime &time)
+{
+    int seq = headSeq.loadAcquire();
+    CSampleSlot &slot = ring[seq & ringMask];
+
+    int old = slot.seq.loadAcquire();
+    if (old!=-1)
+        waitBlockingReaders(old);
+
+    // readers, which already found this frame in slot, finish their shallow copy first
+    slot.seq.fetchAndStoreOrdered(-1);
+    while (slot.readers.fetchAndAddOrdered(0)!=0)
+        QThread::yieldCurrentThread();
+    slot.frame.wp = wp;
+    slot.frame.time = time;
+    slot.seq.fetchAndStoreOrdered(seq);
+    headSeq.fetchAndStoreOrdered(seqAdd(seq,1));
+
+    readerWalkers.ref();
+    for (int i=0;i<busMaxReaders;i++) {
+        CSampleReader* reader = readerTable[i].loadAcquire();
+        if (reader!=NULL)
+            reader->notify();
+    }
+    readerWalkers.deref();
+}
+
+bool CSampleBus::read(int seq, CSampleFrame &frame)
+{
+    CSampleSlot &slot = ring[seq & ringMask];
+    slot.readers.ref();
+    bool res = (slot.seq.fetchAndAddOrdered(0)==seq);
+    if (res)
+        frame = slot.frame;
+    slot.readers.deref();
+    return res;
+}
+
+int CSampleBus::head() const
+{
+    return headSeq.loadAcquire();
+}
+
+int CSampleBus::depth() const
+{
+    return ringDepth;
+}
+
+void CSampleBus::addReader(CSampleReader *reader)
+{
+    QMutexLocker lock(&readersLock);
+    for (int i=0;i<busMaxReaders;i++) {
+        if (readerTable[i].loadAcquire()==NULL) {
+            readerTable[i].storeRelease(reader);
+            return;
+        }
+    }
+    qDebug() << "ERROR: sample bus reader table is full";
+}
+
+void CSampleBus::removeReader(CSampleReader *reader)
+{
+    QMutexLocker lock(&readersLock);
+    for (int i=0;i<busMaxReaders;i++) {
+        if (readerTable[i].loadAcquire()==reader)
+            readerTable[i].fetchAndStoreOrdered(NULL);
+    }
+    // producer may still hold pointer taken before removal
+    while (readerWalkers.fetchAndAddOrdered(0)!=0)
+        QThread::yieldCurrentThread();
+}
+
+bool CSampleBus::readerBehind(int idx, int seq)
+{
+    readerWalkers.ref();
+    CSampleReader* reader = readerTable[idx].loadAcquire();
+    bool res = ((reader!=NULL) && (reader->readerPolicy.loadAcquire()==CSampleReader::spBlock) &&
+                (seqDiff(reader->cursor.loadAcquire(),seq)<=0));
+    readerWalkers.deref();
+    return res;
+}
+
+void CSampleBus::waitBlockingReaders(int seq)
+{
+    // blocking readers must take frame before its slot is reused, waiting is bounded,
+    // reader table is not held while sleeping
+    QElapsedTimer tmr;
+    tmr.start();
+    for (int i=0;i<busMaxReaders;i++) {
+        while (readerBehind(i,seq) && (tmr.elapsed()<busBlockTimeout))
+            CSleep::msleep(1);
+    }
+}
+
+CSampleReader::CSampleReader(CSampleBus *aBus, Policy aPolicy, QObject *parent) :
+    QObject(parent),
+    readerPolicy(aPolicy),
+    cursor(0),
+    drops(0),
+    notified(0)
+{
+    bus = aBus;
+    draining = false;
+    cursor.storeRelease(bus->head());
+    bus->addReader(this);
+}
+
+CSampleReader::~CSampleReader()
+{
+    bus->removeReader(this);
+}
+
+CSampleReader::Policy CSampleReader::policy() const
+{
+    return static_cast<Policy>(readerPolicy.loadAcquire());
+}
+
+void CSampleReader::setPolicy(Policy aPolicy)
+{
+    readerPolicy.storeRelease(aPolicy);
+}
+
+int CSampleReader::pending() const
+{
+    int lag = CSampleBus::seqDiff(bus->head(),cursor.loadAcquire());
+    return qBound(0,lag,bus->depth());
+}
+
+int CSampleReader::dropped() const
+{
+    return drops.loadAcquire();
+}
+
+void CSampleReader::resetDropped()
+{
+    drops.storeRelease(0);
+}
+
+void CSampleReader::notify()
+{
+    // at most one queued drain per reader, so event queue stays bounded
+    if (notified.testAndSetOrdered(0,1))
+        QMetaObject::invokeMethod(this,"drain",Qt::QueuedConnection);
+}
+
+void CSampleReader::drain()
+{
+    // frame handlers may spin nested event loops (message boxes), no reentrance,
+    // next notify must queue drain again, outer pass picks up frames on exit
+    if (draining) {
+        notified.storeRelease(0);
+        return;
+    }
+    draining = true;
+    notified.storeRelease(0);
+
+    int cur = cursor.loadAcquire();
+    int head = bus->head();
+    int lag = CSampleBus::seqDiff(head,cur);
+    int skip = 0;
+    if (readerPolicy.loadAcquire()==spConflate)
+        skip = lag-1;
+    else if (lag>bus->depth())
+        skip = lag-bus->depth();
+    if (skip>0) {
+        drops.fetchAndAddRelaxed(skip);
+        cur = CSampleBus::seqAdd(cur,skip);
+    }
+
+    CSampleFrame frame;
+    while (CSampleBus::seqDiff(head,cur)>0) {
+        bool ok = bus->read(cur,frame);
+        cur = CSampleBus::seqAdd(cur,1);
+        cursor.storeRelease(cur);
+        if (ok)
+            emit frameReady(frame.wp,frame.time);
+        else
+            drops.fetchAndAddRelaxed(1);
+    }
+    draining = false;
+
+    // frames published while delivering are taken in next event loop pass
+    if (CSampleBus::seqDiff(bus->head(),cur)>0)
+        notify();
+}
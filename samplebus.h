@@ -0,0 +1,102 @@
+#ifndef SAMPLEBUS_H
+#define SAMPLEBUS_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+#include <QMutex>
+#include "plc.h"
+
+class CSampleFrame
+{
+public:
+    CWPList wp; // implicitly shared with acquisition, readers get shallow copies
+    QDateTime time;
+    CSampleFrame();
+};
+
+class CSampleSlot
+{
+public:
+    QAtomicInt seq; // sequence of frame in slot, -1 while empty or being written
+    QAtomicInt readers;
+    CSampleFrame frame;
+    CSampleSlot();
+};
+
+class CSampleReader;
+
+// Bounded ring of preallocated frames from acquisition thread to consumers.
+// Single producer, each reader has own cursor; frame path is lock-free,
+// readers are kept in fixed table of atomic pointers, registration is guarded by mutex
+// and removal waits until producer leaves the table.
+class CSampleBus
+{
+public:
+    explicit CSampleBus(int aDepth = 256);
+    ~CSampleBus();
+
+    void publish(const CWPList& wp, const QDateTime& time); // producer thread only
+    bool read(int seq, CSampleFrame& frame);
+    int head() const; // sequence of next frame
+    int depth() const;
+
+    void addReader(CSampleReader* reader);
+    void removeReader(CSampleReader* reader);
+
+    static int seqDiff(int a, int b);
+    static int seqAdd(int seq, int n);
+
+private:
+    Q_DISABLE_COPY(CSampleBus)
+    CSampleSlot* ring;
+    int ringDepth;
+    int ringMask;
+    QAtomicInt headSeq;
+    QMutex readersLock; // add and remove only
+    QAtomicPointer<CSampleReader>* readerTable;
+    QAtomicInt readerWalkers; // producer passes over reader table
+
+    void waitBlockingReaders(int seq);
+    bool readerBehind(int idx, int seq);
+};
+
+class CSampleReader : public QObject
+{
+    Q_OBJECT
+    friend class CSampleBus;
+public:
+    enum Policy {
+        spBlock, // producer waits for this reader, lossless unless reader stalls too long
+        spDropOldest, // lagging reader skips frames overwritten in ring
+        spConflate // only latest frame is delivered
+    };
+    CSampleReader(CSampleBus* aBus, Policy aPolicy, QObject *parent = NULL);
+    virtual ~CSampleReader();
+
+    Policy policy() const;
+    void setPolicy(Policy aPolicy);
+    int pending() const; // queue depth
+    int dropped() const;
+    void resetDropped();
+
+private:
+    CSampleBus* bus;
+    QAtomicInt readerPolicy;
+    QAtomicInt cursor; // next frame to deliver
+    QAtomicInt drops;
+    QAtomicInt notified;
+    bool draining;
+
+    void notify();
+
+signals:
+    void frameReady(const CWPList& wp, const QDateTime& time);
+
+private slots:
+    void drain();
+
+};
+
+#endif // SAMPLEBUS_H
@@ -66,11 +66,54 @@ bool CSettingsDialog::getPlotAntialiasing()
     return ui->checkAntialiasing->isChecked();
 }
 
+int CSettingsDialog::getPlotFrameRate()
+{
+    return ui->spinPlotFrameRate->value();
+}
+
+int CSettingsDialog::getPlotMemoryLimit()
+{
+    return ui->spinPlotMemoryLimit->value();
+}
+
+int CSettingsDialog::getVatRefreshRate()
+{
+    return ui->spinVatRefreshRate->value();
+}
+
+bool CSettingsDialog::getLiveSegment()
+{
+    return ui->checkLiveSegment->isChecked();
+}
+
+QString CSettingsDialog::getLiveSegmentName() const
+{
+    return ui->editLiveSegmentName->text();
+}
+
+bool CSettingsDialog::getStreamServer()
+{
+    return ui->checkStreamServer->isChecked();
+}
+
+QString CSettingsDialog::getStreamServerName() const
+{
+    return ui->editStreamServerName->text();
+}
+
+bool CSettingsDialog::getStreamBroker()
+{
+    return ui->checkStreamBroker->isChecked();
+}
+
 
 void CSettingsDialog::setParams(const QString &outputDir, const QString &fileTemplate, int tcpTimeout,
                                 int maxRecErrorCount, int maxConnectRetryCount, int waitReconnect,
                                 int totalRetryCount, bool suppressMsgBox, bool restoreCSV,
-                                int plotVerticalSize, bool plotShowScatter, bool plotAntialiasing)
+                                int plotVerticalSize, bool plotShowScatter, bool plotAntialiasing,
+                                int plotFrameRate, int plotMemoryLimit, int vatRefreshRate,
+                                bool liveSegment, const QString &liveSegmentName,
+                                bool streamServer, const QString &streamServerName, bool streamBroker)
 {
     ui->editCSVDir->setText(outputDir);
     ui->editCSVTemplate->setText(fileTemplate);
@@ -84,6 +127,14 @@ void CSettingsDialog::setParams(const QString &outputDir, const QString &fileTem
     ui->spinPlotVerticalSize->setValue(plotVerticalSize);
     ui->checkPlotShotScatter->setChecked(plotShowScatter);
     ui->checkAntialiasing->setChecked(plotAntialiasing);
+    ui->spinPlotFrameRate->setValue(plotFrameRate);
+    ui->spinPlotMemoryLimit->setValue(plotMemoryLimit);
+    ui->spinVatRefreshRate->setValue(vatRefreshRate);
+    ui->checkLiveSegment->setChecked(liveSegment);
+    ui->editLiveSegmentName->setText(liveSegmentName);
+    ui->checkStreamServer->setChecked(streamServer);
+    ui->editStreamServerName->setText(streamServerName);
+    ui->checkStreamBroker->setChecked(streamBroker);
 }
 
 QString CSettingsDialog::getOutputDir() const
@@ -18,7 +18,10 @@ public:
 
     void setParams(const QString& outputDir, const QString& fileTemplate, int tcpTimeout,
                    int maxRecErrorCount, int maxConnectRetryCount, int waitReconnect, int totalRetryCount,
-                   bool suppressMsgBox, bool restoreCSV, int plotVerticalSize, bool plotShowScatter, bool plotAntialiasing);
+                   bool suppressMsgBox, bool restoreCSV, int plotVerticalSize, bool plotShowScatter, bool plotAntialiasing,
+                   int plotFrameRate, int plotMemoryLimit, int vatRefreshRate,
+                   bool liveSegment, const QString& liveSegmentName,
+                   bool streamServer, const QString& streamServerName, bool streamBroker);
     QString getOutputDir() const;
     QString getFileTemplate() const;
     int getTCPTimeout();
@@ -31,6 +34,14 @@ public:
     int getPlotVerticalSize();
     bool getPlotShowScatter();
     bool getPlotAntialiasing();
+    int getPlotFrameRate();
+    int getPlotMemoryLimit();
+    int getVatRefreshRate();
+    bool getLiveSegment();
+    QString getLiveSegmentName() const;
+    bool getStreamServer();
+    QString getStreamServerName() const;
+    bool getStreamBroker();
 
 
 private:
@@ -0,0 +1,311 @@
+#include <QFile>
+#include <QDateTime>
+#include <QTextStream>
+#include <QtEndian>
+#include <cstring>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "snapshot.h"
+#include "csvhandler.h"
+
+const static int snapshotKeyframeInterval = 600; // scans, 1 min at 100 ms
+const static int diffBlock = 8; // compare granularity, also size of range header
+
+CSnapshotCodec::CSnapshotCodec()
+{
+    reset();
+}
+
+void CSnapshotCodec::reset()
+{
+    images.clear();
+    sinceKeyframe.clear();
+}
+
+int CSnapshotCodec::imageIndex(const CWP &wp)
+{
+    int idx = images.indexOf(wp);
+    if (idx<0) {
+        CWP img = wp;
+        img.data = CWPValue();
+        images.append(img);
+        sinceKeyframe.append(snapshotKeyframeInterval);
+        idx = images.count()-1;
+    }
+    return idx;
+}
+
+CWPList CSnapshotCodec::encode(const CWPList &wp)
+{
+    CWPList res = wp;
+    for (int i=0;i<res.count();i++) {
+        if (!res.at(i).isSnapshot() || !res.at(i).data.isValid()) continue;
+        const QByteArray cur = res.at(i).data.toByteArray();
+        int idx = imageIndex(res.at(i));
+        const QByteArray prev = images.at(idx).data.toByteArray();
+
+        if ((prev.size()!=cur.size()) || (sinceKeyframe.at(idx)>=snapshotKeyframeInterval)) {
+            QByteArray rec;
+            rec.reserve(cur.size()+1);
+            rec.append('K');
+            rec.append(cur);
+            res[i].data = CWPValue(rec);
+            sinceKeyframe[idx] = 1;
+        } else {
+            res[i].data = CWPValue(diffImages(prev,cur));
+            sinceKeyframe[idx]++;
+        }
+        images[idx].data = CWPValue(cur);
+    }
+    return res;
+}
+
+bool CSnapshotCodec::decode(CWPList &wp)
+{
+    bool res = true;
+    for (int i=0;i<wp.count();i++) {
+        if (!wp.at(i).isSnapshot() || !wp.at(i).data.isValid()) continue;
+        int idx = imageIndex(wp.at(i));
+        QByteArray img = images.at(idx).data.toByteArray();
+        if (!applyRecord(img,wp.at(i).data.toByteArray())) {
+            wp[i].data = CWPValue();
+            res = false;
+            continue;
+        }
+        wp[i].data = CWPValue(img);
+        images[idx].data = CWPValue(img);
+    }
+    return res;
+}
+
+QByteArray CSnapshotCodec::diffImages(const QByteArray &prev, const QByteArray &cur)
+{
+    // 'D', then big-endian offset and length of each changed range, followed by range bytes
+    QByteArray res;
+    res.append('D');
+    int n = cur.size();
+    if ((prev.size()!=n) || (memcmp(prev.constData(),cur.constData(),static_cast<size_t>(n))==0))
+        return res;
+
+    // changed flag for each block: SSE2 compares two blocks per 16-byte load,
+    // XOR of 64-bit words on other targets and for the odd last block
+    const uchar* a = reinterpret_cast<const uchar *>(prev.constData());
+    const uchar* b = reinterpret_cast<const uchar *>(cur.constData());
+    int full = n/diffBlock;
+    int blocks = (n+diffBlock-1)/diffBlock;
+    QVector<uchar> changed(blocks);
+    uchar* flags = changed.data();
+    int blk = 0;
+#ifdef __SSE2__
+    Q_STATIC_ASSERT(diffBlock==8);
+    for (;(blk+2)<=full;blk+=2) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a+blk*diffBlock));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b+blk*diffBlock));
+        int eq = _mm_movemask_epi8(_mm_cmpeq_epi8(x,y));
+        flags[blk] = ((eq & 0x00ff)!=0x00ff);
+        flags[blk+1] = ((eq & 0xff00)!=0xff00);
+    }
+#endif
+    for (;blk<full;blk++) {
+        quint64 x,y;
+        memcpy(&x,a+blk*diffBlock,sizeof(x));
+        memcpy(&y,b+blk*diffBlock,sizeof(y));
+        flags[blk] = ((x ^ y)!=0);
+    }
+    if (full<blocks) {
+        uchar acc = 0;
+        for (int i=full*diffBlock;i<n;i++)
+            acc |= (a[i] ^ b[i]);
+        flags[full] = (acc!=0);
+    }
+
+    // one unchanged block between ranges costs as much as range header, such gaps are merged
+    uchar hdr[8];
+    int i = 0;
+    while (i<blocks) {
+        if (flags[i]==0) {
+            i++;
+            continue;
+        }
+        int last = i;
+        int j = i+1;
+        while ((j<blocks) && ((flags[j]!=0) || ((j-last)<2))) {
+            if (flags[j]!=0) last = j;
+            j++;
+        }
+        int start = i*diffBlock;
+        int len = qMin((last+1)*diffBlock,n)-start;
+        qToBigEndian<quint32>(static_cast<quint32>(start),hdr);
+        qToBigEndian<quint32>(static_cast<quint32>(len),hdr+4);
+        res.append(reinterpret_cast<const char *>(hdr),sizeof(hdr));
+        res.append(cur.constData()+start,len);
+        i = last+1;
+    }
+    return res;
+}
+
+bool CSnapshotCodec::applyRecord(QByteArray &image, const QByteArray &record)
+{
+    if (record.isEmpty()) return false;
+    if (record.at(0)=='K') {
+        image = record.mid(1);
+        return true;
+    }
+    if ((record.at(0)!='D') || image.isEmpty()) return false;
+
+    const uchar* p = reinterpret_cast<const uchar *>(record.constData())+1;
+    const uchar* end = reinterpret_cast<const uchar *>(record.constData())+record.size();
+    while (p<end) {
+        if ((end-p)<8) return false;
+        quint32 start = qFromBigEndian<quint32>(p);
+        quint32 len = qFromBigEndian<quint32>(p+4);
+        p += 8;
+        if ((len>static_cast<quint32>(end-p)) ||
+                (static_cast<quint64>(start)+len>static_cast<quint64>(image.size()))) return false;
+        memcpy(image.data()+start,p,len);
+        p += len;
+    }
+    return true;
+}
+
+CSnapshotExtractor::CSnapshotExtractor()
+{
+    errorMsg.clear();
+    scanCount = 0;
+    extractedViews = 0;
+}
+
+static bool snapshotCovers(const CWP &snap, CWP &view)
+{
+    if (!snap.isSnapshot() || (snap.offset<0)) return false;
+    if ((view.varea!=snap.varea) || (view.vdb!=snap.vdb)) return false;
+    return ((view.offset>=snap.offset) && ((view.offset+view.size())<=(snap.offset+snap.count)));
+}
+
+static QVector<int> snapshotSources(const CWPList &scan, CWPList &outViews)
+{
+    QVector<int> res(outViews.count(),-1);
+    for (int i=0;i<outViews.count();i++) {
+        for (int j=0;j<scan.count();j++) {
+            if (snapshotCovers(scan.at(j),outViews[i])) {
+                res[i] = j;
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+bool CSnapshotExtractor::extract(const QString &srcName, const QString &dstName, const CWPList &views)
+{
+    errorMsg.clear();
+    scanCount = 0;
+    extractedViews = 0;
+
+    QFile src(srcName);
+    if (!src.open(QIODevice::ReadOnly)) {
+        errorMsg = QObject::trUtf8("Unable to open file %1.").arg(srcName);
+        return false;
+    }
+    if (!src.readLine().startsWith("\"Time\"; ")) {
+        errorMsg = QObject::trUtf8("Unrecognized CSV file %1.").arg(srcName);
+        return false;
+    }
+
+    QFile dst(dstName);
+    QTextStream out;
+    CSnapshotCodec codec;
+    CWPList schema;
+    CWPList outViews;
+    QVector<int> sources;
+    int lineNum = 1;
+
+    while (!src.atEnd()) {
+        QByteArray s = src.readLine().trimmed();
+        lineNum++;
+        if (s.isEmpty() || s.startsWith("\"Time\"; ")) continue;
+
+        CWPList scan;
+        QDateTime dt;
+        errorMsg = CCSVHandler::decodeScanLine(s,dt,scan);
+        if (!errorMsg.isEmpty()) {
+            errorMsg = errorMsg.arg(srcName).arg(lineNum);
+            return false;
+        }
+        codec.decode(scan); // broken diff chain gives empty views until next keyframe
+
+        if (outViews.isEmpty()) {
+            // views set is fixed by first scan
+            CWPList candidates;
+            for (int i=0;i<views.count();i++) {
+                const CWP &view = views.at(i);
+                if (view.isSnapshot() || (view.vtype==CWP::S7NoType) ||
+                        (view.varea==CWP::Timers) || (view.varea==CWP::Counters)) continue;
+                candidates << view;
+            }
+            QVector<int> cs = snapshotSources(scan,candidates);
+            for (int i=0;i<candidates.count();i++)
+                if (cs.at(i)>=0)
+                    outViews << candidates.at(i);
+            if (outViews.isEmpty()) {
+                errorMsg = QObject::trUtf8("No variables from table lie inside snapshots recorded in %1.")
+                           .arg(srcName);
+                return false;
+            }
+
+            if (!dst.open(QIODevice::WriteOnly)) {
+                errorMsg = QObject::trUtf8("Unable to save file '%1'").arg(dstName);
+                return false;
+            }
+            out.setDevice(&dst);
+            out.setCodec("Windows-1251");
+            out << CCSVHandler::csvHeader(outViews) << QString("\r\n");
+        }
+
+        if (scan!=schema) {
+            schema = scan;
+            sources = snapshotSources(scan,outViews);
+        }
+
+        for (int i=0;i<outViews.count();i++) {
+            outViews[i].data = CWPValue();
+            int idx = sources.at(i);
+            if (idx<0) continue;
+            const QByteArray img = scan.at(idx).data.toByteArray();
+            int rel = outViews.at(i).offset-scan.at(idx).offset;
+            if (img.size()<(rel+outViews[i].size())) continue;
+            const uchar* p = reinterpret_cast<const uchar *>(img.constData())+rel;
+            if (outViews.at(i).isArray())
+                outViews[i].decodeArray(p);
+            else
+                outViews[i].decodeValue(p);
+        }
+        out << CCSVHandler::csvLine(outViews,outViews,dt) << QString("\r\n");
+        scanCount++;
+    }
+
+    if (outViews.isEmpty()) {
+        errorMsg = QObject::trUtf8("No scans found in %1.").arg(srcName);
+        return false;
+    }
+    extractedViews = outViews.count();
+    out.flush();
+    dst.close();
+    return true;
+}
+
+QString CSnapshotExtractor::errorMessage() const
+{
+    return errorMsg;
+}
+
+int CSnapshotExtractor::scans() const
+{
+    return scanCount;
+}
+
+int CSnapshotExtractor::viewCount() const
+{
+    return extractedViews;
+}
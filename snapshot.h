@@ -0,0 +1,50 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+#include "plc.h"
+
+// Snapshot watchpoints in CSV scan dump: every image is stored as keyframe
+// or as byte ranges changed since previous scan of the same file.
+class CSnapshotCodec
+{
+public:
+    CSnapshotCodec();
+    void reset();
+
+    // recorder side, returns copy of scan with snapshot images replaced by records
+    CWPList encode(const CWPList& wp);
+    // loader side, records are replaced by full images, false on diff without keyframe
+    bool decode(CWPList& wp);
+
+    static QByteArray diffImages(const QByteArray& prev, const QByteArray& cur);
+    static bool applyRecord(QByteArray& image, const QByteArray& record);
+
+private:
+    CWPList images; // last image for each snapshot watchpoint, matched by uuid
+    QVector<int> sinceKeyframe;
+
+    int imageIndex(const CWP& wp);
+};
+
+// Typed views over recorded snapshots. Watchpoints lying inside recorded snapshot ranges
+// are decoded from reconstructed images and written to new CSV file, suitable for plotting.
+class CSnapshotExtractor
+{
+public:
+    CSnapshotExtractor();
+
+    bool extract(const QString& srcName, const QString& dstName, const CWPList& views);
+    QString errorMessage() const;
+    int scans() const;
+    int viewCount() const;
+
+private:
+    QString errorMsg;
+    int scanCount;
+    int extractedViews;
+};
+
+#endif // SNAPSHOT_H
@@ -1,4 +1,6 @@
 #include "specwidgets.h"
+
+#ifndef PLCRECORDERD
 #include <QAbstractButton>
 #include <QHeaderView>
 #include <QMouseEvent>
@@ -27,7 +29,7 @@ void CTableView::mouseDoubleClickEvent(QMouseEvent *event)
     else
         QTableView::mouseDoubleClickEvent(event);
 }
-
+#endif // PLCRECORDERD
 
 void CSleep::sleep(unsigned long secs)
 {
@@ -1,10 +1,12 @@
 #ifndef SPECWIDGETS_H
 #define SPECWIDGETS_H
 
+#include <QThread>
+
+#ifndef PLCRECORDERD
 #include <QTableView>
 #include <QWidget>
 #include <QPoint>
-#include <QThread>
 
 class CTableView : public QTableView
 {
@@ -22,6 +24,7 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent *event);
     
 };
+#endif // PLCRECORDERD
 
 class CSleep : public QThread
 {
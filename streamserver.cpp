@@ -0,0 +1,690 @@
+#include <QCoreApplication>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QThreadPool>
+#include <QtEndian>
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QMap>
+#include "streamserver.h"
+#include "csvhandler.h"
+#include "global.h"
+
+const static quint32 streamProtoVersion = 2; // 2 - broker watches
+const static qint64 streamBufferLimit = 256*1024; // bytes queued in socket before conflation
+const static quint32 streamMaxMessage = 1024*1024;
+const static int historyChunkRows = 500;
+const static int historyCredits = 4; // chunks in flight per query
+const static int listenProbeTimeout = 1000; // ms, connect attempt to running recorder
+
+static int brokerIdCounter = 0;
+
+QByteArray CStreamProto::message(MessageType type, const QByteArray &payload)
+{
+    QByteArray res;
+    res.resize(5);
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()+1),reinterpret_cast<uchar *>(res.data()));
+    res[4] = static_cast<char>(type);
+    res.append(payload);
+    return res;
+}
+
+void CStreamProto::writeString(QDataStream &out, const QString &s)
+{
+    QByteArray ba = s.toUtf8();
+    out << static_cast<quint32>(ba.size());
+    out.writeRawData(ba.constData(),ba.size());
+}
+
+bool CStreamProto::readString(QDataStream &in, QString &s)
+{
+    quint32 len;
+    in >> len;
+    if ((in.status()!=QDataStream::Ok) || (len>streamMaxMessage)) return false;
+    QByteArray ba(static_cast<int>(len),'\0');
+    if (in.readRawData(ba.data(),ba.size())!=ba.size()) return false;
+    s = QString::fromUtf8(ba);
+    return true;
+}
+
+QByteArray CStreamProto::helloMessage()
+{
+    QByteArray ba;
+    QDataStream out(&ba,QIODevice::WriteOnly);
+    out << streamProtoVersion << static_cast<qint64>(QCoreApplication::applicationPid());
+    return message(mtHello,ba);
+}
+
+QByteArray CStreamProto::schemaMessage(quint32 id, quint32 schema, const CLiveChannels &channels)
+{
+    QByteArray ba;
+    QDataStream out(&ba,QIODevice::WriteOnly);
+    out << id << schema << static_cast<quint32>(channels.count());
+    for (int i=0;i<channels.count();i++) {
+        writeString(out,channels.label(i));
+        writeString(out,channels.address(i));
+        out << static_cast<qint32>(channels.type(i)) << static_cast<qint32>(channels.element(i));
+    }
+    return message(mtSchema,ba);
+}
+
+QByteArray CStreamProto::frameMessage(quint32 id, quint32 schema, const QDateTime &time, quint32 conflated,
+                                      const CLiveChannels &channels, const CWPList &wp)
+{
+    QVector<double> values(channels.count());
+    channels.values(wp,values.data());
+
+    QByteArray ba;
+    ba.reserve(24+values.count()*8);
+    QDataStream out(&ba,QIODevice::WriteOnly);
+    out << id << schema << static_cast<qint64>(time.toMSecsSinceEpoch()) << conflated;
+    out << static_cast<quint32>(values.count());
+    for (int i=0;i<values.count();i++)
+        out << values.at(i);
+    return message(mtFrame,ba);
+}
+
+QByteArray CStreamProto::endMessage(quint32 id, EndStatus status, quint64 rows, const QString &msg)
+{
+    QByteArray ba;
+    QDataStream out(&ba,QIODevice::WriteOnly);
+    out << id << static_cast<quint32>(status) << rows;
+    writeString(out,msg);
+    return message(mtEnd,ba);
+}
+
+CHistoryQuery::CHistoryQuery(quint32 aId, const QString &aDir, const QString &aFileTemplate, const QDateTime &aFrom,
+                             const QDateTime &aTo, int aInterval, const QStringList &aFilter) :
+    QObject(NULL),
+    canceled(0),
+    credits(historyCredits)
+{
+    setAutoDelete(false);
+    queryId = aId;
+    dir = aDir;
+    fileTemplate = aFileTemplate;
+    from = aFrom;
+    to = aTo;
+    intervalMs = aInterval;
+    filter = aFilter;
+}
+
+quint32 CHistoryQuery::id() const
+{
+    return queryId;
+}
+
+void CHistoryQuery::cancel()
+{
+    canceled.storeRelease(1);
+}
+
+void CHistoryQuery::releaseCredit()
+{
+    credits.release();
+}
+
+QStringList CHistoryQuery::selectFiles() const
+{
+    // file covers time from name suffix up to its modification time
+    QMultiMap<qint64,QString> files;
+    QFileInfoList fl = QDir(dir).entryInfoList(QStringList() << QString("*.csv"),QDir::Files);
+    for (int i=0;i<fl.count();i++) {
+        QString base = fl.at(i).completeBaseName();
+        if (!fileTemplate.isEmpty() &&
+                ((base.length()!=(fileTemplate.length()+20)) || !base.startsWith(fileTemplate+QChar('_'))))
+            continue;
+        if (fl.at(i).lastModified()<from) continue;
+        QDateTime start = QDateTime::fromString(base.right(19),"yyyy-MM-dd_hh-mm-ss");
+        if (start.isValid() && (start>to)) continue;
+        files.insert((start.isValid() ? start.toMSecsSinceEpoch() : 0),fl.at(i).filePath());
+    }
+    return files.values();
+}
+
+bool CHistoryQuery::sendChunk(const QByteArray &data)
+{
+    while (!credits.tryAcquire(1,100)) {
+        if (canceled.loadAcquire()!=0) return false;
+    }
+    emit chunkReady(data);
+    return true;
+}
+
+void CHistoryQuery::run()
+{
+    // time column has fixed width, rows out of range are skipped without decoding
+    const QByteArray fromKey = from.toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+    const QByteArray toKey = to.toString("yyyy-MM-dd hh:mm:ss.zzz").toLatin1();
+    const QStringList files = selectFiles();
+
+    CStreamProto::EndStatus status = CStreamProto::esOk;
+    CLiveChannels channels;
+    CWPList schema;
+    quint32 schemaGen = 0;
+    quint64 rows = 0;
+    qint64 lastSent = -1;
+    QByteArray chunk;
+    int chunkRows = 0;
+
+    for (int i=0;(i<files.count()) && (status==CStreamProto::esOk);i++) {
+        QFile f(files.at(i));
+        if (!f.open(QIODevice::ReadOnly)) continue;
+        while (!f.atEnd()) {
+            if (canceled.loadAcquire()!=0) {
+                status = CStreamProto::esCanceled;
+                break;
+            }
+            QByteArray s = f.readLine().trimmed();
+            if ((s.size()<25) || (s.at(0)!='"') || s.startsWith("\"Time\"; ")) continue;
+            QByteArray key = s.mid(1,23);
+            if ((key<fromKey) || (key>toKey)) continue;
+
+            CWPList wp;
+            QDateTime dt;
+            if (!CCSVHandler::decodeScanLine(s,dt,wp).isEmpty()) continue; // incomplete line of active file
+            qint64 ms = dt.toMSecsSinceEpoch();
+            if ((intervalMs>0) && (lastSent>=0) && ((ms-lastSent)<intervalMs)) continue;
+
+            if (wp!=schema) {
+                schema = wp;
+                channels.build(wp,filter);
+                schemaGen++;
+                chunk.append(CStreamProto::schemaMessage(queryId,schemaGen,channels));
+            }
+            chunk.append(CStreamProto::frameMessage(queryId,schemaGen,dt,0,channels,wp));
+            lastSent = ms;
+            rows++;
+            chunkRows++;
+            if (chunkRows>=historyChunkRows) {
+                if (!sendChunk(chunk)) {
+                    status = CStreamProto::esCanceled;
+                    break;
+                }
+                chunk.clear();
+                chunkRows = 0;
+            }
+        }
+        f.close();
+    }
+    if ((status==CStreamProto::esOk) && !chunk.isEmpty() && !sendChunk(chunk))
+        status = CStreamProto::esCanceled;
+
+    emit finished(CStreamProto::endMessage(queryId,status,rows,QString()));
+}
+
+CStreamFeed::CStreamFeed()
+{
+    id = 0;
+    brokerId = -1;
+    filter.clear();
+    schema.clear();
+    schemaGen = 0;
+    hasPending = false;
+    pendingWp.clear();
+    conflated = 0;
+    frames = 0;
+}
+
+CStreamClient::CStreamClient(QLocalSocket *aSocket, const QString &aFileTemplate, bool aBroker, QObject *parent) :
+    QObject(parent)
+{
+    socket = aSocket;
+    socket->setParent(this);
+    fileTemplate = aFileTemplate;
+    brokerEnabled = aBroker;
+    inbuf.clear();
+    subscribed = false;
+    intervalMs = 0;
+    lastSent = -1;
+    watches.clear();
+    conflatedTotal = 0;
+
+    connect(socket,SIGNAL(readyRead()),this,SLOT(readData()));
+    connect(socket,SIGNAL(bytesWritten(qint64)),this,SLOT(bytesWritten()));
+    connect(socket,SIGNAL(disconnected()),this,SLOT(socketDisconnected()));
+    connect(socket,SIGNAL(error(QLocalSocket::LocalSocketError)),this,SLOT(socketError()));
+
+    socket->write(CStreamProto::helloMessage());
+}
+
+CStreamClient::~CStreamClient()
+{
+    // running queries delete themselves when finished
+    for (int i=0;i<queries.count();i++) {
+        queries.at(i)->disconnect(this);
+        queries.at(i)->cancel();
+    }
+    for (int i=0;i<watches.count();i++)
+        emit brokerUnsubscribe(watches.at(i).brokerId);
+}
+
+void CStreamClient::setBrokerEnabled(bool enabled)
+{
+    brokerEnabled = enabled;
+    if (brokerEnabled) return;
+    for (int i=0;i<watches.count();i++) {
+        emit brokerUnsubscribe(watches.at(i).brokerId);
+        socket->write(CStreamProto::endMessage(watches.at(i).id,CStreamProto::esCanceled,watches.at(i).frames,
+                                               trUtf8("Broker mode is disabled.")));
+    }
+    watches.clear();
+}
+
+qint64 CStreamClient::conflatedFrames() const
+{
+    return conflatedTotal;
+}
+
+bool CStreamClient::bufferFull() const
+{
+    return (socket->bytesToWrite()>=streamBufferLimit);
+}
+
+void CStreamClient::sendFrame(const CWPList &wp, const QDateTime &time)
+{
+    if (!subscribed) return;
+
+    qint64 ms = time.toMSecsSinceEpoch();
+    if ((intervalMs>0) && (lastSent>=0) && ((ms-lastSent)<intervalMs)) return;
+    lastSent = ms;
+    feedFrame(live,wp,time);
+}
+
+void CStreamClient::sendWatchFrame(int brokerId, const CWPList &wp, const QDateTime &time)
+{
+    // rate of watch frames is kept by PLC broker
+    for (int i=0;i<watches.count();i++) {
+        if (watches.at(i).brokerId==brokerId) {
+            feedFrame(watches[i],wp,time);
+            return;
+        }
+    }
+}
+
+void CStreamClient::watchFailed(int brokerId, const QString &msg)
+{
+    for (int i=0;i<watches.count();i++) {
+        if (watches.at(i).brokerId==brokerId) {
+            socket->write(CStreamProto::endMessage(watches.at(i).id,CStreamProto::esError,
+                                                   watches.at(i).frames,msg));
+            watches.removeAt(i);
+            return;
+        }
+    }
+}
+
+void CStreamClient::feedFrame(CStreamFeed &feed, const CWPList &wp, const QDateTime &time)
+{
+    if (bufferFull()) {
+        // slow client gets latest frame when buffer drains
+        if (feed.hasPending) {
+            feed.conflated++;
+            conflatedTotal++;
+        }
+        feed.hasPending = true;
+        feed.pendingWp = wp;
+        feed.pendingTime = time;
+        return;
+    }
+    deliver(feed,wp,time);
+}
+
+void CStreamClient::deliver(CStreamFeed &feed, const CWPList &wp, const QDateTime &time)
+{
+    if (wp!=feed.schema) {
+        feed.schema = wp;
+        feed.channels.build(wp,feed.filter);
+        feed.schemaGen++;
+        socket->write(CStreamProto::schemaMessage(feed.id,feed.schemaGen,feed.channels));
+    }
+    socket->write(CStreamProto::frameMessage(feed.id,feed.schemaGen,time,feed.conflated,feed.channels,wp));
+    feed.conflated = 0;
+    feed.frames++;
+    feed.hasPending = false;
+    feed.pendingWp.clear();
+}
+
+void CStreamClient::bytesWritten()
+{
+    while (!bufferFull() && !owedCredits.isEmpty())
+        owedCredits.takeFirst()->releaseCredit();
+    if (live.hasPending && !bufferFull())
+        deliver(live,live.pendingWp,live.pendingTime);
+    for (int i=0;(i<watches.count()) && !bufferFull();i++) {
+        if (watches.at(i).hasPending)
+            deliver(watches[i],watches.at(i).pendingWp,watches.at(i).pendingTime);
+    }
+}
+
+void CStreamClient::readData()
+{
+    inbuf.append(socket->readAll());
+    while (inbuf.size()>=4) {
+        quint32 len = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(inbuf.constData()));
+        if ((len==0) || (len>streamMaxMessage)) {
+            emit logMessage(trUtf8("Stream client protocol error. Connection closed."));
+            socket->abort();
+            return;
+        }
+        if (static_cast<quint32>(inbuf.size())<(len+4)) break;
+        QByteArray msg = inbuf.mid(4,static_cast<int>(len));
+        inbuf.remove(0,static_cast<int>(len)+4);
+        if (!handleMessage(msg)) {
+            emit logMessage(trUtf8("Stream client protocol error. Connection closed."));
+            socket->abort();
+            return;
+        }
+    }
+}
+
+bool CStreamClient::handleMessage(const QByteArray &msg)
+{
+    QDataStream in(msg);
+    quint8 type;
+    in >> type;
+
+    quint32 id, interval, cnt;
+    qint64 fromMs, toMs;
+    QStringList fl;
+    switch (type) {
+        case CStreamProto::mtSubscribe:
+            in >> interval >> cnt;
+            if (in.status()!=QDataStream::Ok) return false;
+            for (quint32 i=0;i<cnt;i++) {
+                QString s;
+                if (!CStreamProto::readString(in,s)) return false;
+                fl << s;
+            }
+            subscribed = true;
+            intervalMs = static_cast<int>(interval);
+            live.filter = fl;
+            live.schema.clear(); // schema is sent again with new filter
+            lastSent = -1;
+            return true;
+        case CStreamProto::mtUnsubscribe:
+            subscribed = false;
+            live.hasPending = false;
+            live.pendingWp.clear();
+            return true;
+        case CStreamProto::mtHistory:
+            in >> id >> fromMs >> toMs >> interval >> cnt;
+            if ((in.status()!=QDataStream::Ok) || (id==0)) return false;
+            for (quint32 i=0;i<cnt;i++) {
+                QString s;
+                if (!CStreamProto::readString(in,s)) return false;
+                fl << s;
+            }
+            startHistory(id,fromMs,toMs,static_cast<int>(interval),fl);
+            return true;
+        case CStreamProto::mtWatch:
+            in >> id >> interval >> cnt;
+            if ((in.status()!=QDataStream::Ok) || (id==0)) return false;
+            for (quint32 i=0;i<cnt;i++) {
+                QString s;
+                if (!CStreamProto::readString(in,s)) return false;
+                fl << s;
+            }
+            startWatch(id,static_cast<int>(interval),fl);
+            return true;
+        case CStreamProto::mtCancel:
+            in >> id;
+            if (in.status()!=QDataStream::Ok) return false;
+            for (int i=0;i<queries.count();i++) {
+                if (queries.at(i)->id()==id)
+                    queries.at(i)->cancel();
+            }
+            for (int i=0;i<watches.count();i++) {
+                if (watches.at(i).id==id) {
+                    emit brokerUnsubscribe(watches.at(i).brokerId);
+                    socket->write(CStreamProto::endMessage(id,CStreamProto::esCanceled,
+                                                           watches.at(i).frames,QString()));
+                    watches.removeAt(i);
+                    break;
+                }
+            }
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool CStreamClient::isBusyId(quint32 id) const
+{
+    for (int i=0;i<queries.count();i++) {
+        if (queries.at(i)->id()==id)
+            return true;
+    }
+    for (int i=0;i<watches.count();i++) {
+        if (watches.at(i).id==id)
+            return true;
+    }
+    return false;
+}
+
+void CStreamClient::startWatch(quint32 id, int interval, const QStringList &specs)
+{
+    if (isBusyId(id)) {
+        socket->write(CStreamProto::endMessage(id,CStreamProto::esError,0,
+                                               trUtf8("Request %1 is already running.").arg(id)));
+        return;
+    }
+    if (!brokerEnabled) {
+        socket->write(CStreamProto::endMessage(id,CStreamProto::esError,0,
+                                               trUtf8("Broker mode is disabled.")));
+        return;
+    }
+
+    CWPList wp;
+    for (int i=0;i<specs.count();i++) {
+        QStringList sl = specs.at(i).split(QChar(';'));
+        CWP w;
+        bool ok = (sl.count()==3);
+        if (ok) {
+            w.label = sl.at(0).trimmed();
+            ok = gSet->plcSetTypeForName(sl.at(1).trimmed(),w) &&
+                 gSet->plcParseAddr(sl.at(2).trimmed(),w);
+        }
+        if (!ok) {
+            socket->write(CStreamProto::endMessage(id,CStreamProto::esError,0,
+                                                   trUtf8("Invalid variable definition: %1").arg(specs.at(i))));
+            return;
+        }
+        wp << w;
+    }
+    if (wp.isEmpty()) {
+        socket->write(CStreamProto::endMessage(id,CStreamProto::esError,0,trUtf8("Variables list is empty.")));
+        return;
+    }
+
+    CStreamFeed feed;
+    feed.id = id;
+    feed.brokerId = ++brokerIdCounter;
+    watches << feed;
+    emit brokerSubscribe(feed.brokerId,wp,interval);
+}
+
+void CStreamClient::startHistory(quint32 id, qint64 fromMs, qint64 toMs, int interval,
+                                 const QStringList &aFilter)
+{
+    if (isBusyId(id)) {
+        socket->write(CStreamProto::endMessage(id,CStreamProto::esError,0,
+                                               trUtf8("Request %1 is already running.").arg(id)));
+        return;
+    }
+
+    CHistoryQuery* query = new CHistoryQuery(id,gSet->outputCSVDir,fileTemplate,
+                                             QDateTime::fromMSecsSinceEpoch(fromMs),
+                                             QDateTime::fromMSecsSinceEpoch(toMs),interval,aFilter);
+    // client slot is queued before deferred delete of query
+    connect(query,SIGNAL(chunkReady(QByteArray)),this,SLOT(historyChunk(QByteArray)),Qt::QueuedConnection);
+    connect(query,SIGNAL(finished(QByteArray)),this,SLOT(historyFinished(QByteArray)),Qt::QueuedConnection);
+    connect(query,SIGNAL(finished(QByteArray)),query,SLOT(deleteLater()),Qt::QueuedConnection);
+    queries << query;
+    QThreadPool::globalInstance()->start(query);
+}
+
+void CStreamClient::historyChunk(const QByteArray &data)
+{
+    CHistoryQuery* query = qobject_cast<CHistoryQuery *>(sender());
+    if (query==NULL) return;
+    socket->write(data);
+    if (bufferFull())
+        owedCredits << query;
+    else
+        query->releaseCredit();
+}
+
+void CStreamClient::historyFinished(const QByteArray &data)
+{
+    CHistoryQuery* query = qobject_cast<CHistoryQuery *>(sender());
+    socket->write(data);
+    queries.removeAll(query);
+    owedCredits.removeAll(query);
+}
+
+void CStreamClient::socketDisconnected()
+{
+    emit closed();
+    deleteLater();
+}
+
+void CStreamClient::socketError()
+{
+    // write to broken client closes only this client, disconnected follows for closed peer
+    if (socket->error()==QLocalSocket::PeerClosedError) return;
+
+    emit logMessage(trUtf8("Stream client connection error. %1").arg(socket->errorString()));
+    socket->disconnect(this);
+    socket->abort();
+    socketDisconnected();
+}
+
+CStreamServer::CStreamServer(QObject *parent) :
+    QObject(parent)
+{
+    server = new QLocalServer(this);
+    fileTemplate.clear();
+    brokerEnabled = false;
+    clients.clear();
+    connect(server,SIGNAL(newConnection()),this,SLOT(newConnection()));
+}
+
+CStreamServer::~CStreamServer()
+{
+    close();
+}
+
+bool CStreamServer::listen(const QString &aName)
+{
+    close();
+    if (aName.isEmpty()) return false;
+
+    // socket file left by crashed recorder is removed, running recorder keeps its address
+    QLocalSocket probe;
+    probe.connectToServer(aName);
+    if (probe.waitForConnected(listenProbeTimeout)) {
+        probe.disconnectFromServer();
+        emit logMessage(trUtf8("Unable to start stream server %1. Address is in use by another recorder.").arg(aName));
+        return false;
+    }
+    if ((probe.error()!=QLocalSocket::ConnectionRefusedError) &&
+            (probe.error()!=QLocalSocket::ServerNotFoundError)) {
+        emit logMessage(trUtf8("Unable to start stream server %1. %2").arg(aName,probe.errorString()));
+        return false;
+    }
+    QLocalServer::removeServer(aName);
+    if (!server->listen(aName)) {
+        emit logMessage(trUtf8("Unable to start stream server %1. %2").arg(aName,server->errorString()));
+        return false;
+    }
+    emit logMessage(trUtf8("Stream server listening at %1.").arg(server->fullServerName()));
+    return true;
+}
+
+void CStreamServer::setFileTemplate(const QString &aTemplate)
+{
+    fileTemplate = aTemplate;
+}
+
+void CStreamServer::setBrokerEnabled(bool enabled)
+{
+    brokerEnabled = enabled;
+    for (int i=0;i<clients.count();i++)
+        clients.at(i)->setBrokerEnabled(enabled);
+}
+
+void CStreamServer::close()
+{
+    // clients unsubscribe their watches from PLC on delete
+    QList<CStreamClient*> list = clients;
+    clients.clear();
+    for (int i=0;i<list.count();i++)
+        delete list.at(i);
+    if (server->isListening())
+        server->close();
+}
+
+bool CStreamServer::isListening() const
+{
+    return server->isListening();
+}
+
+QString CStreamServer::name() const
+{
+    return server->serverName();
+}
+
+int CStreamServer::clientCount() const
+{
+    return clients.count();
+}
+
+qint64 CStreamServer::conflatedFrames() const
+{
+    qint64 res = 0;
+    for (int i=0;i<clients.count();i++)
+        res += clients.at(i)->conflatedFrames();
+    return res;
+}
+
+void CStreamServer::publish(const CWPList &wp, const QDateTime &time)
+{
+    for (int i=0;i<clients.count();i++)
+        clients.at(i)->sendFrame(wp,time);
+}
+
+void CStreamServer::brokerData(int id, const CWPList &wp, const QDateTime &time)
+{
+    for (int i=0;i<clients.count();i++)
+        clients.at(i)->sendWatchFrame(id,wp,time);
+    emit brokerConsumed(id);
+}
+
+void CStreamServer::brokerFailed(int id, const QString &msg)
+{
+    for (int i=0;i<clients.count();i++)
+        clients.at(i)->watchFailed(id,msg);
+}
+
+void CStreamServer::newConnection()
+{
+    while (server->hasPendingConnections()) {
+        QLocalSocket* socket = server->nextPendingConnection();
+        if (socket==NULL) break;
+        CStreamClient* client = new CStreamClient(socket,fileTemplate,brokerEnabled,this);
+        connect(client,SIGNAL(closed()),this,SLOT(clientClosed()));
+        connect(client,SIGNAL(logMessage(QString)),this,SIGNAL(logMessage(QString)));
+        connect(client,SIGNAL(brokerSubscribe(int,CWPList,int)),this,SIGNAL(brokerSubscribe(int,CWPList,int)));
+        connect(client,SIGNAL(brokerUnsubscribe(int)),this,SIGNAL(brokerUnsubscribe(int)));
+        clients << client;
+    }
+}
+
+void CStreamServer::clientClosed()
+{
+    CStreamClient* client = qobject_cast<CStreamClient *>(sender());
+    clients.removeAll(client);
+}
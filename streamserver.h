@@ -0,0 +1,202 @@
+#ifndef STREAMSERVER_H
+#define STREAMSERVER_H
+
+#include <QObject>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QAtomicInt>
+#include <QStringList>
+#include <QDateTime>
+#include <QByteArray>
+#include <QList>
+#include "plc.h"
+#include "livesegment.h"
+
+class QLocalServer;
+class QLocalSocket;
+class QDataStream;
+
+// Message is big-endian quint32 length, then quint8 type and payload of that length.
+// Payload integers and doubles are big-endian, strings are quint32 length and UTF-8 bytes.
+// Live stream has id 0, history and watch replies carry id given by client.
+// Watch sends own variables list to PLC broker, shared connection reads it together
+// with lists of recorder and other clients. Type and address are as in variables table,
+// e.g. "Speed;REAL;DB10.DBD4", "Line;SNAPSHOT;DB100".
+class CStreamProto
+{
+public:
+    enum MessageType {
+        // client to server
+        mtSubscribe = 'S', // u32 interval ms, u32 n, n strings: labels or addresses, none for all
+        mtUnsubscribe = 'U',
+        mtHistory = 'H', // u32 id, i64 from ms, i64 to ms, u32 interval ms, u32 n, n strings
+        mtCancel = 'X', // u32 id of history query or watch
+        mtWatch = 'W', // u32 id, u32 interval ms, u32 n, n strings "label;TYPE;address", added to PLC scan
+        // server to client
+        mtHello = 'I', // u32 protocol version, i64 pid
+        mtSchema = 'C', // u32 id, u32 schema, u32 n, n * (string label, string address, i32 type, i32 element)
+        mtFrame = 'F', // u32 id, u32 schema, i64 time ms, u32 conflated frames, u32 n, n doubles
+        mtEnd = 'E' // u32 id, u32 status, u64 rows, string message
+    };
+    enum EndStatus {
+        esOk = 0,
+        esError = 1,
+        esCanceled = 2
+    };
+
+    static QByteArray message(MessageType type, const QByteArray& payload);
+    static QByteArray helloMessage();
+    static QByteArray schemaMessage(quint32 id, quint32 schema, const CLiveChannels& channels);
+    static QByteArray frameMessage(quint32 id, quint32 schema, const QDateTime& time, quint32 conflated,
+                                   const CLiveChannels& channels, const CWPList& wp);
+    static QByteArray endMessage(quint32 id, EndStatus status, quint64 rows, const QString& msg);
+
+    static void writeString(QDataStream& out, const QString& s);
+    static bool readString(QDataStream& in, QString& s);
+};
+
+// History range query over CSV files of recording directory, runs in thread pool.
+// Chunks are paced by credits returned by connection when socket buffer drains.
+class CHistoryQuery : public QObject, public QRunnable
+{
+    Q_OBJECT
+public:
+    CHistoryQuery(quint32 aId, const QString& aDir, const QString& aFileTemplate, const QDateTime& aFrom,
+                  const QDateTime& aTo, int aInterval, const QStringList& aFilter);
+
+    quint32 id() const;
+    void cancel();
+    void releaseCredit();
+    void run();
+
+private:
+    quint32 queryId;
+    QString dir;
+    QString fileTemplate; // empty for all CSV files in dir
+    QDateTime from, to;
+    int intervalMs;
+    QStringList filter;
+    QAtomicInt canceled;
+    QSemaphore credits;
+
+    QStringList selectFiles() const;
+    bool sendChunk(const QByteArray& data);
+
+signals:
+    void chunkReady(const QByteArray& data);
+    void finished(const QByteArray& data);
+
+};
+
+// Frames of live subscription or broker watch, conflated while socket buffer is full
+class CStreamFeed
+{
+public:
+    quint32 id;
+    int brokerId; // -1 for live subscription
+    QStringList filter;
+    CLiveChannels channels;
+    CWPList schema;
+    quint32 schemaGen;
+    bool hasPending;
+    CWPList pendingWp;
+    QDateTime pendingTime;
+    quint32 conflated; // since last delivered frame
+    quint64 frames;
+
+    CStreamFeed();
+};
+
+class CStreamClient : public QObject
+{
+    Q_OBJECT
+public:
+    CStreamClient(QLocalSocket* aSocket, const QString& aFileTemplate, bool aBroker, QObject *parent = NULL);
+    virtual ~CStreamClient();
+
+    void setBrokerEnabled(bool enabled);
+    void sendFrame(const CWPList& wp, const QDateTime& time);
+    void sendWatchFrame(int brokerId, const CWPList& wp, const QDateTime& time);
+    void watchFailed(int brokerId, const QString& msg);
+    qint64 conflatedFrames() const;
+
+private:
+    QLocalSocket* socket;
+    QString fileTemplate;
+    bool brokerEnabled;
+    QByteArray inbuf;
+    bool subscribed;
+    int intervalMs;
+    qint64 lastSent;
+    CStreamFeed live;
+    QList<CStreamFeed> watches;
+    qint64 conflatedTotal;
+    QList<CHistoryQuery*> queries;
+    QList<CHistoryQuery*> owedCredits; // chunks written while socket buffer was full
+
+    bool bufferFull() const;
+    void feedFrame(CStreamFeed& feed, const CWPList& wp, const QDateTime& time);
+    void deliver(CStreamFeed& feed, const CWPList& wp, const QDateTime& time);
+    bool handleMessage(const QByteArray& msg);
+    bool isBusyId(quint32 id) const;
+    void startHistory(quint32 id, qint64 fromMs, qint64 toMs, int interval, const QStringList& aFilter);
+    void startWatch(quint32 id, int interval, const QStringList& specs);
+
+signals:
+    void closed();
+    void logMessage(const QString& msg);
+    void brokerSubscribe(int brokerId, const CWPList& wp, int interval);
+    void brokerUnsubscribe(int brokerId);
+
+private slots:
+    void readData();
+    void bytesWritten();
+    void socketDisconnected();
+    void socketError();
+    void historyChunk(const QByteArray& data);
+    void historyFinished(const QByteArray& data);
+
+};
+
+// Local socket server for live frames and recorded history, Unix domain socket on Linux
+class CStreamServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit CStreamServer(QObject *parent = NULL);
+    virtual ~CStreamServer();
+
+    bool listen(const QString& aName);
+    void setFileTemplate(const QString& aTemplate); // history from files of this recorder only
+    void setBrokerEnabled(bool enabled); // watch requests are refused when disabled
+    void close();
+    bool isListening() const;
+    QString name() const;
+    int clientCount() const;
+    qint64 conflatedFrames() const;
+
+private:
+    QLocalServer* server;
+    QString fileTemplate;
+    bool brokerEnabled;
+    QList<CStreamClient*> clients;
+
+signals:
+    void logMessage(const QString& msg);
+    // connected to plcSubscribe and plcUnsubscribe of shared CPLC
+    void brokerSubscribe(int id, const CWPList& wp, int interval);
+    void brokerUnsubscribe(int id);
+    void brokerConsumed(int id);
+
+public slots:
+    void publish(const CWPList& wp, const QDateTime& time);
+    void brokerData(int id, const CWPList& wp, const QDateTime& time);
+    void brokerFailed(int id, const QString& msg);
+
+private slots:
+    void newConnection();
+    void clientClosed();
+
+};
+
+#endif // STREAMSERVER_H
@@ -0,0 +1,805 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+#include <cstring>
+#include "symimport.h"
+#include "global.h"
+
+const static int maxImportWatchpoints = 65536;
+const static int maxImportWarnings = 100;
+
+static inline int roundUpBits(int bits, int align)
+{
+    return ((bits+align-1)/align)*align;
+}
+
+class CAWLLexer
+{
+public:
+    enum TokenType {
+        tkEnd,
+        tkIdent,
+        tkQuoted,
+        tkNumber,
+        tkLiteral,
+        tkPunct
+    };
+    TokenType type;
+    QString text;
+    int line;
+
+    explicit CAWLLexer(const QString& source);
+    void next();
+    void skipLine();
+    void skipTo(const char* keyword);
+    bool isIdent(const char* keyword) const;
+    bool isPunct(const char* punct) const;
+
+private:
+    QString src;
+    const QChar* p;
+    const QChar* end;
+};
+
+CAWLLexer::CAWLLexer(const QString &source)
+{
+    src = source;
+    p = src.constData();
+    end = p+src.length();
+    type = tkEnd;
+    line = 1;
+}
+
+void CAWLLexer::next()
+{
+    // comments and {attributes} are skipped, string literals never span lines
+    for (;;) {
+        while ((p<end) && (p->isSpace())) {
+            if (p->unicode()=='\n') line++;
+            p++;
+        }
+        if (p>=end) {
+            type = tkEnd;
+            text.clear();
+            return;
+        }
+        if ((p->unicode()=='/') && ((p+1)<end) && (p[1].unicode()=='/')) {
+            while ((p<end) && (p->unicode()!='\n'))
+                p++;
+            continue;
+        }
+        if (p->unicode()=='{') {
+            while ((p<end) && (p->unicode()!='}')) {
+                if (p->unicode()=='\n') line++;
+                p++;
+            }
+            if (p<end) p++;
+            continue;
+        }
+        break;
+    }
+
+    const QChar* start = p;
+    ushort c = p->unicode();
+    if (c=='"') {
+        p++;
+        start = p;
+        while ((p<end) && (p->unicode()!='"') && (p->unicode()!='\n'))
+            p++;
+        text = QString(start,static_cast<int>(p-start));
+        if ((p<end) && (p->unicode()=='"')) p++;
+        type = tkQuoted;
+    } else if (c=='\'') {
+        p++;
+        while ((p<end) && (p->unicode()!='\'') && (p->unicode()!='\n'))
+            p++;
+        if ((p<end) && (p->unicode()=='\'')) p++;
+        text.clear();
+        type = tkLiteral;
+    } else if ((c>='0') && (c<='9')) {
+        while ((p<end) && (p->unicode()>='0') && (p->unicode()<='9'))
+            p++;
+        if (((p+1)<end) && (p->unicode()=='.') && (p[1].unicode()>='0') && (p[1].unicode()<='9')) {
+            p++;
+            while ((p<end) && (p->unicode()>='0') && (p->unicode()<='9'))
+                p++;
+        }
+        text = QString(start,static_cast<int>(p-start));
+        type = tkNumber;
+    } else if (p->isLetter() || (c=='_')) {
+        while ((p<end) && (p->isLetterOrNumber() || (p->unicode()=='_')))
+            p++;
+        text = QString(start,static_cast<int>(p-start));
+        type = tkIdent;
+    } else {
+        if (((p+1)<end) && (((c=='.') && (p[1].unicode()=='.')) || ((c==':') && (p[1].unicode()=='='))))
+            p += 2;
+        else
+            p++;
+        text = QString(start,static_cast<int>(p-start));
+        type = tkPunct;
+    }
+}
+
+void CAWLLexer::skipLine()
+{
+    while ((p<end) && (p->unicode()!='\n'))
+        p++;
+    next();
+}
+
+void CAWLLexer::skipTo(const char *keyword)
+{
+    while ((type!=tkEnd) && (!isIdent(keyword)))
+        next();
+    next();
+}
+
+bool CAWLLexer::isIdent(const char *keyword) const
+{
+    return ((type==tkIdent) && (text.compare(QLatin1String(keyword),Qt::CaseInsensitive)==0));
+}
+
+bool CAWLLexer::isPunct(const char *punct) const
+{
+    return ((type==tkPunct) && (text==QLatin1String(punct)));
+}
+
+static bool isHeaderLine(const CAWLLexer& lex)
+{
+    // header attributes with free text up to end of line
+    return (lex.isIdent("TITLE") || lex.isIdent("AUTHOR") || lex.isIdent("FAMILY") ||
+            lex.isIdent("NAME") || lex.isIdent("VERSION"));
+}
+
+static bool splitBlockName(const QString& s, QString& kind, int& number)
+{
+    // "DB10", "UDT 5" -> kind and number
+    static const char* kinds[] = { "UDT", "DB", "SFB", "SFC", "FB", "FC", "OB", "VAT", "SDB", NULL };
+    QString u = s.toUpper();
+    u.remove(QChar(' '));
+    for (int i=0;kinds[i]!=NULL;i++) {
+        if (!u.startsWith(QLatin1String(kinds[i]))) continue;
+        bool okconv;
+        int n = u.mid(static_cast<int>(strlen(kinds[i]))).toInt(&okconv);
+        if (!okconv || (n<0)) return false;
+        kind = QString::fromLatin1(kinds[i]);
+        number = n;
+        return true;
+    }
+    return false;
+}
+
+static bool readInteger(CAWLLexer& lex, int& value)
+{
+    bool negative = false;
+    if (lex.isPunct("-")) {
+        negative = true;
+        lex.next();
+    }
+    if (lex.type!=CAWLLexer::tkNumber) return false;
+    bool okconv;
+    value = lex.text.toInt(&okconv);
+    if (!okconv) return false;
+    if (negative) value = -value;
+    lex.next();
+    return true;
+}
+
+static QStringList splitQuoted(const QString& line)
+{
+    QStringList res;
+    QString field;
+    bool quoted = false;
+    for (int i=0;i<line.length();i++) {
+        QChar c = line.at(i);
+        if (quoted) {
+            if (c.unicode()=='"') {
+                if (((i+1)<line.length()) && (line.at(i+1).unicode()=='"')) {
+                    field += c;
+                    i++;
+                } else
+                    quoted = false;
+            } else
+                field += c;
+        } else if (c.unicode()=='"')
+            quoted = true;
+        else if (c.unicode()==',') {
+            res << field;
+            field.clear();
+        } else
+            field += c;
+    }
+    res << field;
+    return res;
+}
+
+CDBLeaf::CDBLeaf()
+{
+    name = QString();
+    vtype = CWP::S7NoType;
+    bitOffset = 0;
+    count = 1;
+}
+
+CDBLeaf::CDBLeaf(const QString &aName, CWP::VType aType, int aBitOffset, int aCount)
+{
+    name = aName;
+    vtype = aType;
+    bitOffset = aBitOffset;
+    count = aCount;
+}
+
+CDBLayout::CDBLayout()
+{
+    kind = lkWord;
+    sizeBits = 0;
+    leaves.clear();
+}
+
+CSymbolImporter::CSymbolImporter()
+{
+    result.clear();
+    warns.clear();
+    skipped = 0;
+    currentFile = QString();
+}
+
+bool CSymbolImporter::importFile(const QString &fileName)
+{
+    QFileInfo fi(fileName);
+    currentFile = fi.fileName();
+    QFile f(fileName);
+    if (!f.open(QIODevice::ReadOnly)) {
+        addWarning(0,QObject::trUtf8("Unable to open file."));
+        return false;
+    }
+    // STEP 7 writes sources in local ANSI codepage
+    QString text = QString::fromLocal8Bit(f.readAll());
+    f.close();
+
+    QString suffix = fi.suffix().toLower();
+    if (suffix==QLatin1String("sdf"))
+        parseSDF(text);
+    else if (suffix==QLatin1String("asc"))
+        parseASC(text);
+    else if (suffix==QLatin1String("seq"))
+        parseSEQ(text);
+    else
+        parseSource(text);
+    return true;
+}
+
+CWPList CSymbolImporter::watchpoints() const
+{
+    return result;
+}
+
+QStringList CSymbolImporter::warnings() const
+{
+    return warns;
+}
+
+int CSymbolImporter::skippedCount() const
+{
+    return skipped;
+}
+
+QString CSymbolImporter::fileFilter()
+{
+    return QObject::trUtf8("STEP 7 symbols and DB sources (*.sdf *.asc *.seq *.awl *.db *.udt);;"
+                           "All files (*)");
+}
+
+bool CSymbolImporter::isSymbolTable(const QString &fileName)
+{
+    QString suffix = QFileInfo(fileName).suffix().toLower();
+    return ((suffix==QLatin1String("sdf")) || (suffix==QLatin1String("asc")) ||
+            (suffix==QLatin1String("seq")));
+}
+
+void CSymbolImporter::addWarning(int line, const QString &msg)
+{
+    skipped++;
+    if (warns.count()<maxImportWarnings)
+        warns << QString("%1:%2: %3").arg(currentFile).arg(line).arg(msg);
+}
+
+bool CSymbolImporter::appendWatchpoint(const CWP &wp)
+{
+    if (result.count()>=maxImportWatchpoints) {
+        skipped++;
+        return false;
+    }
+    result << wp;
+    return true;
+}
+
+QString CSymbolImporter::canonicalBlock(const QString &name) const
+{
+    QString kind;
+    int number;
+    if (splitBlockName(name,kind,number))
+        return QString("%1%2").arg(kind).arg(number);
+    return blockBySymbol.value(name.toUpper(),name.toUpper());
+}
+
+void CSymbolImporter::addSymbol(int line, const QString &name, const QString &addr, const QString &type)
+{
+    QString sname = name.trimmed();
+    QString saddr = addr.trimmed();
+    QString stype = type.trimmed().toUpper();
+    if (sname.isEmpty() || saddr.isEmpty()) return;
+
+    // blocks are not watchable, DB and UDT names are remembered for DB sources
+    QString kind;
+    int number;
+    if (splitBlockName(saddr,kind,number)) {
+        if ((kind==QLatin1String("DB")) || (kind==QLatin1String("UDT"))) {
+            QString block = QString("%1%2").arg(kind).arg(number);
+            blockBySymbol.insert(sname.toUpper(),block);
+            symbolByBlock.insert(block,sname);
+        }
+        return;
+    }
+
+    CS7Address a;
+    if (!gSet->plcTokenizeAddr(saddr,a) || (a.offset<0)) {
+        addWarning(line,QObject::trUtf8("Unsupported address %1 for symbol %2.").arg(saddr,sname));
+        return;
+    }
+
+    if (stype.isEmpty()) {
+        // assignment lists have no type column, width letter is used
+        if (a.varea==CWP::Timers) stype = QString("TIMER");
+        else if (a.varea==CWP::Counters) stype = QString("COUNTER");
+        else if (a.width=='X') stype = QString("BOOL");
+        else if (a.width=='B') stype = QString("BYTE");
+        else if (a.width=='W') stype = QString("WORD");
+        else if (a.width=='D') stype = QString("DWORD");
+    } else if (stype==QLatin1String("CHAR"))
+        stype = QString("BYTE");
+    else if (stype==QLatin1String("TIME_OF_DAY"))
+        stype = QString("TOD");
+
+    CWP wp(sname,a.varea,CWP::S7NoType,a.vdb,a.offset,a.bitnum);
+    if (!gSet->plcSetTypeForName(stype,wp)) {
+        addWarning(line,QObject::trUtf8("Unsupported type %1 for symbol %2.").arg(stype,sname));
+        return;
+    }
+    wp.offset = a.offset;
+
+    bool typeMatch;
+    if ((wp.varea==CWP::Timers) || (wp.varea==CWP::Counters))
+        typeMatch = (a.varea==wp.varea);
+    else
+        typeMatch = (a.width==gSet->plcTypeWidth(wp.vtype));
+    if (!typeMatch) {
+        addWarning(line,QObject::trUtf8("Address %1 does not match type %2 for symbol %3.")
+                   .arg(saddr,stype,sname));
+        return;
+    }
+
+    appendWatchpoint(wp);
+}
+
+void CSymbolImporter::parseSDF(const QString &text)
+{
+    // "Symbol","Address","Type","Comment"
+    QStringList lines = text.split(QChar('\n'));
+    for (int i=0;i<lines.count();i++) {
+        QStringList sl = splitQuoted(lines.at(i));
+        if (sl.count()<3) continue;
+        addSymbol(i+1,sl.at(0),sl.at(1),sl.at(2));
+    }
+}
+
+void CSymbolImporter::parseASC(const QString &text)
+{
+    // 126,<symbol 24><address 12><type 10><comment 80>
+    QStringList lines = text.split(QChar('\n'));
+    for (int i=0;i<lines.count();i++) {
+        const QString& s = lines.at(i);
+        if (!s.startsWith(QLatin1String("126,")) || (s.length()<41)) continue;
+        addSymbol(i+1,s.mid(4,24),s.mid(28,12),s.mid(40,10));
+    }
+}
+
+void CSymbolImporter::parseSEQ(const QString &text)
+{
+    // =<TAB>address<TAB><TAB>symbol<TAB>comment, type is deduced from address width
+    QStringList lines = text.split(QChar('\n'));
+    for (int i=0;i<lines.count();i++) {
+        QStringList sl = lines.at(i).split(QChar('\t'));
+        if (!sl.isEmpty() && (sl.first().trimmed()==QLatin1String("=")))
+            sl.removeFirst();
+        if (sl.count()<2) continue;
+        QString name;
+        for (int j=1;j<sl.count() && name.isEmpty();j++)
+            name = sl.at(j).trimmed();
+        addSymbol(i+1,name,sl.first(),QString());
+    }
+}
+
+void CSymbolImporter::parseSource(const QString &text)
+{
+    CAWLLexer lex(text);
+    lex.next();
+    while (lex.type!=CAWLLexer::tkEnd) {
+        if (lex.isIdent("TYPE"))
+            parseUDT(lex);
+        else if (lex.isIdent("DATA_BLOCK"))
+            parseDB(lex);
+        else if (lex.isIdent("FUNCTION_BLOCK"))
+            lex.skipTo("END_FUNCTION_BLOCK");
+        else if (lex.isIdent("FUNCTION"))
+            lex.skipTo("END_FUNCTION");
+        else if (lex.isIdent("ORGANIZATION_BLOCK"))
+            lex.skipTo("END_ORGANIZATION_BLOCK");
+        else
+            lex.next();
+    }
+}
+
+bool CSymbolImporter::parseBlockName(CAWLLexer &lex, QString &block, QString &label)
+{
+    if (lex.type==CAWLLexer::tkQuoted) {
+        label = lex.text;
+        block = canonicalBlock(lex.text);
+        lex.next();
+        return true;
+    }
+    if (lex.type!=CAWLLexer::tkIdent) return false;
+
+    QString kind;
+    int number;
+    QString s = lex.text;
+    lex.next();
+    if (lex.type==CAWLLexer::tkNumber) {
+        s += lex.text;
+        lex.next();
+    }
+    if (!splitBlockName(s,kind,number)) return false;
+    block = QString("%1%2").arg(kind).arg(number);
+    label = symbolByBlock.value(block,block);
+    return true;
+}
+
+void CSymbolImporter::parseUDT(CAWLLexer &lex)
+{
+    int line = lex.line;
+    lex.next();
+    QString block, label;
+    if (!parseBlockName(lex,block,label)) {
+        addWarning(line,QObject::trUtf8("Unable to parse TYPE name."));
+        lex.skipTo("END_TYPE");
+        return;
+    }
+
+    while ((lex.type!=CAWLLexer::tkEnd) && !lex.isIdent("STRUCT") && !lex.isIdent("END_TYPE")) {
+        if (isHeaderLine(lex))
+            lex.skipLine();
+        else
+            lex.next();
+    }
+
+    CDBLayout layout;
+    if (!lex.isIdent("STRUCT") || !parseStruct(lex,layout)) {
+        addWarning(line,QObject::trUtf8("Unable to parse type %1.").arg(label));
+        lex.skipTo("END_TYPE");
+        return;
+    }
+    udts.insert(block,layout);
+    lex.skipTo("END_TYPE");
+}
+
+void CSymbolImporter::parseDB(CAWLLexer &lex)
+{
+    int line = lex.line;
+    lex.next();
+    QString block, label;
+    if (!parseBlockName(lex,block,label)) {
+        addWarning(line,QObject::trUtf8("Unable to parse DATA_BLOCK name."));
+        lex.skipTo("END_DATA_BLOCK");
+        return;
+    }
+    QString kind;
+    int dbnum;
+    if (!splitBlockName(block,kind,dbnum) || (kind!=QLatin1String("DB"))) {
+        addWarning(line,QObject::trUtf8("Unknown number of data block %1, import symbol table first.")
+                   .arg(label));
+        lex.skipTo("END_DATA_BLOCK");
+        return;
+    }
+
+    // global DB declares STRUCT, UDT-based DB names UDT, instance DB names FB
+    CDBLayout layout;
+    QString refKind;
+    int refNumber;
+    bool parsed = false;
+    while (lex.type!=CAWLLexer::tkEnd) {
+        if (lex.isIdent("STRUCT")) {
+            parsed = parseStruct(lex,layout);
+            if (!parsed)
+                addWarning(lex.line,QObject::trUtf8("Unable to parse structure of data block %1.").arg(label));
+            break;
+        }
+        if (lex.isIdent("BEGIN") || lex.isIdent("END_DATA_BLOCK")) {
+            addWarning(line,QObject::trUtf8("Data block %1 has no declaration.").arg(label));
+            break;
+        }
+        if (isHeaderLine(lex)) {
+            lex.skipLine();
+            continue;
+        }
+        if ((lex.type==CAWLLexer::tkQuoted) || lex.isIdent("UDT") || lex.isIdent("FB") ||
+                lex.isIdent("SFB") || ((lex.type==CAWLLexer::tkIdent) && splitBlockName(lex.text,refKind,refNumber))) {
+            QString ref, refLabel;
+            if (parseBlockName(lex,ref,refLabel) && udts.contains(ref)) {
+                layout = udts.value(ref);
+                parsed = true;
+            } else
+                addWarning(line,QObject::trUtf8("Data block %1 is instance of %2 or unknown UDT, skipped.")
+                           .arg(label,refLabel));
+            break;
+        }
+        lex.next();
+    }
+
+    if (parsed) {
+        for (int i=0;i<layout.leaves.count();i++) {
+            const CDBLeaf& leaf = layout.leaves.at(i);
+            int bit = (leaf.vtype==CWP::S7BOOL) ? (leaf.bitOffset % 8) : -1;
+            if (!appendWatchpoint(CWP(label+leaf.name,CWP::DB,leaf.vtype,dbnum,leaf.bitOffset/8,bit,leaf.count))) {
+                addWarning(line,QObject::trUtf8("Too many variables, import truncated at %1.")
+                           .arg(maxImportWatchpoints));
+                break;
+            }
+        }
+    }
+    lex.skipTo("END_DATA_BLOCK");
+}
+
+static bool appendMember(CDBLayout& st, int& cursor, const QString& name, const CDBLayout& m)
+{
+    // S7-300/400 layout: BOOLs are packed, bytes are byte aligned, everything else starts at even byte
+    if ((st.leaves.count()+m.leaves.count())>maxImportWatchpoints) return false;
+    if (m.kind!=CDBLayout::lkBit) {
+        cursor = roundUpBits(cursor,8);
+        if (m.kind==CDBLayout::lkWord)
+            cursor = roundUpBits(cursor,16);
+    }
+    st.leaves.reserve(st.leaves.count()+m.leaves.count());
+    for (int i=0;i<m.leaves.count();i++) {
+        const CDBLeaf& leaf = m.leaves.at(i);
+        st.leaves.append(CDBLeaf(name+leaf.name,leaf.vtype,cursor+leaf.bitOffset,leaf.count));
+    }
+    cursor += m.sizeBits;
+    return true;
+}
+
+bool CSymbolImporter::parseStruct(CAWLLexer &lex, CDBLayout &layout)
+{
+    lex.next(); // STRUCT
+    layout = CDBLayout();
+    int cursor = 0;
+    while (!lex.isIdent("END_STRUCT")) {
+        if (lex.type==CAWLLexer::tkEnd) return false;
+        if (lex.isPunct(";")) {
+            lex.next();
+            continue;
+        }
+        if ((lex.type!=CAWLLexer::tkIdent) && (lex.type!=CAWLLexer::tkQuoted)) {
+            addWarning(lex.line,QObject::trUtf8("Unexpected '%1' in structure.").arg(lex.text));
+            return false;
+        }
+        QString field = lex.text;
+        lex.next();
+        if (!lex.isPunct(":")) {
+            addWarning(lex.line,QObject::trUtf8("Expected ':' after %1.").arg(field));
+            return false;
+        }
+        lex.next();
+
+        CDBLayout member;
+        if (!parseType(lex,member)) return false;
+        if (lex.isPunct(":=")) {
+            while ((lex.type!=CAWLLexer::tkEnd) && !lex.isPunct(";"))
+                lex.next();
+        }
+        if (!lex.isPunct(";")) {
+            addWarning(lex.line,QObject::trUtf8("Expected ';' after %1.").arg(field));
+            return false;
+        }
+        lex.next();
+
+        if (!appendMember(layout,cursor,QString(".%1").arg(field),member)) {
+            addWarning(lex.line,QObject::trUtf8("Structure is too large."));
+            return false;
+        }
+    }
+    lex.next(); // END_STRUCT
+    layout.kind = CDBLayout::lkWord;
+    layout.sizeBits = roundUpBits(cursor,16);
+    return true;
+}
+
+bool CSymbolImporter::parseType(CAWLLexer &lex, CDBLayout &layout)
+{
+    if (lex.isIdent("ARRAY"))
+        return parseArray(lex,layout);
+    if (lex.isIdent("STRUCT"))
+        return parseStruct(lex,layout);
+
+    if (lex.isIdent("STRING")) {
+        // not watchable, only space is reserved
+        int len = 254;
+        lex.next();
+        if (lex.isPunct("[")) {
+            lex.next();
+            if (!readInteger(lex,len) || !lex.isPunct("]")) {
+                addWarning(lex.line,QObject::trUtf8("Bad STRING length."));
+                return false;
+            }
+            lex.next();
+        }
+        layout = CDBLayout();
+        layout.sizeBits = (qMax(len,0)+2)*8;
+        return true;
+    }
+
+    QString kind;
+    int number;
+    if ((lex.type==CAWLLexer::tkQuoted) || lex.isIdent("UDT") ||
+            ((lex.type==CAWLLexer::tkIdent) && splitBlockName(lex.text,kind,number) && (kind==QLatin1String("UDT")))) {
+        QString block, label;
+        int line = lex.line;
+        if (!parseBlockName(lex,block,label) || !udts.contains(block)) {
+            addWarning(line,QObject::trUtf8("Unknown type %1.").arg(label));
+            return false;
+        }
+        layout = udts.value(block);
+        return true;
+    }
+
+    if ((lex.type!=CAWLLexer::tkIdent) || !elementaryLayout(lex.text.toUpper(),layout)) {
+        addWarning(lex.line,QObject::trUtf8("Unsupported type %1.").arg(lex.text));
+        return false;
+    }
+    lex.next();
+    return true;
+}
+
+bool CSymbolImporter::parseArray(CAWLLexer &lex, CDBLayout &layout)
+{
+    int line = lex.line;
+    lex.next(); // ARRAY
+    if (!lex.isPunct("[")) return false;
+    lex.next();
+
+    QVector<int> low, count;
+    for (;;) {
+        int a, b;
+        if (!readInteger(lex,a) || !lex.isPunct("..")) break;
+        lex.next();
+        if (!readInteger(lex,b) || (b<a)) break;
+        low << a;
+        count << (b-a+1);
+        if (lex.isPunct(",")) {
+            lex.next();
+            continue;
+        }
+        break;
+    }
+    if (low.isEmpty() || !lex.isPunct("]")) {
+        addWarning(line,QObject::trUtf8("Bad ARRAY bounds."));
+        return false;
+    }
+    lex.next();
+    if (!lex.isIdent("OF")) {
+        addWarning(line,QObject::trUtf8("Expected OF in ARRAY declaration."));
+        return false;
+    }
+    lex.next();
+
+    CDBLayout element;
+    if (!parseType(lex,element)) return false;
+
+    qint64 total = 1;
+    for (int i=0;i<count.count();i++)
+        total *= count.at(i);
+    int stride;
+    if (element.kind==CDBLayout::lkBit) stride = 1;
+    else if (element.kind==CDBLayout::lkByte) stride = 8;
+    else stride = roundUpBits(element.sizeBits,16);
+    if ((total*element.leaves.count()>maxImportWatchpoints) || (total*stride>(1 << 28))) {
+        addWarning(line,QObject::trUtf8("ARRAY is too large."));
+        return false;
+    }
+
+    layout = CDBLayout();
+    layout.sizeBits = roundUpBits(static_cast<int>(total*stride),16);
+
+    // arrays of elementary types become one array watchpoint, read as one range
+    if ((element.leaves.count()==1) && (element.leaves.first().count==1) &&
+            element.leaves.first().name.isEmpty() && gSet->plcIsArrayType(element.leaves.first().vtype)) {
+        layout.leaves.append(CDBLeaf(QString(),element.leaves.first().vtype,0,static_cast<int>(total)));
+        return true;
+    }
+
+    // other elements are expanded row-major, last index changes fastest
+    layout.leaves.reserve(static_cast<int>(total)*element.leaves.count());
+    QVector<int> idx = low;
+    for (int i=0;i<total;i++) {
+        QString suffix = QString("[%1").arg(idx.first());
+        for (int d=1;d<idx.count();d++)
+            suffix += QString(",%1").arg(idx.at(d));
+        suffix += QChar(']');
+        for (int j=0;j<element.leaves.count();j++) {
+            const CDBLeaf& leaf = element.leaves.at(j);
+            layout.leaves.append(CDBLeaf(suffix+leaf.name,leaf.vtype,i*stride+leaf.bitOffset));
+        }
+        for (int d=idx.count()-1;d>=0;d--) {
+            idx[d]++;
+            if (idx.at(d)<(low.at(d)+count.at(d))) break;
+            idx[d] = low.at(d);
+        }
+    }
+    return true;
+}
+
+bool CSymbolImporter::elementaryLayout(const QString &typeName, CDBLayout &layout)
+{
+    layout = CDBLayout();
+    CWP::VType vtype = CWP::S7NoType;
+    if (typeName==QLatin1String("BOOL")) {
+        layout.kind = CDBLayout::lkBit;
+        layout.sizeBits = 1;
+        vtype = CWP::S7BOOL;
+    } else if ((typeName==QLatin1String("BYTE")) || (typeName==QLatin1String("CHAR"))) {
+        layout.kind = CDBLayout::lkByte;
+        layout.sizeBits = 8;
+        vtype = CWP::S7BYTE;
+    } else if (typeName==QLatin1String("WORD")) {
+        layout.sizeBits = 16;
+        vtype = CWP::S7WORD;
+    } else if (typeName==QLatin1String("INT")) {
+        layout.sizeBits = 16;
+        vtype = CWP::S7INT;
+    } else if (typeName==QLatin1String("S5TIME")) {
+        layout.sizeBits = 16;
+        vtype = CWP::S7S5TIME;
+    } else if (typeName==QLatin1String("DATE")) {
+        layout.sizeBits = 16;
+        vtype = CWP::S7DATE;
+    } else if (typeName==QLatin1String("DWORD")) {
+        layout.sizeBits = 32;
+        vtype = CWP::S7DWORD;
+    } else if (typeName==QLatin1String("DINT")) {
+        layout.sizeBits = 32;
+        vtype = CWP::S7DINT;
+    } else if (typeName==QLatin1String("REAL")) {
+        layout.sizeBits = 32;
+        vtype = CWP::S7REAL;
+    } else if (typeName==QLatin1String("TIME")) {
+        layout.sizeBits = 32;
+        vtype = CWP::S7TIME;
+    } else if ((typeName==QLatin1String("TIME_OF_DAY")) || (typeName==QLatin1String("TOD"))) {
+        layout.sizeBits = 32;
+        vtype = CWP::S7TIME_OF_DAY;
+    } else if ((typeName==QLatin1String("DATE_AND_TIME")) || (typeName==QLatin1String("DT"))) {
+        layout.sizeBits = 64;
+    } else if (typeName==QLatin1String("POINTER")) {
+        layout.sizeBits = 48;
+    } else if (typeName==QLatin1String("ANY")) {
+        layout.sizeBits = 80;
+    } else if ((typeName==QLatin1String("TIMER")) || (typeName==QLatin1String("COUNTER")) ||
+               typeName.startsWith(QLatin1String("BLOCK_"))) {
+        layout.sizeBits = 16;
+    } else
+        return false;
+
+    if (vtype!=CWP::S7NoType)
+        layout.leaves.append(CDBLeaf(QString(),vtype,0));
+    return true;
+}
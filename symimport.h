@@ -0,0 +1,80 @@
+#ifndef SYMIMPORT_H
+#define SYMIMPORT_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include "plc.h"
+
+class CDBLeaf
+{
+public:
+    QString name; // suffix relative to enclosing member: "", ".field", "[3]"
+    CWP::VType vtype;
+    int bitOffset;
+    int count; // array watchpoint length
+    CDBLeaf();
+    CDBLeaf(const QString& aName, CWP::VType aType, int aBitOffset, int aCount = 1);
+};
+
+class CDBLayout
+{
+public:
+    enum LayoutKind {
+        lkBit, // single BOOL, packed
+        lkByte, // single BYTE or CHAR, byte aligned
+        lkWord // everything else starts at even byte
+    };
+    LayoutKind kind;
+    int sizeBits;
+    QVector<CDBLeaf> leaves;
+    CDBLayout();
+};
+
+class CAWLLexer;
+
+// STEP 7 symbol tables (.sdf, .asc, .seq) and DB sources (.awl, .db) to watchpoints.
+// Symbol tables should be imported first, DB sources then can refer to DB and UDT symbols.
+class CSymbolImporter
+{
+public:
+    CSymbolImporter();
+
+    bool importFile(const QString& fileName);
+    CWPList watchpoints() const;
+    QStringList warnings() const;
+    int skippedCount() const;
+
+    static QString fileFilter();
+    static bool isSymbolTable(const QString& fileName);
+
+private:
+    CWPList result;
+    QStringList warns;
+    int skipped;
+    QString currentFile;
+    QHash<QString,QString> blockBySymbol; // "MOTORDATA" -> "DB10"
+    QHash<QString,QString> symbolByBlock; // "DB10" -> "MotorData"
+    QHash<QString,CDBLayout> udts; // by canonical block name
+
+    void addWarning(int line, const QString& msg);
+    bool appendWatchpoint(const CWP& wp);
+
+    void addSymbol(int line, const QString& name, const QString& addr, const QString& type);
+    void parseSDF(const QString& text);
+    void parseASC(const QString& text);
+    void parseSEQ(const QString& text);
+
+    void parseSource(const QString& text);
+    bool parseBlockName(CAWLLexer& lex, QString& block, QString& label);
+    void parseUDT(CAWLLexer& lex);
+    void parseDB(CAWLLexer& lex);
+    bool parseStruct(CAWLLexer& lex, CDBLayout& layout);
+    bool parseType(CAWLLexer& lex, CDBLayout& layout);
+    bool parseArray(CAWLLexer& lex, CDBLayout& layout);
+    bool elementaryLayout(const QString& typeName, CDBLayout& layout);
+    QString canonicalBlock(const QString& name) const;
+};
+
+#endif // SYMIMPORT_H
@@ -1,6 +1,8 @@
 #include <QLineEdit>
 #include <QComboBox>
 #include <QMessageBox>
+#include <algorithm>
+#include <qnumeric.h>
 #include "varmodel.h"
 #include "plc.h"
 #include "global.h"
@@ -18,6 +20,7 @@ QWidget *CVarDelegate::createEditor(QWidget *parent, const QStyleOptionViewItem
     if (!index.isValid()) return NULL;
     if (!editEnabled) return NULL;
     if ((index.row()<0) || (index.row()>=index.model()->rowCount())) return NULL;
+    if ((vmodel!=NULL) && (vmodel->elementIndex(index.row())>=0)) return NULL; // array element rows
     if (index.column()==0)
         return new QLineEdit(parent);
     else if (index.column()==1)
@@ -35,7 +38,7 @@ void CVarDelegate::setEditorData(QWidget *editor, const QModelIndex &index) cons
     if (!index.isValid()) return;
     if ((index.row()<0) || (index.row()>=index.model()->rowCount())) return;
 
-    CWP wp = vmodel->wp.at(index.row());
+    CWP wp = vmodel->wp.at(vmodel->wpIndex(index.row()));
 
     QLineEdit *le = qobject_cast<QLineEdit *>(editor);
     QComboBox *cb = qobject_cast<QComboBox *>(editor);
@@ -60,17 +63,22 @@ void CVarDelegate::setModelData(QWidget *editor, QAbstractItemModel *, const QMo
 
     QLineEdit *le = qobject_cast<QLineEdit *>(editor);
     QComboBox *cb = qobject_cast<QComboBox *>(editor);
+    int row = vmodel->wpIndex(index.row());
+
+    // array length may change with address or type
+    if (index.column()!=0)
+        vmodel->setExpanded(row,false);
 
     if ((index.column()==0) && (le!=NULL)) {
-        vmodel->wp[index.row()].label=le->text();
+        vmodel->wp[row].label=le->text();
         vmodel->syncPLC();
     } else if ((index.column()==1) && (le!=NULL)) {
-        if (!gSet->plcParseAddr(le->text(),vmodel->wp[index.row()]))
+        if (!gSet->plcParseAddr(le->text(),vmodel->wp[row]))
             QMessageBox::warning(vmodel->mainWnd,trUtf8("PLC recorder error"),
                                  trUtf8("Unable to parse address. Possible syntax error."));
         vmodel->syncPLC();
     } else if ((index.column()==2) && (cb!=NULL)) {
-        if (!gSet->plcSetTypeForName(cb->currentText(),vmodel->wp[index.row()]))
+        if (!gSet->plcSetTypeForName(cb->currentText(),vmodel->wp[row]))
             QMessageBox::warning(vmodel->mainWnd,trUtf8("PLC recorder error"),
                                  trUtf8("Unable to parse type. Possible syntax error."));
         vmodel->syncPLC();
@@ -105,6 +113,11 @@ CVarModel::CVarModel(QObject *parent, CPLC* aPlc)
     led0.load(":/led0");
     led1.load(":/led1");
     editEnabled = true;
+    rebuildRows();
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    connect(refreshTimer,SIGNAL(timeout()),this,SLOT(refreshDirtyRows()));
 }
 
 CVarModel::~CVarModel()
@@ -112,8 +125,10 @@ CVarModel::~CVarModel()
     wp.clear();
 }
 
-Qt::ItemFlags CVarModel::flags(const QModelIndex &) const
+Qt::ItemFlags CVarModel::flags(const QModelIndex &index) const
 {
+    if (index.isValid() && (elementIndex(index.row())>=0))
+        return (Qt::ItemIsSelectable | Qt::ItemIsEnabled);
     return (Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsEditable);
 }
 
@@ -126,16 +141,45 @@ QVariant CVarModel::data(const QModelIndex &index, int role) const
     int row = index.row();
     int column = index.column();
 
-    if ((row<0) || (row>=wp.count()) || (column<0) || (column>=4)) return QVariant();
+    if ((row<0) || (row>=rowWp.count()) || (column<0) || (column>=4)) return QVariant();
+    const CWP &awp = wp.at(rowWp.at(row));
+    int element = rowElement.at(row);
     if (role==Qt::DisplayRole) {
-        if (column==0) return wp.at(row).label;
-        else if (column==1) return gSet->plcGetAddrName(wp.at(row));
-        else if (column==2) return gSet->plcGetTypeName(wp.at(row));
-        else if (column==3) return gSet->plcFormatActualValue(wp.at(row));
-        else return QVariant();
+        if (element>=0) {
+            // array element row
+            if (column==0) return QString("    %1[%2]").arg(awp.label).arg(element);
+            else if (column==1) return gSet->plcGetAddrName(elementCWP(awp,element));
+            else if (column==2) return gSet->plcGetTypeName(elementCWP(awp,element));
+        } else {
+            if (column==0) return awp.label;
+            else if (column==1) return gSet->plcGetAddrName(awp);
+            else if (column==2) return gSet->plcGetTypeName(awp);
+            else if ((column==3) && awp.isArray())
+                return trUtf8("%1 elements").arg(awp.count);
+        }
+        if (column==3) {
+            if (row>=valueTextValid.count())
+                return (element>=0) ? gSet->plcFormatArrayElement(awp,element) : gSet->plcFormatActualValue(awp);
+            if (!valueTextValid.at(row)) {
+                if (element>=0)
+                    valueText[row] = gSet->plcFormatArrayElement(awp,element);
+                else
+                    valueText[row] = gSet->plcFormatActualValue(awp);
+                valueTextValid[row] = true;
+            }
+            return valueText.at(row);
+        }
+        return QVariant();
     } else if (role==Qt::DecorationRole) {
-        CWP awp = wp.at(row);
-        if ((column==3) && (awp.vtype==CWP::S7BOOL) && (awp.data.canConvert<bool>())) {
+        if ((column==3) && (awp.vtype==CWP::S7BOOL) && (element>=0)) {
+            double v = awp.arrayValue(element);
+            if (qIsNaN(v))
+                return QVariant();
+            else if (v>0.5)
+                return led1;
+            else
+                return led0;
+        } else if ((column==3) && (awp.vtype==CWP::S7BOOL) && !awp.isArray() && (awp.data.kind()==CWPValue::vkBool)) {
             if (awp.data.toBool())
                 return led1;
             else
@@ -166,7 +210,7 @@ QVariant CVarModel::headerData(int section, Qt::Orientation orientation, int rol
 
 int CVarModel::rowCount(const QModelIndex &) const
 {
-    return wp.count();
+    return rowWp.count();
 }
 
 int CVarModel::columnCount(const QModelIndex &) const
@@ -176,7 +220,7 @@ int CVarModel::columnCount(const QModelIndex &) const
 
 QModelIndex CVarModel::index(int row, int column, const QModelIndex &) const
 {
-    if ((row<0) || (row>=wp.count()) || (column<0) || (column>=4)) return QModelIndex();
+    if ((row<0) || (row>=rowWp.count()) || (column<0) || (column>=4)) return QModelIndex();
     return createIndex(row,column);
 }
 
@@ -188,35 +232,155 @@ QModelIndex CVarModel::parent(const QModelIndex &) const
 bool CVarModel::insertRows(int row, int count, const QModelIndex &parent)
 {
     if (!editEnabled) return false;
-    if ((row<0) || (row>wp.count())) return false;
-    beginInsertRows(parent,row,row+count-1);
-    for (int i=0;i<count;i++)
-        wp.insert(row,CWP());
+    if ((row<0) || (row>rowWp.count())) return false;
+    // new variables are inserted before array, not between its elements
+    int idx = (row<rowWp.count()) ? rowWp.at(row) : wp.count();
+    int first = (idx<wp.count()) ? wpRow.at(idx) : rowWp.count();
+    beginInsertRows(parent,first,first+count-1);
+    for (int i=0;i<count;i++) {
+        wp.insert(idx,CWP());
+        expanded.insert(idx,false);
+    }
+    rebuildRows();
+    resetValueCache();
     endInsertRows();
     return true;
 }
 
-bool CVarModel::removeRows(int row, int count, const QModelIndex &parent)
+bool CVarModel::removeRows(int row, int count, const QModelIndex &)
 {
     if (!editEnabled) return false;
-    if ((row<0) || (row>=wp.count())) return false;
-    beginRemoveRows(parent,row,row+count-1);
-    for (int i=0;i<count;i++)
-        if (row<wp.count())
-            wp.removeAt(row);
-    endRemoveRows();
+    if ((row<0) || (count<1) || (row>=rowWp.count())) return false;
+    int last = qMin(row+count,rowWp.count())-1;
+    removeWatchpoints(rowWp.at(row),rowWp.at(last));
     return true;
 }
 
 void CVarModel::removeMultipleRows(QList<int> rows)
 {
-    CWPList wl;
-    for (int i=0;i<rows.count();i++)
-        if ((rows.at(i)>=0) && (rows.at(i)<wp.count()))
-            wl << wp.at(rows.at(i));
-    for (int i=0;i<wl.count();i++)
-        removeRow(wp.indexOf(wl.at(i)));
-    wl.clear();
+    // selection contains each row once per column, element rows select their array,
+    // variables are compacted in one pass and views are reset once
+    if (!editEnabled) return;
+    QVector<bool> removed(wp.count(),false);
+    int cnt = 0;
+    for (int i=0;i<rows.count();i++) {
+        if ((rows.at(i)<0) || (rows.at(i)>=rowWp.count())) continue;
+        int idx = rowWp.at(rows.at(i));
+        if (removed.at(idx)) continue;
+        removed[idx] = true;
+        cnt++;
+    }
+    if (cnt==0) return;
+
+    beginResetModel();
+    CWPList res;
+    res.reserve(wp.count()-cnt);
+    QVector<bool> resExpanded;
+    resExpanded.reserve(wp.count()-cnt);
+    for (int i=0;i<wp.count();i++) {
+        if (removed.at(i)) continue;
+        res << wp.at(i);
+        resExpanded << expanded.at(i);
+    }
+    wp = res;
+    expanded = resExpanded;
+    rebuildRows();
+    resetValueCache();
+    endResetModel();
+}
+
+void CVarModel::removeWatchpoints(int first, int last)
+{
+    if (!editEnabled) return;
+    if ((first<0) || (last>=wp.count()) || (first>last)) return;
+    int lastRow = ((last+1)<wp.count()) ? (wpRow.at(last+1)-1) : (rowWp.count()-1);
+    beginRemoveRows(QModelIndex(),wpRow.at(first),lastRow);
+    wp.erase(wp.begin()+first,wp.begin()+last+1);
+    expanded.remove(first,last-first+1);
+    rebuildRows();
+    resetValueCache();
+    endRemoveRows();
+}
+
+void CVarModel::appendWatchpoints(const CWPList &wpl)
+{
+    if (!editEnabled) return;
+    beginResetModel();
+    wp.append(wpl);
+    rebuildRows();
+    resetValueCache();
+    endResetModel();
+    syncPLC();
+}
+
+void CVarModel::rebuildRows()
+{
+    expanded.resize(wp.count());
+    wpRow.resize(wp.count());
+    rowWp.clear();
+    rowElement.clear();
+    for (int i=0;i<wp.count();i++) {
+        wpRow[i] = rowWp.count();
+        rowWp << i;
+        rowElement << -1;
+        if (expanded.at(i) && wp.at(i).isArray()) {
+            for (int j=0;j<wp.at(i).count;j++) {
+                rowWp << i;
+                rowElement << j;
+            }
+        }
+    }
+}
+
+CWP CVarModel::elementCWP(const CWP &array, int element)
+{
+    CWP res = array;
+    res.count = 1;
+    res.data = CWPValue();
+    if (array.vtype==CWP::S7BOOL) {
+        int bit = qMax(array.bitnum,0)+element;
+        res.offset = array.offset+bit/8;
+        res.bitnum = bit % 8;
+    } else
+        res.offset = array.offset+element*array.elementSize();
+    return res;
+}
+
+int CVarModel::wpIndex(int row) const
+{
+    if ((row<0) || (row>=rowWp.count())) return -1;
+    return rowWp.at(row);
+}
+
+int CVarModel::elementIndex(int row) const
+{
+    if ((row<0) || (row>=rowElement.count())) return -1;
+    return rowElement.at(row);
+}
+
+bool CVarModel::isExpanded(int idx) const
+{
+    if ((idx<0) || (idx>=expanded.count())) return false;
+    return expanded.at(idx);
+}
+
+void CVarModel::setExpanded(int idx, bool state)
+{
+    if ((idx<0) || (idx>=wp.count())) return;
+    if (!wp.at(idx).isArray() || (expanded.at(idx)==state)) return;
+    int first = wpRow.at(idx)+1;
+    int last = first+wp.at(idx).count-1;
+    if (state)
+        beginInsertRows(QModelIndex(),first,last);
+    else
+        beginRemoveRows(QModelIndex(),first,last);
+    expanded[idx] = state;
+    rebuildRows();
+    resetValueCache();
+    if (state)
+        endInsertRows();
+    else
+        endRemoveRows();
 }
 
 CWP CVarModel::getCWP(int idx) const
@@ -243,11 +407,14 @@ void CVarModel::saveWPList(QDataStream &out)
 void CVarModel::loadWPList(QDataStream &in)
 {
     if (!editEnabled) return;
-    removeRows(0,wp.count());
+    removeWatchpoints(0,wp.count()-1);
     int cnt;
     in >> cnt;
     beginInsertRows(QModelIndex(),0,cnt-1);
     in >> wp;
+    expanded.fill(false,wp.count());
+    rebuildRows();
+    resetValueCache();
     endInsertRows();
     syncPLC();
 }
@@ -258,12 +425,53 @@ void CVarModel::loadActualsFromPLC(const CWPList &wpl)
         mainWnd->appendLog(trUtf8("Variables list is different. Unable to load VAT."));
         return;
     }
+    if (dirtyRows.count()!=rowWp.count())
+        resetValueCache();
+
+    // only changed values are copied and marked for redraw, with elements of expanded arrays
+    bool changed = false;
     for (int i=0;i<wpl.count();i++) {
+        if (wp.at(i).data==wpl.at(i).data && wp.at(i).dataSign==wpl.at(i).dataSign) continue;
         wp[i].data = wpl.at(i).data;
         wp[i].dataSign = wpl.at(i).dataSign;
+        int last = wpRow.at(i);
+        if (expanded.at(i) && wp.at(i).isArray())
+            last += wp.at(i).count;
+        for (int j=wpRow.at(i);j<=last;j++) {
+            valueTextValid[j] = false;
+            dirtyRows[j] = true;
+        }
+        changed = true;
     }
 
-    emit dataChanged(index(0,3),index(wp.count()-1,3));
+    if (changed && !refreshTimer->isActive()) {
+        refreshTimer->setInterval(1000/qBound(1,gSet->vatRefreshRate,50));
+        refreshTimer->start();
+    }
+}
+
+void CVarModel::refreshDirtyRows()
+{
+    // consecutive changed rows are merged into one dataChanged range
+    int first = -1;
+    for (int i=0;i<=dirtyRows.count() && i<=rowWp.count();i++) {
+        bool dirty = (i<dirtyRows.count() && i<rowWp.count() && dirtyRows.at(i));
+        if (dirty) {
+            dirtyRows[i] = false;
+            if (first<0)
+                first = i;
+        } else if (first>=0) {
+            emit dataChanged(index(first,3),index(i-1,3));
+            first = -1;
+        }
+    }
+}
+
+void CVarModel::resetValueCache()
+{
+    valueText.fill(QString(),rowWp.count());
+    valueTextValid.fill(false,rowWp.count());
+    dirtyRows.fill(false,rowWp.count());
 }
 
 void CVarModel::setEditEnabled(bool state)
@@ -278,5 +486,9 @@ bool CVarModel::isEditEnabled()
 
 void CVarModel::syncPLC()
 {
+    // address and type edits change formatting
+    rebuildRows();
+    resetValueCache();
+
     emit syncPLCtoModel(wp);
 }
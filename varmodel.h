@@ -5,6 +5,7 @@
 #include <QItemDelegate>
 #include <QWidget>
 #include <QAbstractItemModel>
+#include <QTimer>
 #include "plc.h"
 
 class CVarModel;
@@ -32,6 +33,10 @@ public:
 private:
     CVarModel* vmodel;
     bool editEnabled;
+    QVector<bool> expanded;
+    QVector<int> wpRow; // first view row of variable
+    QVector<int> rowWp;
+    QVector<int> rowElement; // -1 for variable row
 
 };
 
@@ -54,6 +59,14 @@ public:
     bool insertRows(int row, int count, const QModelIndex &parent = QModelIndex());
     bool removeRows(int row, int count, const QModelIndex &parent = QModelIndex());
     void removeMultipleRows(QList<int> rows);
+    void appendWatchpoints(const CWPList& wpl);
+
+    // view rows: variables, followed by element rows of expanded arrays
+    int wpIndex(int row) const;
+    int elementIndex(int row) const;
+    bool isExpanded(int idx) const;
+    void setExpanded(int idx, bool state);
+    static CWP elementCWP(const CWP& array, int element);
 
     CWP getCWP(int idx) const;
     int getCWPCount() const;
@@ -73,12 +86,27 @@ private:
     QPixmap led0, led1;
     bool editEnabled;
 
+    // formatted actual values, recalculated only for changed values
+    mutable QVector<QString> valueText;
+    mutable QVector<bool> valueTextValid;
+
+    // rows changed since last view update, flushed at most with VAT refresh rate
+    QVector<bool> dirtyRows;
+    QTimer* refreshTimer;
+
+    void resetValueCache();
+    void rebuildRows();
+    void removeWatchpoints(int first, int last);
+
 signals:
     void syncPLCtoModel(const CWPList& aWatchpoints);
 
 public slots:
     void syncPLC();
 
+private slots:
+    void refreshDirtyRows();
+
 };
 
 #endif // VARMODEL_H
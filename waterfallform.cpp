@@ -0,0 +1,95 @@
+#include <cstring>
+#include <qnumeric.h>
+#include "ui_waterfallform.h"
+#include "waterfallform.h"
+#include "global.h"
+
+const static int waterfallDepth = 256; // scans
+
+CWaterfallForm::CWaterfallForm(const CWP &aWp, QWidget *parent) :
+    QWidget(parent),
+    ui(new Ui::CWaterfallForm)
+{
+    ui->setupUi(this);
+
+    wp = aWp;
+    head = 0;
+    filled = 0;
+    dirty = false;
+    history.fill(qQNaN(),waterfallDepth*qMax(wp.count,1));
+
+    setWindowTitle(trUtf8("Array waterfall - %1").arg(wp.label));
+    ui->lblInfo->setText(trUtf8("%1 (%2): waiting for data.").arg(wp.label,gSet->plcGetAddrName(wp)));
+
+    // element index horizontally, newest scan on top
+    colorMap = new QCPColorMap(ui->plot->xAxis,ui->plot->yAxis);
+    colorMap->data()->setSize(qMax(wp.count,1),waterfallDepth);
+    colorMap->data()->setRange(QCPRange(0,qMax(wp.count,1)-1),QCPRange(-(waterfallDepth-1),0));
+    colorMap->setInterpolate(false);
+
+    QCPColorScale* colorScale = new QCPColorScale(ui->plot);
+    ui->plot->plotLayout()->addElement(0,1,colorScale);
+    colorMap->setColorScale(colorScale);
+    QCPColorGradient gradient(QCPColorGradient::gpJet);
+    gradient.setNanHandling(QCPColorGradient::nhTransparent);
+    colorMap->setGradient(gradient);
+
+    QCPMarginGroup* marginGroup = new QCPMarginGroup(ui->plot);
+    ui->plot->axisRect()->setMarginGroup(QCP::msBottom | QCP::msTop,marginGroup);
+    colorScale->setMarginGroup(QCP::msBottom | QCP::msTop,marginGroup);
+
+    ui->plot->xAxis->setLabel(trUtf8("Element"));
+    ui->plot->yAxis->setLabel(trUtf8("Scans ago"));
+    ui->plot->setInteractions(QCP::iRangeDrag | QCP::iRangeZoom);
+    ui->plot->rescaleAxes();
+
+    frameTimer = new QTimer(this);
+    frameTimer->setInterval(1000/qBound(1,gSet->plotFrameRate,100));
+    connect(frameTimer,SIGNAL(timeout()),this,SLOT(frameTick()));
+    frameTimer->start();
+}
+
+CWaterfallForm::~CWaterfallForm()
+{
+    delete ui;
+}
+
+void CWaterfallForm::addData(const CWPList &wpl, const QDateTime &time)
+{
+    int idx = wpl.indexOf(wp);
+    if (idx<0) return;
+    const CWP &awp = wpl.at(idx);
+    if (awp.count!=wp.count) return;
+
+    QVector<double> values = awp.arrayValues();
+    if (values.count()!=wp.count) return;
+
+    memcpy(history.data()+head*wp.count,values.constData(),
+           static_cast<size_t>(wp.count)*sizeof(double));
+    head = (head+1) % waterfallDepth;
+    filled = qMin(filled+1,waterfallDepth);
+    lastTime = time;
+    dirty = true;
+}
+
+void CWaterfallForm::frameTick()
+{
+    if (!dirty || !isVisible()) return;
+    dirty = false;
+
+    // repaint limited to plot frame rate, ring row of age N goes to cell row depth-1-N
+    QCPColorMapData* data = colorMap->data();
+    for (int age=0;age<waterfallDepth;age++) {
+        int ringRow = (head-1-age+2*waterfallDepth) % waterfallDepth;
+        const double* src = history.constData()+ringRow*wp.count;
+        int cellRow = waterfallDepth-1-age;
+        for (int i=0;i<wp.count;i++)
+            data->setCell(i,cellRow,(age<filled) ? src[i] : qQNaN());
+    }
+    colorMap->rescaleDataRange(true);
+    ui->plot->replot();
+
+    ui->lblInfo->setText(trUtf8("%1 (%2): %3 elements, last scan %4.")
+                         .arg(wp.label,gSet->plcGetAddrName(wp)).arg(wp.count)
+                         .arg(lastTime.toString("hh:mm:ss.zzz")));
+}
@@ -0,0 +1,41 @@
+#ifndef WATERFALLFORM_H
+#define WATERFALLFORM_H
+
+#include <QWidget>
+#include <QTimer>
+#include <QDateTime>
+#include "qcustomplot-source/qcustomplot.h"
+#include "plc.h"
+
+namespace Ui {
+class CWaterfallForm;
+}
+
+class CWaterfallForm : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit CWaterfallForm(const CWP &aWp, QWidget *parent = NULL);
+    ~CWaterfallForm();
+
+    // scans of watched array are kept in ring, other watchpoints are ignored
+    void addData(const CWPList &wpl, const QDateTime &time);
+
+private:
+    Ui::CWaterfallForm *ui;
+    CWP wp;
+    QCPColorMap* colorMap;
+    QVector<double> history; // depth rows of wp.count elements
+    int head;
+    int filled;
+    bool dirty;
+    QDateTime lastTime;
+    QTimer* frameTimer;
+
+private slots:
+    void frameTick();
+
+};
+
+#endif // WATERFALLFORM_H